@@ -0,0 +1,41 @@
+# Trivial Asset Cooker worker: for each job, copies the first input to the first output.
+# See "Workers" in the main Readme for the protocol.
+
+$input_path  = $null
+$output_path = $null
+
+while ($null -ne ($line = [Console]::In.ReadLine()))
+{
+    if ($line.StartsWith("COMMAND: "))
+    {
+        [Console]::Out.WriteLine("Received " + $line.Substring(9))
+    }
+    elseif ($line.StartsWith("INPUT: "))
+    {
+        if ($null -eq $input_path) { $input_path = $line.Substring(7) }
+    }
+    elseif ($line.StartsWith("OUTPUT: "))
+    {
+        if ($null -eq $output_path) { $output_path = $line.Substring(8) }
+    }
+    elseif ($line -eq "END")
+    {
+        $exit_code = 0
+        try
+        {
+            Copy-Item -LiteralPath $input_path -Destination $output_path -ErrorAction Stop
+            [Console]::Out.WriteLine("Copied $input_path to $output_path")
+        }
+        catch
+        {
+            [Console]::Out.WriteLine("[error] " + $_.Exception.Message)
+            $exit_code = 1
+        }
+
+        [Console]::Out.WriteLine("EXIT: $exit_code")
+        [Console]::Out.Flush()
+
+        $input_path  = $null
+        $output_path = $null
+    }
+}
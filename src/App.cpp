@@ -10,6 +10,7 @@
 #include "RuleReader.h"
 #include "Debug.h"
 #include "CookingSystem.h"
+#include "OutputRequests.h"
 #include <Bedrock/Test.h>
 #include <Bedrock/Mutex.h>
 #include <Bedrock/StringFormat.h>
@@ -137,6 +138,10 @@ void App::Init()
 	// If all is good, start scanning files.
 	if (!HasInitError())
 		gFileSystem.StartMonitoring();
+
+	// Start listening for output requests.
+	if (!HasInitError() && !mRequestPipeName.Empty())
+		gStartOutputRequestServer(mRequestPipeName);
 }
 
 
@@ -80,6 +80,7 @@ struct App
 	String							mLogFilePath;
 	String							mLogDirectory	= "Logs";
 	String							mCacheDirectory = "Cache";
+	String							mRequestPipeName;		// Name of the pipe used to request outputs. No pipe if empty.
 	String							mInitError;
 
 	bool                            mHideWindowOnMinimize       = true; // Hide the window when minimizing it.
@@ -0,0 +1,236 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Writer for the "AssetCookerBinary" dep file format.
+ *
+ * Header-only C library, meant to be copied into the tools that generate dep files.
+ * Include it anywhere, and in exactly one C or C++ file define AC_DEP_FILE_IMPLEMENTATION before including it.
+ *
+ * Usage:
+ *   AcDepFileWriter writer;
+ *   ac_dep_file_init(&writer);
+ *   ac_dep_file_add(&writer, "D:/path/to/input.txt", 0, NULL);
+ *   ac_dep_file_add(&writer, "D:/outputs/file.txt", 1, NULL);
+ *   int success = ac_dep_file_write(&writer, "D:/outputs/file.dep");
+ *   ac_dep_file_free(&writer);
+ *
+ * File layout (little endian):
+ *   AcDepFileHeader
+ *   AcDepFileEntry[mEntryCount]
+ *   uint8_t[mEntryCount][16]   Only if AC_DEP_FILE_FLAG_PATH_HASHES is set (see ac_dep_file_add).
+ *   char[mStringTableSize]     The paths, UTF-8, not null terminated. Relative paths are accepted.
+ */
+#ifndef AC_DEP_FILE_H
+#define AC_DEP_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define AC_DEP_FILE_MAGIC            0x46444341u /* "ACDF" */
+#define AC_DEP_FILE_VERSION          1u
+#define AC_DEP_FILE_FLAG_PATH_HASHES 1u
+
+typedef struct AcDepFileHeader
+{
+	uint32_t mMagic;
+	uint32_t mVersion;
+	uint32_t mFlags;
+	uint32_t mEntryCount;
+	uint32_t mStringTableSize;
+} AcDepFileHeader;
+
+typedef struct AcDepFileEntry
+{
+	uint32_t mPathOffset; /* Position of the path in the string table. */
+	uint16_t mPathSize;
+	uint8_t  mIsOutput;   /* 0 for inputs, 1 for outputs. */
+	uint8_t  mPadding;
+} AcDepFileEntry;
+
+typedef struct AcDepFileWriter
+{
+	AcDepFileEntry* mEntries;
+	uint8_t*        mHashes;
+	char*           mStrings;
+	uint32_t        mEntryCount;
+	uint32_t        mEntryCapacity;
+	uint32_t        mStringTableSize;
+	uint32_t        mStringTableCapacity;
+	int             mHasHashes;
+	int             mError;         /* Set if an allocation failed, a path was too long or there were too many paths, ac_dep_file_write will fail. */
+} AcDepFileWriter;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void ac_dep_file_init(AcDepFileWriter* ioWriter);
+void ac_dep_file_free(AcDepFileWriter* ioWriter);
+
+/*
+ * Add an input (inIsOutput = 0) or an output (inIsOutput = 1).
+ * inPathHash is optional (can be NULL). If provided, it must be the XXH3 128-bit hash (XXH128_hash_t as is, low64 first) of the
+ * absolute path with backslashes, converted to UTF-16 and to uppercase with the invariant locale.
+ * It lets Asset Cooker find files it already knows without resolving their path. The path is still used if the hash isn't found.
+ */
+void ac_dep_file_add(AcDepFileWriter* ioWriter, const char* inPath, int inIsOutput, const uint8_t* inPathHash);
+
+/* Write the dep file. Return 1 on success, 0 on failure. */
+int  ac_dep_file_write(const AcDepFileWriter* inWriter, const char* inFilePath);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AC_DEP_FILE_H */
+
+
+#ifdef AC_DEP_FILE_IMPLEMENTATION
+#ifndef AC_DEP_FILE_IMPLEMENTATION_DONE
+#define AC_DEP_FILE_IMPLEMENTATION_DONE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void ac_dep_file_init(AcDepFileWriter* ioWriter)
+{
+	memset(ioWriter, 0, sizeof(*ioWriter));
+}
+
+
+void ac_dep_file_free(AcDepFileWriter* ioWriter)
+{
+	free(ioWriter->mEntries);
+	free(ioWriter->mHashes);
+	free(ioWriter->mStrings);
+	memset(ioWriter, 0, sizeof(*ioWriter));
+}
+
+
+void ac_dep_file_add(AcDepFileWriter* ioWriter, const char* inPath, int inIsOutput, const uint8_t* inPathHash)
+{
+	size_t path_size = strlen(inPath);
+
+	if (ioWriter->mError)
+		return;
+
+	/* Sizes and offsets are stored on 16 and 32 bits. */
+	if (path_size > UINT16_MAX || (uint64_t)ioWriter->mStringTableSize + path_size > UINT32_MAX || ioWriter->mEntryCount == UINT32_MAX)
+	{
+		ioWriter->mError = 1;
+		return;
+	}
+
+	/* Grow the entries (and their hashes). */
+	if (ioWriter->mEntryCount == ioWriter->mEntryCapacity)
+	{
+		uint32_t        new_capacity = ioWriter->mEntryCapacity ? (ioWriter->mEntryCapacity > UINT32_MAX / 2 ? UINT32_MAX : ioWriter->mEntryCapacity * 2) : 64;
+		AcDepFileEntry* new_entries  = (AcDepFileEntry*)realloc(ioWriter->mEntries, (size_t)new_capacity * sizeof(AcDepFileEntry));
+		uint8_t*        new_hashes   = new_entries ? (uint8_t*)realloc(ioWriter->mHashes, (size_t)new_capacity * 16) : NULL;
+
+		if (new_entries)
+			ioWriter->mEntries = new_entries;
+
+		if (new_hashes == NULL)
+		{
+			ioWriter->mError = 1;
+			return;
+		}
+
+		ioWriter->mHashes        = new_hashes;
+		ioWriter->mEntryCapacity = new_capacity;
+	}
+
+	/* Grow the string table. */
+	if (ioWriter->mStringTableSize + path_size > ioWriter->mStringTableCapacity)
+	{
+		uint64_t new_capacity = ioWriter->mStringTableCapacity ? (uint64_t)ioWriter->mStringTableCapacity * 2 : 4096;
+		char*    new_strings;
+
+		while (new_capacity < ioWriter->mStringTableSize + path_size)
+			new_capacity *= 2;
+
+		if (new_capacity > UINT32_MAX)
+			new_capacity = UINT32_MAX;
+
+		new_strings = (char*)realloc(ioWriter->mStrings, (size_t)new_capacity);
+		if (new_strings == NULL)
+		{
+			ioWriter->mError = 1;
+			return;
+		}
+
+		ioWriter->mStrings             = new_strings;
+		ioWriter->mStringTableCapacity = (uint32_t)new_capacity;
+	}
+
+	{
+		AcDepFileEntry* entry = &ioWriter->mEntries[ioWriter->mEntryCount];
+		uint8_t*        hash  = &ioWriter->mHashes[ioWriter->mEntryCount * 16];
+
+		entry->mPathOffset = ioWriter->mStringTableSize;
+		entry->mPathSize   = (uint16_t)path_size;
+		entry->mIsOutput   = inIsOutput ? 1 : 0;
+		entry->mPadding    = 0;
+
+		/* Entries without a hash are all zeros. */
+		if (inPathHash)
+		{
+			memcpy(hash, inPathHash, 16);
+			ioWriter->mHasHashes = 1;
+		}
+		else
+		{
+			memset(hash, 0, 16);
+		}
+
+		memcpy(ioWriter->mStrings + ioWriter->mStringTableSize, inPath, path_size);
+		ioWriter->mStringTableSize += (uint32_t)path_size;
+		ioWriter->mEntryCount++;
+	}
+}
+
+
+int ac_dep_file_write(const AcDepFileWriter* inWriter, const char* inFilePath)
+{
+	AcDepFileHeader header;
+	FILE*           file;
+	int             success;
+
+	if (inWriter->mError)
+		return 0;
+
+	header.mMagic           = AC_DEP_FILE_MAGIC;
+	header.mVersion         = AC_DEP_FILE_VERSION;
+	header.mFlags           = inWriter->mHasHashes ? AC_DEP_FILE_FLAG_PATH_HASHES : 0;
+	header.mEntryCount      = inWriter->mEntryCount;
+	header.mStringTableSize = inWriter->mStringTableSize;
+
+	file = fopen(inFilePath, "wb");
+	if (file == NULL)
+		return 0;
+
+	success = fwrite(&header, sizeof(header), 1, file) == 1;
+
+	if (success && inWriter->mEntryCount)
+		success = fwrite(inWriter->mEntries, sizeof(AcDepFileEntry), inWriter->mEntryCount, file) == inWriter->mEntryCount;
+
+	if (success && inWriter->mEntryCount && inWriter->mHasHashes)
+		success = fwrite(inWriter->mHashes, 16, inWriter->mEntryCount, file) == inWriter->mEntryCount;
+
+	if (success && inWriter->mStringTableSize)
+		success = fwrite(inWriter->mStrings, 1, inWriter->mStringTableSize, file) == inWriter->mStringTableSize;
+
+	if (fclose(file) != 0)
+		success = 0;
+
+	return success;
+}
+
+#endif /* AC_DEP_FILE_IMPLEMENTATION_DONE */
+#endif /* AC_DEP_FILE_IMPLEMENTATION */
@@ -105,6 +105,24 @@ struct BinaryReader : NoCopy
 		return buffer;
 	}
 
+	// Return a view of a string inside the internal buffer instead of copying it. Not null terminated.
+	[[nodiscard]] StringView ReadView()
+	{
+		uint32 size = 0;
+		Read(size);
+
+		if (mCurrentOffset + (int)size > mBuffer.Size())
+		{
+			mError = true;
+			return {};
+		}
+
+		StringView view = { (const char*)mBuffer.Begin() + mCurrentOffset, (int)size };
+		mCurrentOffset += (int)size;
+
+		return view;
+	}
+
 	void Skip(int inSizeInBytes)
 	{
 		if (mCurrentOffset + inSizeInBytes > mBuffer.Size())
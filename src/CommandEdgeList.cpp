@@ -0,0 +1,106 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include "CommandEdgeList.h"
+
+#include <Bedrock/Test.h>
+
+
+void CommandEdgeList::Add(CookingCommandID inID)
+{
+	gAssert(!Contains(inID));
+
+	mCommands.PushBack(inID);
+
+	if (!mIndex.Empty())
+	{
+		mIndex.Insert(inID, mCommands.Size() - 1);
+	}
+	else if (mCommands.Size() > cIndexThreshold)
+	{
+		// The list got large, searching it linearly would become too slow. Build the index.
+		for (int i = 0; i < mCommands.Size(); ++i)
+			mIndex.Insert(mCommands[i], i);
+	}
+}
+
+
+bool CommandEdgeList::Remove(CookingCommandID inID)
+{
+	int index = Find(inID);
+	if (index == -1)
+		return false;
+
+	// Swap with the last one to not have to move everything.
+	int last_index = mCommands.Size() - 1;
+	if (index != last_index)
+	{
+		mCommands[index] = mCommands[last_index];
+
+		if (!mIndex.Empty())
+			mIndex.Find(mCommands[index])->mValue = index;
+	}
+
+	mCommands.PopBack();
+
+	if (!mIndex.Empty())
+		mIndex.Erase(mIndex.Find(inID));
+
+	// Note: the index is kept if the list shrinks again, a file that was used by many commands likely will be again.
+	// If the list becomes empty, so does the index, and it's only used again once the list is large enough.
+	return true;
+}
+
+
+int CommandEdgeList::Find(CookingCommandID inID) const
+{
+	if (!mIndex.Empty())
+	{
+		auto it = mIndex.Find(inID);
+		return it != mIndex.End() ? it->mValue : -1;
+	}
+
+	for (int i = 0; i < mCommands.Size(); ++i)
+		if (mCommands[i] == inID)
+			return i;
+
+	return -1;
+}
+
+
+REGISTER_TEST("CommandEdgeList")
+{
+	CommandEdgeList list;
+
+	constexpr int cCount = CommandEdgeList::cIndexThreshold * 3;
+	for (int i = 0; i < cCount; ++i)
+		list.Add(CookingCommandID{ (uint32)i });
+
+	TEST_TRUE(list.Size() == cCount);
+
+	// Remove every other command, from both ends to also test moving the last one.
+	for (int i = 0; i < cCount; i += 2)
+		TEST_TRUE(list.Remove(CookingCommandID{ (uint32)i }));
+
+	TEST_FALSE(list.Remove(CookingCommandID{ 0 }));
+	TEST_TRUE(list.Size() == cCount / 2);
+
+	for (int i = 0; i < cCount; ++i)
+		TEST_TRUE(list.Contains(CookingCommandID{ (uint32)i }) == (i % 2 == 1));
+
+	// All the positions should still be right.
+	while (!list.Empty())
+	{
+		CookingCommandID id = *list.begin();
+		TEST_TRUE(list.Remove(id));
+		TEST_FALSE(list.Contains(id));
+	}
+
+	// Once empty, the list works without the index again.
+	list.Add(CookingCommandID{ 1 });
+	TEST_TRUE(list.Contains(CookingCommandID{ 1 }));
+	TEST_TRUE(list.Remove(CookingCommandID{ 1 }));
+	TEST_TRUE(list.Empty());
+};
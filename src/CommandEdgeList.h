@@ -0,0 +1,37 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include "Core.h"
+#include "CookingSystemIDs.h"
+
+#include <Bedrock/HashMap.h>
+#include <Bedrock/Vector.h>
+
+
+// List of the commands that use a file (as input or as output), in no particular order.
+// Most files are used by a handful of commands, but some (eg. a header included by every shader) can be used by tens of thousands.
+// Above cIndexThreshold commands, an index of their positions is added so that adding/removing/finding one stays O(1).
+struct CommandEdgeList : NoCopy
+{
+	static constexpr int cIndexThreshold = 64;
+
+	void                    Add(CookingCommandID inID);			// The command should not be in the list already.
+	bool                    Remove(CookingCommandID inID);		// Return false if the command wasn't in the list.
+	bool                    Contains(CookingCommandID inID) const { return Find(inID) != -1; }
+
+	bool                    Empty() const { return mCommands.Empty(); }
+	int                     Size() const { return mCommands.Size(); }
+	const CookingCommandID* begin() const { return mCommands.Begin(); }
+	const CookingCommandID* end() const { return mCommands.End(); }
+	                        operator Span<const CookingCommandID>() const { return mCommands; }
+
+private:
+	int                     Find(CookingCommandID inID) const;	// Return the position in mCommands, or -1 if not found.
+
+	Vector<CookingCommandID>       mCommands;
+	HashMap<CookingCommandID, int> mIndex;						// Position of each command in mCommands. Only filled for large lists, empty otherwise (and then doesn't allocate).
+};
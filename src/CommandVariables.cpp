@@ -117,19 +117,6 @@ REGISTER_TEST("ParseInt")
 	TEST_TRUE(i == 0);
 };
 
-namespace
-{
-
-struct Slice
-{
-	int mStart = 0;
-	int mEnd   = cMaxInt;
-
-	bool operator==(const Slice&) const = default;
-};
-
-}
-
 // Parse a python-like slice, ie. "[start:end]".
 // Both start and end are optional. The column is optional too if only start is provided.
 static bool sParseSlice(StringView inSliceStr, Slice& outSlice)
@@ -538,108 +525,206 @@ static StringView sGetCommandVarString(CommandVariables inVar, const FileInfo& i
 }
 
 
-// TODO add an output error string to help understand why it fails
-bool gFormatCommandString(StringView inFormatStr, const FileInfo& inFile, TempString& outString)
+bool CommandTemplate::CompileCommandString(StringView inFormatStr)
 {
+	// Consider empty format string is an error.
 	if (inFormatStr.Empty())
-		return false; // Consider empty format string is an error.
+	{
+		*this = {};
+		return false;
+	}
+
+	return Compile(inFormatStr, false);
+}
+
+
+bool CommandTemplate::CompileFilePath(StringView inFormatStr)
+{
+	if (!Compile(inFormatStr, true))
+		return false;
+
+	// Without a Repo, we wouldn't know where the file is.
+	if (mFilePathRepo == nullptr)
+	{
+		*this = {};
+		return false;
+	}
+
+	return true;
+}
+
 
-	return sParseCommandVariables(inFormatStr, [&inFile](CommandVariables inVar, StringView inRepoName, Slice inSlice, StringView inRemainingFormatStr, TempString& outStr) 
+bool CommandTemplate::Compile(StringView inFormatStr, bool inIsFilePath)
+{
+	*this = {};
+
+	// Use the same parser as the format functions, but only record the variables.
+	// The parser appends the literal text to its output, so everything added since the previous variable is the literal text before the current one.
+	int        literal_start = 0;
+	TempString literals;
+	bool       success = sParseCommandVariables(inFormatStr, [&](CommandVariables inVar, StringView inRepoName, Slice inSlice, StringView inRemainingFormatStr, TempString& outStr)
 	{
-		StringView var_str;
+		Token token;
+		token.mLiteralOffset = literal_start;
+		token.mLiteralSize   = outStr.Size() - literal_start;
+		token.mVar           = inVar;
+		token.mSlice         = inSlice;
+		token.mQuoteFollows  = inRemainingFormatStr.StartsWith(R"(")");
+		literal_start        = outStr.Size();
 
-		// Repo need to be treated separately, string is based on inRepoName rather than inFile.
 		if (inVar == CommandVariables::Repo)
 		{
-			if (FileRepo* repo = gFileSystem.FindRepo(inRepoName))
-				var_str = repo->mRootPath;
-			else
-				// Invalid repo name.
+			FileRepo* repo = gFileSystem.FindRepo(inRepoName);
+
+			// Invalid repo name.
+			if (repo == nullptr)
 				return false;
+
+			if (inIsFilePath)
+			{
+				// There can only be 1 Repo arg and it should be at the very beginning of the path.
+				if (mFilePathRepo != nullptr || !mTokens.Empty() || !outStr.Empty())
+					return false;
+
+				// Repo cannot be sliced.
+				if (inSlice != Slice())
+					return false;
+
+				// It's not part of the path, no token needed.
+				mFilePathRepo = repo;
+				return true;
+			}
+
+			token.mRepo        = repo;
+			mMaxRepoPathsSize += repo->mRootPath.Size();
 		}
 		else
 		{
-			// Get the string corresponding to this CommandVariable.
-			var_str = sGetCommandVarString(inVar, inFile);
+			mFileVarCount++;
 		}
 
-		// Apply the slice to it.
-		var_str = sApplySlice(var_str, inSlice);
+		mTokens.PushBack(token);
+		return true;
+	}, literals);
 
-		// Append to the output.
-		outStr.Append(var_str);
+	if (!success)
+	{
+		*this = {};
+		return false;
+	}
+
+	// Add the literal text after the last variable.
+	if (literal_start < literals.Size())
+	{
+		Token& token         = mTokens.EmplaceBack();
+		token.mLiteralOffset = literal_start;
+		token.mLiteralSize   = literals.Size() - literal_start;
+	}
+
+	mLiterals   = literals;
+	mIsFilePath = inIsFilePath;
+	mIsValid    = true;
+	return true;
+}
+
+
+// Return a size large enough for any formatted string, to allocate only once.
+int CommandTemplate::GetMaxSize(const FileInfo& inFile) const
+{
+	// All the file variables are parts of the path. Add one character per token for the escaped backslashes.
+	return mLiterals.Size() + mFileVarCount * inFile.mPath.Size() + mMaxRepoPathsSize + mTokens.Size();
+}
+
+
+bool CommandTemplate::FormatCommandString(const FileInfo& inFile, TempString& outString) const
+{
+	gAssert(!mIsFilePath);
+
+	outString.Clear();
+
+	if (!mIsValid)
+		return false;
+
+	outString.Reserve(GetMaxSize(inFile));
+
+	for (const Token& token : mTokens)
+	{
+		outString.Append(StringView(mLiterals).SubStr(token.mLiteralOffset, token.mLiteralSize));
+
+		if (token.mVar == CommandVariables::_Count)
+			continue;
+
+		StringView var_str = (token.mVar == CommandVariables::Repo) ? token.mRepo->mRootPath : sGetCommandVarString(token.mVar, inFile);
+		outString.Append(sApplySlice(var_str, token.mSlice));
 
 		// If the string ends with a backslash and the following character is a quote, the backslash will escape it and the command line won't work.
 		// In this case, add another backslash to escape the first one.
-		if (outStr.EndsWith(R"(\)") &&
-			inRemainingFormatStr.StartsWith(R"(")") &&
-			!outStr.EndsWith(R"(\\)")) // Already added the double backslash
+		if (token.mQuoteFollows &&
+			outString.EndsWith(R"(\)") &&
+			!outString.EndsWith(R"(\\)"))
 		{
-			outStr.Append(R"(\)");
+			outString.Append(R"(\)");
 		}
+	}
 
-		return true;
-	}, outString);
+	return true;
 }
 
 
-bool gFormatFilePath(StringView inFormatStr, const FileInfo& inFile, FileRepo*& outRepo, TempString& outPath)
+bool CommandTemplate::FormatFilePath(const FileInfo& inFile, FileRepo*& outRepo, TempString& outPath) const
 {
-	FileRepo*  repo = nullptr;
-	TempString out_path;
-
-	bool       success = sParseCommandVariables(
-        inFormatStr,
-        [&inFile, &repo](CommandVariables inVar, StringView inRepoName, Slice inSlice, StringView inRemainingFormatStr, TempString& outStr) {
-            // Repo need to be treated separately, string is based on inRepoName rather than inFile.
-            if (inVar == CommandVariables::Repo)
-            {
-                // There can only be 1 Repo arg and it should be at the very beginning of the path.
-                if (repo != nullptr || !outStr.Empty())
-                    return false;
-
-                // Repo cannot be sliced.
-                if (inSlice != Slice())
-                    return false;
-
-                repo = gFileSystem.FindRepo(inRepoName);
-
-                // Invalid repo name.
-                if (repo == nullptr)
-                    return false;
-            }
-            else
-            {
-                // Get the string corresponding to this CommandVariable.
-                StringView var_str = sGetCommandVarString(inVar, inFile);
-
-                // Apply the slice to it.
-                var_str = sApplySlice(var_str, inSlice);
-
-                // Append to the output.
-                outStr.Append(var_str);
-            }
-
-            return true;
-        },
-        out_path);
+	gAssert(mIsFilePath);
 
-	if (!success)
+	outPath.Clear();
+
+	if (!mIsValid)
 		return false;
 
-	outRepo = repo;
-	outPath = gMove(out_path);
+	outPath.Reserve(GetMaxSize(inFile));
+
+	for (const Token& token : mTokens)
+	{
+		outPath.Append(StringView(mLiterals).SubStr(token.mLiteralOffset, token.mLiteralSize));
+
+		if (token.mVar != CommandVariables::_Count)
+			outPath.Append(sApplySlice(sGetCommandVarString(token.mVar, inFile), token.mSlice));
+	}
+
+	outRepo = mFilePathRepo;
 	return true;
 }
 
 
-FileID gGetOrAddFileFromFormat(StringView inFormatStr, const FileInfo& inFile)
+REGISTER_TEST("CommandTemplate")
 {
-	FileRepo*  repo = nullptr;
-	TempString path;
+	// Make sure temp memory is initialized or the tests will fail.
+	TEST_INIT_TEMP_MEMORY(4_KiB);
 
-	if (!gFormatFilePath(inFormatStr, inFile, repo, path))
-		return FileID::cInvalid();
+	FileInfo file({}, R"(textures\rock\rock_albedo.png)", {}, FileType::File, {});
 
-	return repo->GetOrAddFile(path, FileType::File, {}).mID;
-}
+	CommandTemplate command;
+	TempString      result;
+
+	TEST_TRUE(command.CompileCommandString(R"(tool.exe {Path} "{Dir}" {Dir_NoTrailingSlash}\{File[-6:]}.dds{Ext})"));
+	TEST_TRUE(command.FormatCommandString(file, result));
+	TEST_TRUE(result == R"(tool.exe textures\rock\rock_albedo.png "textures\rock\\" textures\rock\albedo.dds.png)");
+
+	TEST_TRUE(command.CompileCommandString("JustText"));
+	TEST_TRUE(command.FormatCommandString(file, result));
+	TEST_TRUE(result == "JustText");
+
+	// Invalid formats.
+	TEST_FALSE(command.CompileCommandString(""));
+	TEST_FALSE(command.IsValid());
+	TEST_FALSE(command.FormatCommandString(file, result));
+	TEST_TRUE(result.Empty());
+
+	TEST_FALSE(command.CompileCommandString("{ file }"));
+	TEST_FALSE(command.CompileCommandString("{ File and more things"));
+	TEST_FALSE(command.CompileCommandString("{ Repo:DoesNotExist }"));
+
+	// File paths need to start with a Repo.
+	CommandTemplate path;
+	TEST_FALSE(path.CompileFilePath(R"({Dir}{File}.dds)"));
+	TEST_FALSE(path.IsValid());
+};
@@ -7,10 +7,10 @@
 
 #include "Core.h"
 #include <Bedrock/String.h>
+#include <Bedrock/Vector.h>
 
 struct FileInfo;
 struct FileRepo;
-struct FileID;
 
 
 enum class CommandVariables : uint8
@@ -41,15 +41,49 @@ constexpr StringView gToStringView(CommandVariables inVar)
 };
 
 
-// Check for CommandVariables and replace them by the corresponding part of inFile.
-// Eg. "copy.exe {Repo:Source}{Path} {Repo:Bin}" will turn into "copy.exe D:/src/file.txt D:/bin/"
-bool gFormatCommandString(StringView inFormatStr, const FileInfo& inFile, TempString& outString);
+// Python-like slice applied to a CommandVariable, eg. "{File[0:-1]}".
+struct Slice
+{
+	int mStart = 0;
+	int mEnd   = cMaxInt;
 
+	bool operator==(const Slice&) const = default;
+};
 
-// Check for CommandVariables and replace them by the corresponding part of inFile but expects the string to be a single file path.
-// One Repo var is needed at the start and of the path and the corresponding FileRepo will be returned instead of be replaced by its path.
-bool gFormatFilePath(StringView inFormatStr, const FileInfo& inFile, FileRepo*& outRepo, TempString& outPath);
 
+// Format string containing CommandVariables, parsed once to format it for many files without parsing it again or looking up repos by name.
+// As a command string, CommandVariables are replaced by the corresponding part of the file.
+//   Eg. "copy.exe {Repo:Source}{Path} {Repo:Bin}" will turn into "copy.exe D:/src/file.txt D:/bin/"
+// As a file path, one Repo var is needed at the start of the path, and the corresponding FileRepo is returned instead of being replaced by its path.
+struct CommandTemplate
+{
+	bool CompileCommandString(StringView inFormatStr);	// Return false if the format string is invalid.
+	bool CompileFilePath(StringView inFormatStr);		// Same, but also needs the path to start with a Repo.
+	bool IsValid() const { return mIsValid; }
 
-// Format the file path and get (or add) the corresponding file. Return an invalid FileID if the format is invalid.
-FileID gGetOrAddFileFromFormat(StringView inFormatStr, const FileInfo& inFile);
+	bool FormatCommandString(const FileInfo& inFile, TempString& outString) const;			// Return false if the template isn't valid.
+	bool FormatFilePath(const FileInfo& inFile, FileRepo*& outRepo, TempString& outPath) const;	// Return false if the template isn't valid.
+
+private:
+	// A variable and the literal text before it.
+	struct Token
+	{
+		int              mLiteralOffset = 0;						// Position in mLiterals.
+		int              mLiteralSize   = 0;
+		CommandVariables mVar           = CommandVariables::_Count; // _Count if there's only literal text (last token).
+		Slice            mSlice;
+		FileRepo*        mRepo          = nullptr;					// Only for Repo variables.
+		bool             mQuoteFollows  = false;					// True if the format string continues with a quote (see FormatCommandString).
+	};
+
+	bool Compile(StringView inFormatStr, bool inIsFilePath);
+	int  GetMaxSize(const FileInfo& inFile) const;
+
+	String        mLiterals;
+	Vector<Token> mTokens;
+	FileRepo*     mFilePathRepo     = nullptr;	// Only for file paths.
+	int           mFileVarCount     = 0;		// Number of variables that depend on the file.
+	int           mMaxRepoPathsSize = 0;		// Total size of the root paths of the Repo variables.
+	bool          mIsFilePath       = false;
+	bool          mIsValid          = false;
+};
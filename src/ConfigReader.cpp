@@ -97,4 +97,7 @@ void gReadConfigFile(StringView inPath)
 
 	// Read the window title.
 	reader.TryRead("WindowTitle", gApp.mMainWindowTitle);
+
+	// Read the output request pipe name.
+	reader.TryRead("RequestPipeName", gApp.mRequestPipeName);
 }
@@ -0,0 +1,248 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include "CookOutput.h"
+#include "App.h"
+#include "Debug.h"
+#include "FileUtils.h"
+#include <Bedrock/Mutex.h>
+#include <Bedrock/StringFormat.h>
+#include <Bedrock/Test.h>
+
+#include "win32/file.h"
+#include "win32/io.h"
+
+
+// Outputs larger than this are spilled to the session output file.
+constexpr int cMaxInMemoryOutputSize = 32 * 1024;
+constexpr int cKeptHeadSize          = 8 * 1024;
+constexpr int cKeptTailSize          = 16 * 1024;
+constexpr int cKeptErrorLinesSize    = 6 * 1024;
+static_assert(cKeptHeadSize + cKeptTailSize + cKeptErrorLinesSize < cMaxInMemoryOutputSize);
+
+
+static Mutex       sOutputFileMutex;
+static OwnedHandle sOutputFile;
+static int64       sOutputFileSize = 0;
+static bool        sOutputFileFailed = false;
+
+
+// Open the session output file if it's not open yet. It's deleted automatically when the process exits.
+static bool sOpenOutputFile()
+{
+	if (sOutputFile.IsValid())
+		return true;
+
+	if (sOutputFileFailed)
+		return false; // Don't try again for every cook.
+
+	StringView log_path = gApp.mLogFilePath;
+	if (gEndsWith(log_path, ".log"))
+		log_path = log_path.SubStr(0, log_path.Size() - 4);
+
+	TempString path = gTempFormat("%s_CookOutput.tmp", TempString(log_path).AsCStr());
+
+	sOutputFile = CreateFileA(path.AsCStr(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, CREATE_ALWAYS,
+							  FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+
+	if (!sOutputFile.IsValid())
+	{
+		sOutputFileFailed = true;
+		gAppLogError(R"(Failed to create cook output file "%s" - %s)", path.AsCStr(), GetLastErrorString().AsCStr());
+		return false;
+	}
+
+	return true;
+}
+
+
+// Append the output to the session output file. Return an invalid ref on failure.
+static CookOutputRef sWriteOutputFile(StringView inOutput)
+{
+	CookOutputRef ref;
+	{
+		LockGuard lock(sOutputFileMutex);
+
+		if (!sOpenOutputFile())
+			return {};
+
+		// Only reserve the space inside the lock, the write itself uses an explicit offset.
+		ref.mOffset      = sOutputFileSize;
+		ref.mSize        = inOutput.Size();
+		sOutputFileSize += inOutput.Size();
+	}
+
+	OVERLAPPED overlapped = {};
+	overlapped.Offset     = (DWORD)(ref.mOffset & 0xFFFFFFFF);
+	overlapped.OffsetHigh = (DWORD)(ref.mOffset >> 32);
+
+	DWORD bytes_written = 0;
+	if (!WriteFile(sOutputFile, inOutput.Data(), (DWORD)inOutput.Size(), &bytes_written, &overlapped) || bytes_written != (DWORD)inOutput.Size())
+	{
+		gAppLogError("Failed to write cook output file - %s", GetLastErrorString().AsCStr());
+		return {};
+	}
+
+	return ref;
+}
+
+
+// Keep the head and the tail of the output, and the error lines in between (as long as there aren't too many).
+static void sShrinkOutput(StringView inOutput, TempString& outShrunk)
+{
+	gAssert(inOutput.Size() > cMaxInMemoryOutputSize);
+
+	// Cut the head at the end of its last full line.
+	StringView head     = inOutput.SubStr(0, cKeptHeadSize);
+	int        head_end = head.FindLastOf("\n");
+	if (head_end != -1)
+		head = head.SubStr(0, head_end + 1);
+
+	// Cut the tail at the start of its first full line.
+	StringView tail       = inOutput.SubStr(inOutput.Size() - cKeptTailSize);
+	int        tail_start = tail.Find('\n');
+	if (tail_start != -1)
+		tail = tail.SubStr(tail_start + 1);
+
+	StringView middle = inOutput.SubStr(head.Size(), inOutput.Size() - head.Size() - tail.Size());
+
+	outShrunk += head;
+	gAppendFormat(outShrunk, "\n[...] %s of output not kept in memory, load the full output to see it.\n", gFormatSizeInBytes(middle.Size()).AsCStr());
+
+	int error_lines_size    = 0;
+	int omitted_error_lines = 0;
+	while (!middle.Empty())
+	{
+		int        line_end = middle.Find('\n');
+		StringView line     = (line_end == -1) ? middle : middle.SubStr(0, line_end + 1);
+		middle              = middle.SubStr(line.Size());
+
+		if (line.Find("[error]") == -1)
+			continue;
+
+		if (error_lines_size + line.Size() > cKeptErrorLinesSize)
+		{
+			omitted_error_lines++;
+			continue;
+		}
+
+		outShrunk += line;
+		error_lines_size += line.Size();
+
+		if (line_end == -1)
+			outShrunk += "\n";
+	}
+
+	if (omitted_error_lines > 0)
+		gAppendFormat(outShrunk, "[...] %d more error lines not kept in memory.\n", omitted_error_lines);
+
+	outShrunk += "[...]\n\n";
+	outShrunk += tail;
+}
+
+
+CookOutputRef gSpillCookOutput(StringPool::ResizableStringView& ioOutput)
+{
+	StringView output = ioOutput.AsStringView();
+	if (output.Size() <= cMaxInMemoryOutputSize)
+		return {};
+
+	CookOutputRef ref = sWriteOutputFile(output);
+
+	// Shrink even if writing to the file failed, it's better than keeping everything in memory forever.
+	TempString shrunk;
+	sShrinkOutput(output, shrunk);
+
+	ioOutput.Shrink(0);
+	ioOutput.Append(shrunk);
+
+	return ref;
+}
+
+
+StringView gSpillCookOutput(StringView inOutput, TempString& outShrunkStorage, CookOutputRef& outFullOutput)
+{
+	outFullOutput = {};
+
+	if (inOutput.Size() <= cMaxInMemoryOutputSize)
+		return inOutput;
+
+	outFullOutput = sWriteOutputFile(inOutput);
+
+	sShrinkOutput(inOutput, outShrunkStorage);
+
+	return outShrunkStorage;
+}
+
+
+bool gReadCookOutput(CookOutputRef inFullOutput, String& outOutput)
+{
+	outOutput.Clear();
+
+	if (!inFullOutput.IsValid())
+		return false;
+
+	outOutput.Resize(inFullOutput.mSize);
+
+	if (!gReadCookOutputFile(inFullOutput, Span(outOutput.Data(), outOutput.Size())))
+	{
+		outOutput.Clear();
+		return false;
+	}
+
+	return true;
+}
+
+
+CookOutputRef gWriteCookOutputFile(Span<const char> inData)
+{
+	return sWriteOutputFile(StringView(inData.Data(), inData.Size()));
+}
+
+
+bool gReadCookOutputFile(CookOutputRef inRef, Span<char> outData)
+{
+	gAssert(inRef.mSize == outData.Size());
+
+	if (!inRef.IsValid() || !sOutputFile.IsValid())
+		return false;
+
+	OVERLAPPED overlapped = {};
+	overlapped.Offset     = (DWORD)(inRef.mOffset & 0xFFFFFFFF);
+	overlapped.OffsetHigh = (DWORD)(inRef.mOffset >> 32);
+
+	DWORD bytes_read = 0;
+	if (!ReadFile(sOutputFile, outData.Data(), (DWORD)outData.Size(), &bytes_read, &overlapped) || bytes_read != (DWORD)outData.Size())
+	{
+		gAppLogError("Failed to read cook output file - %s", GetLastErrorString().AsCStr());
+		return false;
+	}
+
+	return true;
+}
+
+
+REGISTER_TEST("ShrinkOutput")
+{
+	// Make sure temp memory is initialized or the tests will fail.
+	TEST_INIT_TEMP_MEMORY(256_KiB);
+
+	TempString output;
+	for (int i = 0; output.Size() <= cMaxInMemoryOutputSize * 2; ++i)
+	{
+		if (i == 3000)
+			output += "[error] Something went wrong.\n";
+		else
+			gAppendFormat(output, "Line %d\n", i);
+	}
+
+	TempString shrunk;
+	sShrinkOutput(output, shrunk);
+
+	TEST_TRUE(shrunk.Size() <= cMaxInMemoryOutputSize);
+	TEST_TRUE(gStartsWith(shrunk, "Line 0\n"));
+	TEST_TRUE(gEndsWith(shrunk, StringView(output).SubStr(output.Size() - 100)));
+	TEST_TRUE(shrunk.Find("[error] Something went wrong.\n") != -1);
+};
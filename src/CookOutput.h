@@ -0,0 +1,38 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include "Core.h"
+#include "StringPool.h"
+
+
+// Location of a full cook output in the session output file.
+// Only outputs that were too large to be kept entirely in memory are written there.
+struct CookOutputRef
+{
+	int64 mOffset = -1;
+	int   mSize   = 0;
+
+	bool IsValid() const { return mOffset >= 0; }
+};
+
+
+// If the output is too large, write it to the session output file and shrink it in place to its head, its tail and its error lines.
+// Return an invalid ref if the output was small enough to be kept as is.
+CookOutputRef gSpillCookOutput(StringPool::ResizableStringView& ioOutput);
+
+// Same as above for an output that isn't in a string pool (doesn't need to be null terminated).
+// Return either inOutput itself, or the shrunk version stored in outShrunkStorage.
+StringView    gSpillCookOutput(StringView inOutput, TempString& outShrunkStorage, CookOutputRef& outFullOutput);
+
+// Read a full output back from the session output file. Return false on failure.
+bool          gReadCookOutput(CookOutputRef inFullOutput, String& outOutput);
+
+// Append raw data to the session output file (eg. archived cooking log outputs). Return an invalid ref on failure.
+CookOutputRef gWriteCookOutputFile(Span<const char> inData);
+
+// Read raw data back from the session output file. The size of outData must match the size of the ref.
+bool          gReadCookOutputFile(CookOutputRef inRef, Span<char> outData);
@@ -0,0 +1,202 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include "CookingLog.h"
+#include "App.h"
+#include "CookingSystem.h"
+#include "CookOutput.h"
+
+#include "lz4.h"
+
+
+void CookingLogStorage::SetOutput(CookingLogEntry& ioEntry, StringView inOutput)
+{
+	CookingLogOutput& output = ioEntry.mOutput;
+	gAssert(output.mTier == CookingLogTier::Hot);
+
+	int previous_size = output.mHotData.Size();
+
+	output.mHotData.Resize(inOutput.Size(), EResizeInit::NoZeroInit);
+	gMemCopy(output.mHotData.Data(), inOutput.Data(), inOutput.Size());
+	output.mSize = inOutput.Size();
+
+	LockGuard lock(mMutex);
+	mStats.mHotSize += output.mSize - previous_size;
+}
+
+
+void CookingLogStorage::SetSharedOutput(CookingLogEntry& ioEntry, const CookingLogEntry& inOwner)
+{
+	CookingLogOutput& output = ioEntry.mOutput;
+	gAssert(output.mTier == CookingLogTier::Hot && output.mHotData.Empty());
+	gAssert(!inOwner.mOutput.mSharedWith.IsValid()); // Only one level of sharing.
+
+	// Nothing stored here, so nothing to compress or archive later either.
+	output.mSharedWith = inOwner.mID;
+	output.mSize       = 0;
+}
+
+
+bool CookingLogStorage::ReadOutput(const CookingLogEntry& inEntry, String& outOutput)
+{
+	if (inEntry.mOutput.mSharedWith.IsValid())
+		return ReadOutput(gCookingSystem.GetLogEntry(inEntry.mOutput.mSharedWith), outOutput);
+
+	LockGuard lock(mMutex);
+
+	const CookingLogOutput& output = inEntry.mOutput;
+
+	outOutput.Clear();
+
+	if (output.mTier == CookingLogTier::Hot)
+	{
+		outOutput = StringView(output.mHotData.Data(), output.mHotData.Size());
+		return true;
+	}
+
+	if (output.mSize == 0)
+		return true;
+
+	// Get the compressed data, from memory or from the archive.
+	Vector<char> archived_data;
+	const char*  compressed_data = nullptr;
+	if (output.mTier == CookingLogTier::Warm)
+	{
+		compressed_data = mWarmChunks[output.mChunkIndex].mData.Data() + output.mOffset;
+	}
+	else
+	{
+		archived_data.Resize(output.mCompressedSize, EResizeInit::NoZeroInit);
+		if (!gReadCookOutputFile({ output.mOffset, output.mCompressedSize }, archived_data))
+			return false;
+
+		compressed_data = archived_data.Data();
+	}
+
+	outOutput.Resize(output.mSize);
+	int decompressed_size = LZ4_decompress_safe(compressed_data, outOutput.Data(), output.mCompressedSize, output.mSize);
+	if (decompressed_size != output.mSize)
+	{
+		gAppLogError("Failed to decompress cooking log output.");
+		outOutput.Clear();
+		return false;
+	}
+
+	return true;
+}
+
+
+void CookingLogStorage::Update(VMemArray<CookingLogEntry>& ioEntries)
+{
+	LockGuard lock(mMutex);
+
+	// Compress the outputs of the entries that aren't recent anymore.
+	int hot_end = ioEntries.Size() - cHotEntryCount;
+	while (mFirstHotEntry < hot_end)
+	{
+		CookingLogEntry& entry = ioEntries[mFirstHotEntry];
+
+		// If it's still cooking, its output isn't set yet. Try again later.
+		if (entry.mCookingState.Load() <= CookingState::Cooking)
+			break;
+
+		Compress(entry);
+		mFirstHotEntry++;
+	}
+
+	// Archive the oldest chunks if there are too many in memory.
+	// Never archive the last chunk, it's the one still being filled.
+	while (mWarmSize > cMaxWarmSize && mFirstWarmChunk < mWarmChunks.Size() - 1)
+	{
+		if (!Archive(mWarmChunks[mFirstWarmChunk], ioEntries))
+			break; // Keep them in memory instead, better than losing them.
+
+		mFirstWarmChunk++;
+	}
+}
+
+
+void CookingLogStorage::Compress(CookingLogEntry& ioEntry)
+{
+	CookingLogOutput& output = ioEntry.mOutput;
+	gAssert(output.mTier == CookingLogTier::Hot);
+
+	mStats.mHotSize -= output.mHotData.Size();
+
+	if (output.mSize == 0)
+	{
+		// Nothing to compress, no need for a chunk.
+		output.mTier = CookingLogTier::Warm;
+		output.mHotData.ClearAndFreeMemory();
+		return;
+	}
+
+	// Start a new chunk if the current one is full.
+	if (mWarmChunks.Empty() || mWarmChunks.Back().mData.Size() >= cWarmChunkSize)
+	{
+		// Outputs are at most a few dozen KiB (larger ones are spilled, see gSpillCookOutput), reserve enough to not reallocate.
+		mWarmChunks.EmplaceBack();
+		mWarmChunks.Back().mData.Reserve(cWarmChunkSize + LZ4_compressBound(64 * 1024));
+	}
+
+	WarmChunk& chunk    = mWarmChunks.Back();
+	int        offset   = chunk.mData.Size();
+	int        max_size = LZ4_compressBound(output.mSize);
+
+	chunk.mData.Resize(offset + max_size, EResizeInit::NoZeroInit);
+	int compressed_size = LZ4_compress_default(output.mHotData.Data(), chunk.mData.Data() + offset, output.mSize, max_size);
+	gAssert(compressed_size > 0); // Can't fail since the destination is large enough.
+	chunk.mData.Resize(offset + compressed_size);
+	chunk.mEntries.PushBack(ioEntry.mID);
+
+	output.mTier           = CookingLogTier::Warm;
+	output.mChunkIndex     = mWarmChunks.Size() - 1;
+	output.mOffset         = offset;
+	output.mCompressedSize = compressed_size;
+	output.mHotData.ClearAndFreeMemory();
+
+	mWarmSize += compressed_size;
+}
+
+
+bool CookingLogStorage::Archive(WarmChunk& ioChunk, VMemArray<CookingLogEntry>& ioEntries)
+{
+	CookOutputRef ref = gWriteCookOutputFile(ioChunk.mData);
+	if (!ref.IsValid())
+		return false;
+
+	for (CookingLogEntryID entry_id : ioChunk.mEntries)
+	{
+		CookingLogOutput& output = ioEntries[entry_id.mIndex].mOutput;
+		gAssert(output.mTier == CookingLogTier::Warm);
+
+		output.mTier        = CookingLogTier::Archived;
+		output.mOffset     += ref.mOffset;
+		output.mChunkIndex  = -1;
+	}
+
+	mStats.mArchivedEntryCount += ioChunk.mEntries.Size();
+	mStats.mArchivedSize       += ioChunk.mData.Size();
+	mWarmSize                  -= ioChunk.mData.Size();
+
+	ioChunk.mData.ClearAndFreeMemory();
+	ioChunk.mEntries.ClearAndFreeMemory();
+
+	return true;
+}
+
+
+CookingLogStorage::Stats CookingLogStorage::GetStats()
+{
+	LockGuard lock(mMutex);
+
+	Stats stats           = mStats;
+	stats.mWarmSize       = mWarmSize;
+	stats.mWarmEntryCount = 0;
+	for (int i = mFirstWarmChunk; i < mWarmChunks.Size(); ++i)
+		stats.mWarmEntryCount += mWarmChunks[i].mEntries.Size();
+
+	return stats;
+}
@@ -0,0 +1,87 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include "Core.h"
+#include "VMemArray.h"
+#include "CookingSystemIDs.h"
+
+#include <Bedrock/Mutex.h>
+#include <Bedrock/String.h>
+#include <Bedrock/Vector.h>
+
+struct CookingLogEntry;
+
+
+// Where the output of a cooking log entry is stored.
+enum class CookingLogTier : uint8
+{
+	Hot,		// Recent entries, output kept as is.
+	Warm,		// Older entries, output LZ4 compressed in a memory chunk.
+	Archived,	// Oldest entries, compressed output moved to the session output file.
+};
+
+
+// Output of a cooking log entry. Only accessed through CookingLogStorage.
+struct CookingLogOutput
+{
+	CookingLogTier    mTier           = CookingLogTier::Hot;
+	int               mSize           = 0;	// Uncompressed size.
+	int               mCompressedSize = 0;	// Warm and Archived only.
+	int               mChunkIndex     = -1;	// Warm only.
+	int64             mOffset         = 0;	// Offset in the chunk (Warm) or in the session output file (Archived).
+	Vector<char>      mHotData;				// Hot only.
+	CookingLogEntryID mSharedWith;			// If valid, the output is the one of that entry and nothing is stored here (eg. the other commands of a batch).
+};
+
+
+// Keeps the memory used by the outputs of the cooking log flat in long sessions.
+// The log entries themselves are never moved or removed, so their IDs and pointers stay stable.
+struct CookingLogStorage : NoCopy
+{
+	static constexpr int cHotEntryCount = 1000;				// Number of recent entries that keep their output uncompressed.
+	static constexpr int cWarmChunkSize = 1024 * 1024;		// Compressed outputs are grouped in chunks of that size.
+	static constexpr int cMaxWarmSize   = 32 * 1024 * 1024;	// Total size of the chunks kept in memory before archiving the oldest ones.
+
+	// Set the output of an entry that is still cooking (ie. not visible to Update yet).
+	void             SetOutput(CookingLogEntry& ioEntry, StringView inOutput);
+
+	// Same, but reuse the output of another entry instead of storing a copy. inOwner must be finished cooking before ioEntry.
+	void             SetSharedOutput(CookingLogEntry& ioEntry, const CookingLogEntry& inOwner);
+
+	// Get a copy of the output of a finished entry, whatever its tier. Thread safe.
+	bool             ReadOutput(const CookingLogEntry& inEntry, String& outOutput);
+
+	// Move the outputs of old entries to the colder tiers.
+	void             Update(VMemArray<CookingLogEntry>& ioEntries);
+
+	struct Stats
+	{
+		int   mWarmEntryCount     = 0;
+		int   mArchivedEntryCount = 0;
+		int64 mHotSize            = 0;
+		int64 mWarmSize           = 0; // Compressed.
+		int64 mArchivedSize       = 0; // Compressed.
+	};
+	Stats            GetStats();
+
+private:
+	struct WarmChunk
+	{
+		Vector<char>              mData;
+		Vector<CookingLogEntryID> mEntries;
+	};
+
+	void             Compress(CookingLogEntry& ioEntry);
+	bool             Archive(WarmChunk& ioChunk, VMemArray<CookingLogEntry>& ioEntries);
+
+	Mutex             mMutex;
+	Vector<WarmChunk> mWarmChunks;          // Archived chunks are kept (empty) to keep the indices stable.
+	int               mFirstHotEntry  = 0;  // Index of the oldest entry that is still hot.
+	int               mFirstWarmChunk = 0;  // Index of the oldest chunk that isn't archived yet.
+	int64             mWarmSize       = 0;
+	Stats             mStats;
+};
@@ -7,6 +7,7 @@
 #include "App.h"
 #include "Debug.h"
 #include "DepFile.h"
+#include "DepFileScanner.h"
 #include "Notifications.h"
 #include "CommandVariables.h"
 #include "UI.h"
@@ -16,11 +17,16 @@
 #include <Bedrock/Random.h>
 #include <Bedrock/StringFormat.h>
 
-#include "subprocess/subprocess.h"
 #include "win32/file.h"
 #include "win32/misc.h"
 #include "win32/process.h"
 
+// Not in WindowsHModular.
+extern "C" __declspec(dllimport) BOOL WINAPI GetPhysicallyInstalledSystemMemory(uint64* TotalMemoryInKilobytes);
+extern "C" __declspec(dllimport) BOOL WINAPI GetSystemTimes(_FILETIME* lpIdleTime, _FILETIME* lpKernelTime, _FILETIME* lpUserTime);
+extern "C" __declspec(dllimport) BOOL WINAPI CreateTimerQueueTimer(HANDLE* phNewTimer, HANDLE TimerQueue, void (WINAPI* Callback)(void*, BOOLEAN), void* Parameter, DWORD DueTime, DWORD Period, ULONG Flags);
+extern "C" __declspec(dllimport) BOOL WINAPI DeleteTimerQueueTimer(HANDLE TimerQueue, HANDLE Timer, HANDLE CompletionEvent);
+
 
 // Debug toggle to fake cooking failures, to test error handling.
 bool gDebugFailCookingRandomly = false;
@@ -38,141 +44,24 @@ constexpr bool gPushBackUnique(taContainer& ioContainer, const taValue& inElem)
 }
 
 
-// Test a path against a pattern. Return true if the path matches the pattern (case-insensitive).
-// Pattern supports wild cards '*' (any number of characters) and '?' (single character).
-bool gMatchPath(StringView inPath, StringView inPattern)
+bool InputFilter::Pass(const FileInfo& inFile) const
 {
-	gAssert(!inPattern.Empty());
-	gAssert(gIsNormalized(inPath) && gIsNormalized(inPattern));
-
-	// Convert the path and pattern to lowercase to make sure the search is case-insensitive.
-	TempString path_lowercase = inPath;
-	gToLowercase(path_lowercase);
-	TempString pattern_lowercase = inPattern;
-	gToLowercase(pattern_lowercase);
-
-	StringView str          = path_lowercase;
-	StringView pattern      = pattern_lowercase;
-	bool       pending_star = false;
-
-	while (true)
-	{
-		// Find the next wild card in the pattern.
-		int next_wildcard_index = pattern.FindFirstOf("?*");
-
-		// If the next char isn't a wild card and we have a pending '*', process it now.
-		// This case happens when we encounter '*?'. More explanations where pending_star is set to true below.
-		if (next_wildcard_index != 0 && pending_star)
-		{
-			pending_star = false;
-
-			// If the pattern ends with '*', it's an automatic match.
-			if (pattern.Empty())
-				return true;
-
-			// Find where the string starts matching the pattern again.
-			StringView pattern_until_next_wildcard = pattern.SubStr(0, pattern.FindFirstOf("?*"));
-			int next_match = str.Find(pattern_until_next_wildcard);
-
-			// Never? Then it's a fail.
-			if (next_match == -1)
-				return false;
-
-			// Skip to where it matches again.
-			str.RemovePrefix(next_match);
-		}
-
-		// Strings should be equal until there (or until end of the string).
-		if (str.SubStr(0, next_wildcard_index) != pattern.SubStr(0, next_wildcard_index))
-			return false;
-
-		// If there was no wild card, we're done! Strings match.
-		if (next_wildcard_index == -1)
-			return true;
-
-		// Skip the parts that match.
-		str.RemovePrefix(next_wildcard_index);
-		pattern.RemovePrefix(next_wildcard_index);
-
-		// Also skip the wild card, but keep a copy.
-		char wild_card = pattern[0];
-		pattern.RemovePrefix(1);
-
-		if (wild_card == '?')
-		{
-			// If there is no character left, it's a fail.
-			if (str.Size() < 1)
-				return false;
-
-			// Skip one character.
-			str.RemovePrefix(1);
-		}
-		else
-		{
-			gAssert(wild_card == '*');
-
-			// If the pattern ends with '*', it's an automatic match.
-			if (pattern.Empty())
-				return true;
-
-			// If the * is followed by another '*', continue to process the next wild card directly, '**' is equivalent to '*'.
-			if (pattern[0] == '*')
-				continue;
-
-			// If the '*' is followed by '?', it is THE annoying case.
-			// '*?' is equivalent to '?*', so continue to process the '?', but remember we have a pending '*'.
-			// This way both '*???' and '*?*?*?' will just be interpreted as '???*'.
-			if (pattern[0] == '?')
-			{
-				pending_star = true;
-				continue;
-			}
-
-			// Clear the pending '*' if we encounter another one.
-			pending_star = false;
-
-			// Find where the string starts matching the pattern again.
-			StringView pattern_until_next_wildcard = pattern.SubStr(0, pattern.FindFirstOf("?*"));
-			int next_match = str.Find(pattern_until_next_wildcard);
-
-			// Never? Then it's a fail.
-			if (next_match == -1)
-				return false;
+	if (mRepoIndex != inFile.mID.mRepoIndex)
+		return false;
 
-			// Skip to where it matches again.
-			str.RemovePrefix(next_match);
-		}
-	}
+	return mCompiledPathPattern.Match(inFile.mPath);
 }
 
 
-REGISTER_TEST("MatchPath")
+Span<const FileID> CookingCommand::GetDepFileInputs() const
 {
-	TEST_TRUE(gMatchPath ("YOYO.txt", "yoyo.txt"));
-	TEST_TRUE(gMatchPath ("YOYO.txt", "*.txt"));
-	TEST_TRUE(gMatchPath ("YOYO.txt", "y?yo.txt"));
-	TEST_TRUE(gMatchPath ("YOYO.txt", "????????"));
-	TEST_TRUE(gMatchPath ("YOYO.txt", "*"));
-	TEST_TRUE(gMatchPath ("YOYO.txt", "?*"));
-	TEST_TRUE(gMatchPath ("YOYO.txt", "**"));
-	TEST_TRUE(gMatchPath ("YOYO.txt", "*?"));
-	TEST_TRUE(gMatchPath ("YOYO.txt", "*?oyo.txt"));
-	TEST_TRUE(gMatchPath ("YOYO.txt", "*????.txt"));
-	TEST_TRUE(gMatchPath ("YOYO.txt", "y*?*?*?.txt"));
-	TEST_TRUE(gMatchPath ("YOYO.txt", "y*y*.txt"));
-	TEST_TRUE(gMatchPath ("YOYO.txt", "y*?.*"));
-	TEST_FALSE(gMatchPath("Y.txt", "y*?.*"));
-	TEST_FALSE(gMatchPath("YOYO.txt", "yoyo.txt*?"));
-	TEST_TRUE(gMatchPath("medium_house\\texture_albedo.png", "*_albedo.*"));
-};
+	return gCookingSystem.GetDepFileSets().Get(mDepFileInputs);
+}
 
 
-bool InputFilter::Pass(const FileInfo& inFile) const
+Span<const FileID> CookingCommand::GetDepFileOutputs() const
 {
-	if (mRepoIndex != inFile.mID.mRepoIndex)
-		return false;
-
-	return gMatchPath(inFile.mPath, mPathPattern);
+	return gCookingSystem.GetDepFileSets().Get(mDepFileOutputs);
 }
 
 
@@ -188,19 +77,25 @@ FileID CookingCommand::GetDepFile() const
 }
 
 
-void CookingCommand::UpdateDirtyState()
+bool CookingCommand::NeedsToReadDepFile() const
+{
+	FileID dep_file = GetDepFile();
+	return dep_file.IsValid() && dep_file.GetFile().mLastChangeUSN != mLastDepFileRead;
+}
+
+
+void CookingCommand::UpdateDirtyState(DepFileContent* ioPrefetchedDepFile/* = nullptr*/)
 {
 	// Dirty state should not be updated while still cooking!
 	gAssert(!mLastCookingLog || mLastCookingLog->mCookingState.Load() > CookingState::Cooking);
 
 	DirtyState dirty_state = NotDirty;
 
-	FileID dep_file = GetDepFile();
 	// If the dep file is out of date, read it. The dirty state depends on its content.
 	// Note: This is updating the InputOf/OutputOf lists in FileInfos, which isn't thread safe, so it can't be done on the Cooking Threads.
-	if (dep_file.IsValid() && dep_file.GetFile().mLastChangeUSN != mLastDepFileRead)
+	if (NeedsToReadDepFile())
 	{
-		if (ReadDepFile())
+		if (ReadDepFile(ioPrefetchedDepFile))
 		{
 			// Update the last cook USN again now that we know all the inputs.
 			// TODO this does not work if multiple drives are involved, we can only compare USNs from the same journal
@@ -219,6 +114,10 @@ void CookingCommand::UpdateDirtyState()
 	if (mLastCookRuleVersion != GetRule().mVersion)
 		dirty_state |= VersionMismatch;
 
+	// Same if the rule was edited in a way that changes what this command does.
+	if (mLastCookFingerprint != mFingerprint)
+		dirty_state |= FingerprintMismatch;
+
 	for (FileID file_id : GetAllInputs())
 	{
 		const FileInfo& file = file_id.GetFile();
@@ -263,9 +162,10 @@ void CookingCommand::UpdateDirtyState()
 	if (all_output_missing)
 		dirty_state |= AllOutputsMissing;
 
-	bool last_cook_is_waiting = mLastCookingLog && mLastCookingLog->mCookingState.Load() == CookingState::Waiting;
-	bool last_cook_is_cleanup = mLastCookingLog && mLastCookingLog->mIsCleanup;
-	bool last_cook_is_error   = mLastCookingLog && mLastCookingLog->mCookingState.Load() == CookingState::Error;
+	bool last_cook_is_waiting  = mLastCookingLog && mLastCookingLog->mCookingState.Load() == CookingState::Waiting;
+	bool last_cook_is_cleanup  = mLastCookingLog && mLastCookingLog->mIsCleanup;
+	bool last_cook_is_error    = mLastCookingLog && mLastCookingLog->mCookingState.Load() == CookingState::Error;
+	bool last_cook_is_canceled = mLastCookingLog && mLastCookingLog->mCookingState.Load() == CookingState::Canceled;
 
 	if (last_cook_is_error)
 		dirty_state |= Error;
@@ -281,6 +181,9 @@ void CookingCommand::UpdateDirtyState()
 			// TODO: setting the state to Success/Error should probably be grouped with mCommandsToCook.FinishedCooking into a function
 			log_entry.mCookingState.Store(CookingState::Success);
 
+			// Not waiting anymore, no need to keep the time out around.
+			gFileSystem.RemoveTimer(MonitorTimer::OutputTimeOut(log_entry.mID));
+
 			// Notify the system that this command has officially finished cooking.
 			gCookingSystem.mCommandsToCook.FinishedCooking(log_entry);
 
@@ -294,6 +197,10 @@ void CookingCommand::UpdateDirtyState()
 	if (last_cook_is_waiting)
 		return;
 
+	// Once up to date, the command goes back to the background lane.
+	if (!IsDirty())
+		mIsInteractive = false;
+
 	// The command wasn't dirty but is now.
 	if (IsDirty() && !mIsQueued)
 	{
@@ -303,7 +210,7 @@ void CookingCommand::UpdateDirtyState()
 		gCookingSystem.mCommandsDirty.Push(mID);
 
 		if (!gCookingSystem.IsCookingPaused())
-			gCookingSystem.mCommandsToCook.Push(mID);
+			gCookingSystem.QueueCommandToCook(*this);
 	}
 	// The command was dirty but isn't anymore.
 	else if (!IsDirty() && mIsQueued)
@@ -316,6 +223,7 @@ void CookingCommand::UpdateDirtyState()
 
 		// Don't care about the order in the cooking queue as much since it's not displayed (and might not be found if a worker already grabbed it).
 		gCookingSystem.mCommandsToCook.Remove(mID);
+		gCookingSystem.RemoveDebouncedCommand(mID);
 	}
 	// Special last case: the command is already dirty, had an error, and its inputs changed again since.
 	else if ((mDirtyState & Error) && (mDirtyState & InputChanged))
@@ -323,13 +231,29 @@ void CookingCommand::UpdateDirtyState()
 		// Try cooking again.
 		gAssert(mIsQueued);
 		if (!gCookingSystem.IsCookingPaused())
-			gCookingSystem.mCommandsToCook.Push(mID);
+			gCookingSystem.QueueCommandToCook(*this);
+	}
+	// The last cook was canceled because an input changed, cook again.
+	else if (last_cook_is_canceled && IsDirty())
+	{
+		gAssert(mIsQueued);
+		if (!gCookingSystem.IsCookingPaused())
+		{
+			// The dirty state can be updated several times before the command cooks again, make sure it's only queued once.
+			gCookingSystem.mCommandsToCook.Remove(mID);
+			gCookingSystem.QueueCommandToCook(*this);
+		}
+	}
+	// The command is already queued and its inputs might have changed again.
+	else if (IsDirty() && (mDirtyState & InputChanged))
+	{
+		(void)gCookingSystem.ExtendDebounce(*this);
 	}
 }
 
 
 
-bool CookingCommand::ReadDepFile()
+bool CookingCommand::ReadDepFile(DepFileContent* ioPrefetchedDepFile/* = nullptr*/)
 {
 	const FileInfo& dep_file = GetDepFile().GetFile();
 	gAssert(mLastDepFileRead != dep_file.mLastChangeUSN); // Don't read the dep file if it's not necessary.
@@ -342,8 +266,21 @@ bool CookingCommand::ReadDepFile()
 	// If the file is deleted, don't actually try to read it.
 	if (!dep_file.IsDeleted())
 	{
-		// Read the dep file.
-		if (!gReadDepFile(GetRule().mDepFileFormat, GetDepFile(), inputs, outputs))
+		bool success;
+		if (ioPrefetchedDepFile)
+		{
+			// The dep file was already read, just take its content.
+			success = ioPrefetchedDepFile->mSuccess;
+			inputs  = gMove(ioPrefetchedDepFile->mInputs);
+			outputs = gMove(ioPrefetchedDepFile->mOutputs);
+		}
+		else
+		{
+			// Read the dep file.
+			success = gReadDepFile(GetRule().mDepFileFormat, GetDepFile(), inputs, outputs);
+		}
+
+		if (!success)
 		{
 			// If the command was cooking, set its state to error.
 			if (mLastCookingLog && mLastCookingLog->mCookingState.Load() == CookingState::Waiting)
@@ -367,16 +304,16 @@ void CookingQueue::Push(CookingCommandID inCommandID, PushPosition inPosition/*
 	int priority = gCookingSystem.GetRule(command.mRuleID).mPriority;
 
 	LockGuard lock(mMutex);
-	PushInternal(lock, priority, inCommandID, inPosition);
+	PushInternal(lock, mPrioBuckets, priority, inCommandID, inPosition);
 }
 
 
-void CookingQueue::PushInternal(MutexLockGuard& ioLock, int inPriority, CookingCommandID inCommandID, PushPosition inPosition)
+void CookingQueue::PushInternal(MutexLockGuard& ioLock, Vector<PrioBucket>& ioBuckets, int inPriority, CookingCommandID inCommandID, PushPosition inPosition)
 {
 	gAssert(ioLock.GetMutex() == &mMutex);
 
 	// Find or add the bucket for that cooking priority.
-	PrioBucket& bucket = *gEmplaceSorted(mPrioBuckets, inPriority);
+	PrioBucket& bucket = *gEmplaceSorted(ioBuckets, inPriority);
 
 	// Add the command.
 	if (inPosition == PushPosition::Back)
@@ -417,21 +354,26 @@ bool CookingQueue::Remove(CookingCommandID inCommandID, RemoveOption inOption/*
 
 	LockGuard lock(mMutex);
 
+	bool removed = RemoveInternal(lock, mPrioBuckets, priority, inCommandID, inOption);
+	gAssert(removed || (inOption & RemoveOption::ExpectFound) == false);
+
+	return removed;
+}
+
+
+bool CookingQueue::RemoveInternal(MutexLockGuard& ioLock, Vector<PrioBucket>& ioBuckets, int inPriority, CookingCommandID inCommandID, RemoveOption inOption)
+{
+	gAssert(ioLock.GetMutex() == &mMutex);
+
 	// Find the bucket.
-	auto bucket_it = gFindSorted(mPrioBuckets, priority);
-	if (bucket_it == mPrioBuckets.end())
-	{
-		gAssert((inOption & RemoveOption::ExpectFound) == false);
+	auto bucket_it = gFindSorted(ioBuckets, inPriority);
+	if (bucket_it == ioBuckets.end())
 		return false;
-	}
 
 	// Find the command in the bucket.
 	auto it = gFind(bucket_it->mCommands, inCommandID);
 	if (it == bucket_it->mCommands.end())
-	{
-		gAssert((inOption & RemoveOption::ExpectFound) == false);
 		return false;
-	}
 
 	// Remove it.
 	if (inOption & RemoveOption::KeepOrder)
@@ -470,26 +412,38 @@ void CookingThreadsQueue::Push(CookingCommandID inCommandID, PushPosition inPosi
 {
 	const CookingCommand& command = gCookingSystem.GetCommand(inCommandID);
 	int priority = gCookingSystem.GetRule(command.mRuleID).mPriority;
+	CookingLane lane = command.mIsInteractive ? CookingLane::Interactive : CookingLane::Background;
 
 	{
 		LockGuard lock(mMutex);
-		PushInternal(lock, priority, inCommandID, inPosition);
+		PushInternal(lock, lane == CookingLane::Interactive ? mInteractivePrioBuckets : mPrioBuckets, priority, inCommandID, inPosition);
 
 		// Make sure the data array stays in sync (makes pop simpler).
-		gEmplaceSorted(mPrioData, priority);
+		gEmplaceSorted(lane == CookingLane::Interactive ? mInteractivePrioData : mPrioData, priority);
 	}
 
+	NotifyPush(lane);
+}
+
+
+void CookingThreadsQueue::NotifyPush(CookingLane inLane)
+{
 	// Wake up one thread to work on this.
 	mBarrier.NotifyOne();
+
+	// Interactive commands can also be cooked by the reserved threads, wake one of them too (whichever gets the lock first takes the command).
+	if (inLane == CookingLane::Interactive)
+		mInteractiveBarrier.NotifyOne();
 }
 
 
-CookingCommandID CookingThreadsQueue::Pop()
+CookingCommandID CookingThreadsQueue::Pop(bool inInteractiveOnly, CookingLane& outLane, Vector<CookingCommandID>& outBatch)
 {
+	outBatch.Clear();
+
 	LockGuard lock(mMutex);
 	gAssert(mPrioData.Size() == mPrioBuckets.Size());
-
-	int  non_empty_bucket_index = -1;
+	gAssert(mInteractivePrioData.Size() == mInteractivePrioBuckets.Size());
 
 	while (true)
 	{
@@ -498,62 +452,182 @@ CookingCommandID CookingThreadsQueue::Pop()
 		if (mStopRequested)
 			break;
 
-		// Wait for work.
-		mBarrier.Wait(lock);
+		// Interactive commands go first, someone is waiting for them.
+		CookingCommandID id = PopInternal(lock, CookingLane::Interactive, mInteractivePrioBuckets, mInteractivePrioData, outBatch);
+		if (id.IsValid())
+		{
+			outLane = CookingLane::Interactive;
+			return id;
+		}
 
-		// Find the first bucket containing command that can run.
-		for (int prio_index = 0; prio_index < mPrioBuckets.Size(); ++prio_index)
+		if (!inInteractiveOnly)
 		{
-			PrioBucket& bucket = mPrioBuckets[prio_index];
-			PrioData&   data   = mPrioData[prio_index];
+			id = PopInternal(lock, CookingLane::Background, mPrioBuckets, mPrioData, outBatch);
+			if (id.IsValid())
+			{
+				outLane = CookingLane::Background;
+				return id;
+			}
+		}
+
+		// Nothing can run yet, wait until more work is added or some commands are finished.
+		if (inInteractiveOnly)
+			mInteractiveBarrier.Wait(lock);
+		else
+			mBarrier.Wait(lock);
+	}
+
+	return CookingCommandID::cInvalid();
+}
+
+
+CookingCommandID CookingThreadsQueue::PopInternal(MutexLockGuard& ioLock, CookingLane inLane, Vector<PrioBucket>& ioBuckets, Vector<PrioData>& ioPrioData, Vector<CookingCommandID>& outBatch)
+{
+	gAssert(ioLock.GetMutex() == &mMutex);
+
+	// Find the first bucket containing command that can run.
+	for (int prio_index = 0; prio_index < ioBuckets.Size(); ++prio_index)
+	{
+		PrioBucket& bucket = ioBuckets[prio_index];
+		PrioData&   data   = ioPrioData[prio_index];
+
+		// If this bucket is empty but some commands are still being cooked, wait until they're finished before checking the next buckets.
+		if (bucket.mCommands.Empty() && data.mCommandsBeingCooked > 0)
+			break;
 
-			// If this bucket is empty but some commands are still being cooked, wait until they're finished before checking the next buckets.
-			if (bucket.mCommands.Empty() && data.mCommandsBeingCooked > 0)
+		if (!bucket.mCommands.Empty())
+		{
+			// Find the last command that has enough resources available to start (usually the last one).
+			// Commands of other rules can backfill the threads while heavier ones wait, but commands from the next buckets can't, they need to wait for this bucket to be done.
+			// Only look at the end of the bucket, no need to go through the entire backlog.
+			constexpr int cMaxBackfillSearch = 4096;
+			int           search_end         = gMax(0, bucket.mCommands.Size() - cMaxBackfillSearch);
+			int           command_index      = -1;
+			CookingRuleID blocked_rule_id    = CookingRuleID::cInvalid();
+
+			for (int i = bucket.mCommands.Size() - 1; i >= search_end; --i)
 			{
-				// Go back to waiting and start over if more work is added or these commands are finished.
-				break;
+				const CookingRule& rule = gCookingSystem.GetCommand(bucket.mCommands[i]).GetRule();
+				if (rule.mID == blocked_rule_id)
+					continue;
+
+				if (CanStartRunning(ioLock, inLane, rule))
+				{
+					command_index = i;
+					break;
+				}
+
+				blocked_rule_id = rule.mID; // Commands of a rule tend to be next to each other, avoid testing them again.
 			}
 
-			if (!bucket.mCommands.Empty())
+			if (command_index == -1)
 			{
-				// Found one!
-				non_empty_bucket_index = (int)(&bucket - &mPrioBuckets.Front());
+				mHasBlockedCommands = true;
 				break;
 			}
-		}
 
-		// If we've found a bucket with commands that can run, exit the outer loop.
-		if (non_empty_bucket_index != -1)
-			break;
-	}
-	
-	if (non_empty_bucket_index != -1)
-	{
-		PrioBucket&      bucket = mPrioBuckets[non_empty_bucket_index];
-		PrioData&        data   = mPrioData[non_empty_bucket_index];
+			// Pop the command.
+			// Note: erase to keep the order, the end of the bucket is what gets popped next.
+			CookingCommandID id = bucket.mCommands[command_index];
+			bucket.mCommands.Erase(command_index);
+			mTotalSize--;
+
+			// Remember there's now one command ongoing.
+			data.mCommandsBeingCooked++;
+
+			// Take its resources.
+			// Note: a batch is a single process, the other commands of the batch don't take more.
+			const CookingRule& rule = gCookingSystem.GetCommand(id).GetRule();
+			StartRunning(ioLock, rule);
+
+			// If the rule uses batching, also take the other commands of the same rule that are ready.
+			// Note: all commands of a rule have the same priority, so they're all in this bucket.
+			if (rule.UseBatching())
+			{
+				// Only look at the end of the bucket, no need to go through the entire backlog to fill a batch.
+				constexpr int cMaxBatchSearch = 4096;
+				int           search_end      = gMax(0, bucket.mCommands.Size() - cMaxBatchSearch);
+
+				for (int i = bucket.mCommands.Size() - 1; i >= search_end && outBatch.Size() < rule.mBatchSize - 1; --i)
+				{
+					CookingCommandID other_id = bucket.mCommands[i];
+					if (gCookingSystem.GetCommand(other_id).mRuleID != rule.mID)
+						continue;
 
-		// Pop a command.
-		CookingCommandID id     = bucket.mCommands.Back();
-		bucket.mCommands.PopBack();
-		mTotalSize--;
+					// Keep the order, the end of the bucket is what gets popped next.
+					bucket.mCommands.Erase(i);
+					mTotalSize--;
+					data.mCommandsBeingCooked++;
 
-		// Remember there's now one command ongoing.
-		data.mCommandsBeingCooked++;
+					outBatch.PushBack(other_id);
+				}
+			}
 
-		return id;
+			return id;
+		}
 	}
 
 	return CookingCommandID::cInvalid();
 }
 
 
+bool CookingThreadsQueue::Remove(CookingCommandID inCommandID, RemoveOption inOption/* = RemoveOption::None*/)
+{
+	const CookingCommand& command = gCookingSystem.GetCommand(inCommandID);
+	int priority = gCookingSystem.GetRule(command.mRuleID).mPriority;
+
+	LockGuard lock(mMutex);
+
+	// The command can be in either lane.
+	bool removed = RemoveInternal(lock, mInteractivePrioBuckets, priority, inCommandID, inOption)
+				|| RemoveInternal(lock, mPrioBuckets, priority, inCommandID, inOption);
+	gAssert(removed || (inOption & RemoveOption::ExpectFound) == false);
+
+	return removed;
+}
+
+
+void CookingThreadsQueue::Clear()
+{
+	LockGuard lock(mMutex);
+
+	for (PrioBucket& bucket : mPrioBuckets)
+		bucket.mCommands.Clear();
+	for (PrioBucket& bucket : mInteractivePrioBuckets)
+		bucket.mCommands.Clear();
+
+	mTotalSize = 0;
+}
+
+
+bool CookingThreadsQueue::MoveToInteractiveLane(CookingCommandID inCommandID)
+{
+	const CookingCommand& command = gCookingSystem.GetCommand(inCommandID);
+	int priority = gCookingSystem.GetRule(command.mRuleID).mPriority;
+
+	{
+		LockGuard lock(mMutex);
+
+		if (!RemoveInternal(lock, mPrioBuckets, priority, inCommandID, RemoveOption::None))
+			return false;
+
+		// Put it at the back, it's the next one to be popped from this bucket.
+		PushInternal(lock, mInteractivePrioBuckets, priority, inCommandID, PushPosition::Back);
+		gEmplaceSorted(mInteractivePrioData, priority);
+	}
+
+	NotifyPush(CookingLane::Interactive);
+	return true;
+}
+
+
 void CookingThreadsQueue::FinishedCooking(const CookingLogEntry& inLogEntry)
 {
 #ifdef ASSERTS_ENABLED
 	{
 		// At this poing the command should have finished cooking and be in either Success/Error.
 		CookingState cooking_state = inLogEntry.mCookingState.Load();
-		gAssert(cooking_state == CookingState::Success || cooking_state == CookingState::Error);
+		gAssert(cooking_state == CookingState::Success || cooking_state == CookingState::Error || cooking_state == CookingState::Canceled);
 	}
 #endif
 
@@ -571,17 +645,18 @@ void CookingThreadsQueue::FinishedCooking(const CookingLogEntry& inLogEntry)
 	{
 		LockGuard lock(mMutex);
 
-		// Find the bucket.
-		auto bucket_it = gFindSorted(mPrioBuckets, priority);
-		if (bucket_it == mPrioBuckets.end())
+		Vector<PrioData>& prio_data = (inLogEntry.mLane == CookingLane::Interactive) ? mInteractivePrioData : mPrioData;
+
+		// Find the data for that priority.
+		auto data_it = gFindSorted(prio_data, priority);
+		if (data_it == prio_data.end())
 		{
 			gAssert(false);
 			return;
 		}
 
 		// Update the number of commands still cooking.
-		int index = mPrioBuckets.GetIndex(*bucket_it);
-		PrioData& data  = mPrioData[index];
+		PrioData& data = *data_it;
 		data.mCommandsBeingCooked--;
 
 		// If this was the last command being cooked for this prio, notify any waiting thread.
@@ -591,95 +666,345 @@ void CookingThreadsQueue::FinishedCooking(const CookingLogEntry& inLogEntry)
 
 	// Notify outside of the lock, no reason to wake threads to immediately make them wait for the lock.
 	if (notify)
+	{
 		mBarrier.NotifyAll();
+		mInteractiveBarrier.NotifyAll();
+	}
 }
 
 
-void CookingThreadsQueue::RequestStop()
+bool CookingThreadsQueue::CanStartRunning(MutexLockGuard& ioLock, CookingLane inLane, const CookingRule& inRule)
 {
-	{
-		LockGuard lock(mMutex);
-		mStopRequested = true;
-	}
-	mBarrier.NotifyAll();
+	gAssert(ioLock.GetMutex() == &mMutex);
+
+	if (inRule.mMaxConcurrent > 0 && inRule.mID.mIndex < mRunningCountPerRule.Size() && mRunningCountPerRule[inRule.mID.mIndex] >= inRule.mMaxConcurrent)
+		return false;
+
+	// If nothing is running, anything can start (even commands using more memory than the budget, otherwise they would never run).
+	if (mThreadTokensUsed == 0)
+		return true;
+
+	// The background lane leaves some threads for the interactive lane (but can always use at least one).
+	int thread_tokens = mThreadTokens;
+	if (inLane == CookingLane::Background)
+		thread_tokens = gMax(1, thread_tokens - mReservedInteractiveTokens);
+
+	if (mThreadTokensUsed + GetThreadWeight(inRule) > thread_tokens)
+		return false;
+
+	if (mMemoryBudgetMiB > 0 && mMemoryUsedMiB + inRule.GetMemoryWeightMiB() > mMemoryBudgetMiB)
+		return false;
+
+	return true;
 }
 
 
-void CookingSystem::CreateCommandsForFile(FileInfo& ioFile)
+void CookingThreadsQueue::StartRunning(MutexLockGuard& ioLock, const CookingRule& inRule)
 {
-	// Directories can't have commands.
-	if (ioFile.IsDirectory())
-		return;
+	gAssert(ioLock.GetMutex() == &mMutex);
 
-	// Already done?
-	if (ioFile.mCommandsCreated)
-		return;
+	if (inRule.mID.mIndex >= mRunningCountPerRule.Size())
+		mRunningCountPerRule.Resize(inRule.mID.mIndex + 1); // Zero initialized.
+
+	mRunningCountPerRule[inRule.mID.mIndex]++;
+	mThreadTokensUsed += GetThreadWeight(inRule);
+	mMemoryUsedMiB    += inRule.GetMemoryWeightMiB();
+}
 
-	ioFile.mCommandsCreated = true;
 
-	for (const CookingRule& rule : mRules)
+void CookingThreadsQueue::FinishedRunning(const CookingRule& inRule)
+{
+	bool notify;
 	{
-		bool pass = false;
-		for (auto& filter : rule.mInputFilters)
-		{
-			if (filter.Pass(ioFile))
-			{
-				pass = true;
-				break;
-			}
-		}
+		LockGuard lock(mMutex);
 
-		if (!pass)
-			continue;
+		mRunningCountPerRule[inRule.mID.mIndex]--;
+		mThreadTokensUsed -= GetThreadWeight(inRule);
+		mMemoryUsedMiB    -= inRule.GetMemoryWeightMiB();
+		gAssert(mRunningCountPerRule[inRule.mID.mIndex] >= 0 && mThreadTokensUsed >= 0 && mMemoryUsedMiB >= 0);
 
-		CookingCommandID command_id;
+		// Only wake up the threads if some commands were waiting for resources.
+		notify              = mHasBlockedCommands;
+		mHasBlockedCommands = false;
+	}
 
-		// Create the command.
-		{
-			bool   success = true;
-			FileID dep_file;
+	if (notify)
+	{
+		mBarrier.NotifyAll();
+		mInteractiveBarrier.NotifyAll();
+	}
+}
 
-			// Get the dep file (if needed).
-			if (rule.UseDepFile())
-			{
-				dep_file = gGetOrAddFileFromFormat(rule.mDepFilePath, ioFile);
-				if (dep_file.IsValid())
-					dep_file.GetFile().mIsDepFile = true;
-				else
-					success = false;
-			}
 
-			// Add the main input file.
-			// Note: order is important, the main input file is always the first input.
-			Vector<FileID> inputs;
-			inputs.PushBack(ioFile.mID);
+void CookingThreadsQueue::SetResourceBudget(int inMaxThreadTokens, int inReservedInteractiveTokens, int64 inMemoryBudgetMiB)
+{
+	LockGuard lock(mMutex);
+	gAssert(mThreadTokensUsed == 0);
 
-			// Get the additional input files.
-			for (StringView path : rule.mInputPaths)
-			{
-				FileID file = gGetOrAddFileFromFormat(path, ioFile);
-				if (!file.IsValid())
-				{
-					success = false;
-					continue;
-				}
+	mMaxThreadTokens           = inMaxThreadTokens;
+	mReservedInteractiveTokens = inReservedInteractiveTokens;
+	mMemoryBudgetMiB           = inMemoryBudgetMiB;
+}
 
-				gPushBackUnique(inputs, file);
-			}
 
-			// If there is an output dep file, add it to the outputs.
-			// Note: order is important, the dep file is always the first output.
-			Vector<FileID> outputs;
-			if (dep_file.IsValid())
-				outputs.PushBack(dep_file);
+void CookingThreadsQueue::SetThreadTokens(int inThreadTokens)
+{
+	bool grown;
+	{
+		LockGuard lock(mMutex);
 
-			// Add the ouput files.
-			for (StringView path : rule.mOutputPaths)
-			{
-				FileID file = gGetOrAddFileFromFormat(path, ioFile);
-				if (!file.IsValid())
-				{
-					success = false;
+		inThreadTokens = gClamp(inThreadTokens, 1, mMaxThreadTokens);
+		grown          = inThreadTokens > mThreadTokens;
+		mThreadTokens  = inThreadTokens;
+	}
+
+	// If there are more tokens, commands that were waiting for them can start.
+	// If there are fewer, the commands already running finish normally and the next ones wait.
+	if (grown)
+	{
+		mBarrier.NotifyAll();
+		mInteractiveBarrier.NotifyAll();
+	}
+}
+
+
+int CookingThreadsQueue::GetThreadTokens() const
+{
+	LockGuard lock(mMutex);
+	return mThreadTokens;
+}
+
+
+int CookingThreadsQueue::GetThreadTokensUsed() const
+{
+	LockGuard lock(mMutex);
+	return mThreadTokensUsed;
+}
+
+
+void CookingThreadsQueue::RequestStop()
+{
+	{
+		LockGuard lock(mMutex);
+		mStopRequested = true;
+	}
+	mBarrier.NotifyAll();
+	mInteractiveBarrier.NotifyAll();
+}
+
+
+// Commands found for some files, before they're actually added.
+// Finding the commands (matching rules, formatting paths) can be done in parallel, but adding them can't,
+// and it needs to be done in a deterministic order to keep the CookingCommandIDs stable.
+struct CommandStaging
+{
+	struct Path
+	{
+		FileRepo* mRepo   = nullptr; // Null if formatting the path failed.
+		int       mOffset = 0;       // Position in mChars.
+		int       mSize   = 0;
+		PathHash  mPathHash;         // Hash of the full path, computed during staging so that adding the file only needs the lookup.
+	};
+
+	struct Command
+	{
+		FileID        mMainInput;
+		CookingRuleID mRuleID;
+		int           mFirstPath       = 0; // Position in mPaths. The dep file path (if the rule uses one) is first, then the inputs, then the outputs.
+		int           mInputPathCount  = 0;
+		int           mOutputPathCount = 0;
+		uint64        mFingerprint     = 0; // See sComputeCommandFingerprint.
+	};
+
+	Vector<Command> mCommands;
+	Vector<Path>    mPaths;
+	String          mChars;
+
+	void AddPath(const CommandTemplate& inTemplate, const FileInfo& inFile)
+	{
+		Path&      path = mPaths.EmplaceBack();
+		TempString formatted_path;
+		if (!inTemplate.FormatFilePath(inFile, path.mRepo, formatted_path))
+		{
+			path.mRepo = nullptr;
+			return;
+		}
+
+		gNormalizePath(formatted_path);
+
+		path.mOffset   = mChars.Size();
+		path.mSize     = formatted_path.Size();
+		path.mPathHash = gHashPath(gConcat(path.mRepo->mRootPath, formatted_path));
+		mChars.Append(formatted_path);
+	}
+
+	// Return an invalid FileID if formatting the path failed.
+	FileID GetOrAddFile(const Path& inPath) const
+	{
+		if (inPath.mRepo == nullptr)
+			return FileID::cInvalid();
+
+		return inPath.mRepo->GetOrAddFile(StringView(mChars).SubStr(inPath.mOffset, inPath.mSize), inPath.mPathHash, FileType::File, {}).mID;
+	}
+};
+
+
+// Hash everything that defines what a command does: its command lines and paths as they are once formatted for its main input.
+// When a rule is edited, only the commands whose fingerprint changed need to cook again.
+static uint64 sComputeCommandFingerprint(const CookingRule& inRule, const FileInfo& inMainInput, const CommandStaging& inStaging, const CommandStaging::Command& inCommand)
+{
+	TempString fingerprint_str;
+
+	// Prefix each part with its size, so that different parts can't end up making the same string.
+	auto append_part = [&](StringView inPart) { gAppendFormat(fingerprint_str, "%d:", inPart.Size()); fingerprint_str.Append(inPart); };
+
+	auto append_command_line = [&](const CommandTemplate& inTemplate)
+	{
+		TempString command_line;
+		inTemplate.FormatCommandString(inMainInput, command_line);
+		append_part(command_line);
+	};
+
+	gAppendFormat(fingerprint_str, "%d,%d,%d,%d,", (int)inRule.mCommandType, (int)inRule.UseDepFile(), (int)inRule.mDepFileFormat, (int)inRule.mDepFileScanner);
+
+	if (inRule.mCommandType == CommandType::CommandLine || inRule.mCommandType == CommandType::Worker)
+		append_command_line(inRule.mCommandLineTemplate);
+
+	if (inRule.mCommandType == CommandType::Worker)
+		append_command_line(inRule.mWorkerCommandLineTemplate);
+
+	if (inRule.UseBatching())
+		append_command_line(inRule.mBatchCommandLineTemplate);
+
+	if (!inRule.mDepFileCommandLine.Empty())
+		append_command_line(inRule.mDepFileCommandLineTemplate);
+
+	for (const CommandTemplate& include_path_template : inRule.mDepFileIncludePathTemplates)
+		append_command_line(include_path_template);
+
+	// The dep file path, the inputs and the outputs.
+	int path_count = (inRule.UseDepFile() ? 1 : 0) + inCommand.mInputPathCount + inCommand.mOutputPathCount;
+	for (int i = inCommand.mFirstPath; i < inCommand.mFirstPath + path_count; ++i)
+	{
+		const CommandStaging::Path& path = inStaging.mPaths[i];
+		append_part(path.mRepo ? path.mRepo->mRootPath : StringView());
+		append_part(StringView(inStaging.mChars).SubStr(path.mOffset, path.mSize));
+	}
+
+	return gHash(StringView(fingerprint_str));
+}
+
+
+void CookingSystem::StageCommandsForFile(const FileInfo& inFile, CommandStaging& ioStaging) const
+{
+	// Directories can't have commands.
+	if (inFile.IsDirectory())
+		return;
+
+	// Already done?
+	if (inFile.mCommandsCreated)
+		return;
+
+	// Only test the filters that can pass, instead of every filter of every rule.
+	TempVector<RuleFilterRef> candidates;
+	mRuleMatchIndex.GetCandidates(inFile, candidates);
+
+	for (int candidate_index = 0; candidate_index < candidates.Size();)
+	{
+		const CookingRule& rule = mRules[candidates[candidate_index].mRuleIndex];
+
+		// Candidates are sorted by rule, test all the ones of this rule.
+		bool pass = false;
+		for (; candidate_index < candidates.Size() && candidates[candidate_index].mRuleIndex == rule.mID.mIndex; ++candidate_index)
+		{
+			if (!pass && rule.mInputFilters[candidates[candidate_index].mFilterIndex].Pass(inFile))
+				pass = true;
+		}
+
+		if (!pass)
+			continue;
+
+		CommandStaging::Command& command = ioStaging.mCommands.EmplaceBack();
+		command.mMainInput               = inFile.mID;
+		command.mRuleID                  = rule.mID;
+		command.mFirstPath               = ioStaging.mPaths.Size();
+		command.mInputPathCount          = rule.mInputPaths.Size();
+		command.mOutputPathCount         = rule.mOutputPaths.Size();
+
+		if (rule.UseDepFile())
+			ioStaging.AddPath(rule.mDepFilePathTemplate, inFile);
+
+		for (const CommandTemplate& path : rule.mInputPathTemplates)
+			ioStaging.AddPath(path, inFile);
+
+		for (const CommandTemplate& path : rule.mOutputPathTemplates)
+			ioStaging.AddPath(path, inFile);
+
+		command.mFingerprint = sComputeCommandFingerprint(rule, inFile, ioStaging, command);
+
+		// Check if we need to continue to try more rules for this file.
+		if (!rule.mMatchMoreRules)
+			break;
+	}
+}
+
+
+void CookingSystem::AddStagedCommands(const CommandStaging& inStaging)
+{
+	for (const CommandStaging::Command& staged_command : inStaging.mCommands)
+	{
+		const CookingRule& rule       = GetRule(staged_command.mRuleID);
+		const FileInfo&    main_input = staged_command.mMainInput.GetFile();
+		int                path_index = staged_command.mFirstPath;
+
+		CookingCommandID command_id;
+
+		// Create the command.
+		{
+			bool   success = true;
+			FileID dep_file;
+
+			// Get the dep file (if needed).
+			if (rule.UseDepFile())
+			{
+				dep_file = inStaging.GetOrAddFile(inStaging.mPaths[path_index++]);
+				if (dep_file.IsValid())
+					dep_file.GetFile().mIsDepFile = true;
+				else
+					success = false;
+			}
+
+			// Add the main input file.
+			// Note: order is important, the main input file is always the first input.
+			Vector<FileID> inputs;
+			inputs.PushBack(main_input.mID);
+
+			// Get the additional input files.
+			for (int i = 0; i < staged_command.mInputPathCount; ++i)
+			{
+				FileID file = inStaging.GetOrAddFile(inStaging.mPaths[path_index++]);
+				if (!file.IsValid())
+				{
+					success = false;
+					continue;
+				}
+
+				gPushBackUnique(inputs, file);
+			}
+
+			// If there is an output dep file, add it to the outputs.
+			// Note: order is important, the dep file is always the first output.
+			Vector<FileID> outputs;
+			if (dep_file.IsValid())
+				outputs.PushBack(dep_file);
+
+			// Add the ouput files.
+			for (int i = 0; i < staged_command.mOutputPathCount; ++i)
+			{
+				FileID file = inStaging.GetOrAddFile(inStaging.mPaths[path_index++]);
+				if (!file.IsValid())
+				{
+					success = false;
 					continue;
 				}
 
@@ -690,7 +1015,7 @@ void CookingSystem::CreateCommandsForFile(FileInfo& ioFile)
 			// but if something goes wrong anyway, log an error and ignore this rule.
 			if (!success)
 			{
-				gAppLogError("Failed to create Rule %s command for %s", rule.mName.AsCStr(), ioFile.ToString().AsCStr());
+				gAppLogError("Failed to create Rule %s command for %s", rule.mName.AsCStr(), main_input.ToString().AsCStr());
 				continue;
 			}
 
@@ -707,6 +1032,7 @@ void CookingSystem::CreateCommandsForFile(FileInfo& ioFile)
 				command.mRuleID         = rule.mID;
 				command.mInputs         = gMove(inputs);
 				command.mOutputs        = gMove(outputs);
+				command.mFingerprint    = staged_command.mFingerprint;
 			}
 
 			// Update stats.
@@ -718,20 +1044,102 @@ void CookingSystem::CreateCommandsForFile(FileInfo& ioFile)
 			const CookingCommand& command = GetCommand(command_id);
 
 			for (FileID file_id : command.mInputs)
-				gFileSystem.GetFile(file_id).mInputOf.PushBack(command.mID);
+				gFileSystem.GetFile(file_id).mInputOf.Add(command.mID);
 
 			for (FileID file_id : command.mOutputs)
-				gFileSystem.GetFile(file_id).mOutputOf.PushBack(command.mID);
+				gFileSystem.GetFile(file_id).mOutputOf.Add(command.mID);
 		}
 
 		// TODO: add validation
 		// - a file cannot be the input/output of the same command
 		// - all the inputs of a command can only be outputs of commands with lower prio (ie. that build before)
+	}
+}
 
-		// Check if we need to continue to try more rules for this file.
-		if (!rule.mMatchMoreRules)
+
+void CookingSystem::CreateCommandsForFile(FileInfo& ioFile)
+{
+	CommandStaging staging;
+	StageCommandsForFile(ioFile, staging);
+
+	// Note: set it only after staging, since staging skips the files that are already done.
+	if (!ioFile.IsDirectory())
+		ioFile.mCommandsCreated = true;
+
+	AddStagedCommands(staging);
+}
+
+
+void CookingSystem::CreateCommandsForAllFiles()
+{
+	gAppLog("Creating commands.");
+	Timer timer;
+
+	// Number of files already processed in each repo.
+	Vector<int> processed_file_counts;
+	processed_file_counts.Resize(gFileSystem.GetRepoCount(), 0);
+
+	// Adding commands also adds their (not yet existing) outputs, which can be inputs of other rules.
+	// Keep going until no new files are added.
+	while (true)
+	{
+		Vector<FileID> files;
+		for (const FileRepo& repo : gFileSystem.GetRepos())
+		{
+			int& processed_file_count = processed_file_counts[repo.mIndex];
+			for (int i = processed_file_count; i < repo.mFiles.Size(); ++i)
+				files.PushBack(repo.mFiles[i].mID);
+
+			processed_file_count = repo.mFiles.Size();
+		}
+
+		if (files.Empty())
 			break;
-	}	
+
+		// Stage the commands in parallel, in chunks of files so that they can be added in the same order whatever the number of threads.
+		constexpr int cFilesPerChunk   = 4096;
+		constexpr int cMaxThreadCount  = 16;
+		const int     chunk_count      = (files.Size() + cFilesPerChunk - 1) / cFilesPerChunk;
+		const int     thread_count     = gMin(gMin(gThreadHardwareConcurrency(), cMaxThreadCount), chunk_count);
+
+		Vector<CommandStaging> chunks;
+		chunks.Resize(chunk_count);
+
+		Thread      threads[cMaxThreadCount];
+		AtomicInt32 current_chunk = 0;
+		for (auto& thread : Span(threads, thread_count))
+		{
+			thread.Create({ .mName = "Command Creation Thread", .mTempMemSize = 256_KiB }, [&](Thread&)
+			{
+				int chunk_index;
+				while ((chunk_index = current_chunk.Add(1)) < chunk_count)
+				{
+					int begin = chunk_index * cFilesPerChunk;
+					int end   = gMin(begin + cFilesPerChunk, files.Size());
+
+					for (int i = begin; i < end; ++i)
+						StageCommandsForFile(files[i].GetFile(), chunks[chunk_index]);
+				}
+			});
+		}
+
+		// Wait for the threads to finish their work.
+		for (auto& thread : threads)
+			thread.Join();
+
+		for (FileID file_id : files)
+		{
+			FileInfo& file = file_id.GetFile();
+			if (!file.IsDirectory())
+				file.mCommandsCreated = true;
+		}
+
+		// Add the commands in order.
+		for (const CommandStaging& chunk : chunks)
+			AddStagedCommands(chunk);
+	}
+
+	gAppLog("Done. %d commands created in %.2f seconds.", mCommands.Size(), gTicksToSeconds(timer.GetTicks()));
 }
 
 
@@ -775,7 +1183,8 @@ bool CookingSystem::ValidateRules()
 		errors++;
 	}
 
-	for (const CookingRule& rule : rules)
+	// Not const, the command templates are compiled while validating.
+	for (CookingRule& rule : mRules)
 	{
 		// Validate the name.
 		if (!rule.mName.Empty())
@@ -813,28 +1222,76 @@ bool CookingSystem::ValidateRules()
 			}
 		}
 
-		// Dummy file info and string use to test path formatting.
-		FileInfo   dummy_file(FileID{ 0, 0 }, "dir\\dummy.txt", Hash128{ 0, 0 }, FileType::File, {});
-		TempString dummy_result;
-
 		// Validate the command line.
-		if (rule.mCommandType == CommandType::CommandLine && !gFormatCommandString(rule.mCommandLine, dummy_file, dummy_result))
+		if ((rule.mCommandType == CommandType::CommandLine || rule.mCommandType == CommandType::Worker) && !rule.mCommandLineTemplate.CompileCommandString(rule.mCommandLine))
 		{
 			errors++;
 			gAppLogError(R"(Rule %s: Failed to parse CommandLine "%s")", rule.mName.AsCStr(), rule.mCommandLine.AsCStr());
 		}
 
+		// Validate the resource settings.
+		if (rule.mMaxConcurrent < 0)
+		{
+			errors++;
+			gAppLogError(R"(Rule %s: MaxConcurrent cannot be negative.)", rule.mName.AsCStr());
+		}
+
+		if (rule.mThreadWeight < 1)
+		{
+			errors++;
+			gAppLogError(R"(Rule %s: ThreadWeight must be at least 1.)", rule.mName.AsCStr());
+		}
+
+		if (rule.mMemoryWeight < 0.f)
+		{
+			errors++;
+			gAppLogError(R"(Rule %s: MemoryWeight cannot be negative.)", rule.mName.AsCStr());
+		}
+
+		// Validate the batch command line.
+		if (rule.UseBatching() && !rule.mBatchCommandLineTemplate.CompileCommandString(rule.mBatchCommandLine))
+		{
+			errors++;
+			gAppLogError(R"(Rule %s: Failed to parse BatchCommandLine "%s")", rule.mName.AsCStr(), rule.mBatchCommandLine.AsCStr());
+		}
+
+		// Validate the worker command line.
+		if (rule.mCommandType == CommandType::Worker && !rule.mWorkerCommandLineTemplate.CompileCommandString(rule.mWorkerCommandLine))
+		{
+			errors++;
+			gAppLogError(R"(Rule %s: Failed to parse WorkerCommandLine "%s")", rule.mName.AsCStr(), rule.mWorkerCommandLine.AsCStr());
+		}
+
 		// Validate the dep file path.
-		if (rule.UseDepFile() && !gFormatCommandString(rule.mDepFilePath, dummy_file, dummy_result))
+		if (rule.UseDepFile() && !rule.mDepFilePathTemplate.CompileFilePath(rule.mDepFilePath))
 		{
 			errors++;
 			gAppLogError(R"(Rule %s: Failed to parse DepFilePath "%s")", rule.mName.AsCStr(), rule.mDepFilePath.AsCStr());
 		}
 
+		// Validate the dep file command line.
+		if (!rule.mDepFileCommandLine.Empty() && !rule.mDepFileCommandLineTemplate.CompileCommandString(rule.mDepFileCommandLine))
+		{
+			errors++;
+			gAppLogError(R"(Rule %s: Failed to parse DepFileCommandLine "%s")", rule.mName.AsCStr(), rule.mDepFileCommandLine.AsCStr());
+		}
+
+		// Validate the dep file scanner include paths.
+		rule.mDepFileIncludePathTemplates.Resize(rule.mDepFileIncludePaths.Size());
+		for (int i = 0; i < rule.mDepFileIncludePaths.Size(); ++i)
+		{
+			if (!rule.mDepFileIncludePathTemplates[i].CompileCommandString(rule.mDepFileIncludePaths[i]))
+			{
+				errors++;
+				gAppLogError(R"(Rule %s: Failed to parse DepFile IncludePath "%s")", rule.mName.AsCStr(), rule.mDepFileIncludePaths[i].AsCStr());
+			}
+		}
+
 		// Validate the input paths.
+		rule.mInputPathTemplates.Resize(rule.mInputPaths.Size());
 		for (int i = 0; i < rule.mInputPaths.Size(); ++i)
 		{
-			if (!gFormatCommandString(rule.mInputPaths[i], dummy_file, dummy_result))
+			if (!rule.mInputPathTemplates[i].CompileFilePath(rule.mInputPaths[i]))
 			{
 				errors++;
 				gAppLogError(R"(Rule %s: Failed to parse InputPaths[%d] "%s")", rule.mName.AsCStr(), i, rule.mInputPaths[i].AsCStr());
@@ -842,9 +1299,10 @@ bool CookingSystem::ValidateRules()
 		}
 
 		// Validate the output paths.
+		rule.mOutputPathTemplates.Resize(rule.mOutputPaths.Size());
 		for (int i = 0; i < rule.mOutputPaths.Size(); ++i)
 		{
-			if (!gFormatCommandString(rule.mOutputPaths[i], dummy_file, dummy_result))
+			if (!rule.mOutputPathTemplates[i].CompileFilePath(rule.mOutputPaths[i]))
 			{
 				errors++;
 				gAppLogError(R"(Rule %s: Failed to parse OutputPaths[%d] "%s")", rule.mName.AsCStr(), i, rule.mOutputPaths[i].AsCStr());
@@ -852,7 +1310,7 @@ bool CookingSystem::ValidateRules()
 		}
 
 		// Validate that there is at least one output.
-		if (rule.mOutputPaths.Empty() && (!rule.UseDepFile() || rule.mDepFileFormat == DepFileFormat::Make)) // Make format DepFiles can only add inputs, not outputs.
+		if (rule.mOutputPaths.Empty() && (!rule.UseDepFile() || rule.mDepFileFormat == DepFileFormat::Make || rule.mDepFileScanner != DepFileScanner::None)) // Make format and scanned DepFiles can only add inputs, not outputs.
 		{
 			errors++;
 			gAppLogError(R"(Rule %s: a rule must have at least one output, or a DepFile that can register outputs.)", rule.mName.AsCStr());
@@ -880,14 +1338,24 @@ static OwnedHandle sCreateJobObject()
 }
 
 
-void CookingSystem::StartCooking()
+// Create a job object for the processes of a single command, so that they can be killed if cooking is canceled.
+static OwnedHandle sCreateCookJobObject()
 {
-	// Zero/negative means no limit on thread count.
-	int thread_count = (mWantedCookingThreadCount <= 0) ? INT_MAX : mWantedCookingThreadCount;
+	// Note: No need for JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE here, the processes are also in the main job object (this one is nested inside it).
+	OwnedHandle job_object = CreateJobObjectA(nullptr, nullptr);
+	if (job_object == nullptr)
+		gAppFatalError("CreateJobObjectA failed - %s", GetLastErrorString().AsCStr());
+
+	return job_object;
+}
+
 
+void CookingSystem::StartCooking()
+{
+	// Create as many threads as can be useful, the number of active threads can then change while cooking (see SetCookingThreadCount and UpdateAdaptiveCookingThreads).
 	// Number of threads is at least one, and is capped by number of CPU cores minus one,
 	// because we want to leave one core for the file system monitoring thread (and main thread).
-	thread_count = gClamp(thread_count, 1, gThreadHardwareConcurrency() - 1);
+	int thread_count = gMax(1, gThreadHardwareConcurrency() - 1);
 
 	// Also make sure we don't go above the max size of the thread array.
 	thread_count = gMin(thread_count, mCookingThreads.MaxSize());
@@ -895,7 +1363,29 @@ void CookingSystem::StartCooking()
 	// Create the job object that will make sure child processes are killed if this process is killed.
 	mJobObject = sCreateJobObject();
 
-	gAppLog("Starting %d Cooking Threads.", thread_count);
+	// Reserve some threads for the interactive lane, so that commands dirtied by someone editing files cook quickly even during a big background cook.
+	// Always leave at least one thread for the background lane.
+	int interactive_thread_count = gClamp(mWantedInteractiveCookingThreadCount, 0, thread_count - 1);
+
+	// Zero/negative means no limit on thread count.
+	int active_thread_count = (mWantedCookingThreadCount <= 0) ? thread_count : gClamp(mWantedCookingThreadCount, 1, thread_count);
+
+	gAppLog("Starting %d Cooking Threads (%d active, %d reserved for interactive commands).", thread_count, active_thread_count, interactive_thread_count);
+
+	// Commands only start if there are enough threads and memory left for them (see CookingRule::mThreadWeight and mMemoryWeight).
+	{
+		int64 memory_budget_mib = (int64)(mWantedCookingMemoryBudget * 1024.f);
+		if (memory_budget_mib <= 0)
+		{
+			uint64 installed_memory_kib = 0;
+			if (GetPhysicallyInstalledSystemMemory(&installed_memory_kib))
+				memory_budget_mib = (int64)(installed_memory_kib / 1024);
+		}
+
+		mCommandsToCook.SetResourceBudget(thread_count, interactive_thread_count, memory_budget_mib);
+		mCommandsToCook.SetThreadTokens(active_thread_count);
+		mLastAdaptiveSample = {};
+	}
 
 	mCookingThreads.Reserve(thread_count);
 
@@ -903,17 +1393,13 @@ void CookingSystem::StartCooking()
 	for (int i = 0; i < thread_count; ++i)
 	{
 		auto& thread = mCookingThreads.EmplaceBack();
+		thread.mInteractiveOnly = (i < interactive_thread_count);
 		thread.mThread.Create({ 
 			.mName = "CookingThread",
 			.mTempMemSize = 128_KiB,
 		}, [this, &thread](Thread&) { CookingThreadFunction(thread); });
 	}
 
-	// Start the thread updating the time outs.
-	mTimeOutUpdateThread.Create({ 
-			.mName = "TimeOut Update Thread",
-		}, [this](Thread&) { TimeOutUpdateThread(); });
-
 	// Initialize cooking paused bool.
 	mCookingPaused = mCookingStartPaused;
 
@@ -923,46 +1409,113 @@ void CookingSystem::StartCooking()
 }
 
 
-void CookingSystem::StopCooking()
+void CookingSystem::SetCookingThreadCount(int inThreadCount)
 {
-	for (auto& thread : mCookingThreads)
-		thread.mThread.RequestStop();
+	mWantedCookingThreadCount = inThreadCount;
 
-	mCommandsToCook.RequestStop();
+	// If cooking is already started, change the number of active threads right away.
+	// Zero/negative means no limit on thread count.
+	if (!mCookingThreads.Empty())
+		mCommandsToCook.SetThreadTokens(inThreadCount <= 0 ? INT_MAX : inThreadCount);
+}
 
-	for (auto& thread : mCookingThreads)
-		thread.mThread.Join();
-	mCookingThreads.Clear();
 
-	mJobObject = {};
+void CookingSystem::UpdateAdaptiveCookingThreads()
+{
+	if (!mAdaptiveCookingThreads || IsCookingPaused())
+		return;
 
-	mTimeOutUpdateThread.RequestStop();
-	mTimeOutAddedSignal.NotifyOne();
-	mTimeOutTimerSignal.Release();
-	mTimeOutUpdateThread.Join();
-}
+	// Don't adjust too often, each change needs some time to have a visible effect.
+	int64 current_ticks = gGetTickCount();
+	if (current_ticks - mLastAdaptiveSample.mTicks < gSecondsToTicks(1.0))
+		return;
 
+	AdaptiveSample sample;
+	sample.mTicks = current_ticks;
 
-void CookingSystem::SetCookingPaused(bool inPaused)
-{
-	// If cooking isn't started yet, only change the start paused bool.
-	// Setting mCookingPaused to true before starting the cooking would cause dirty commands to be queued twice.
-	if (!mTimeOutUpdateThread.IsJoinable())
-	{
-		mCookingStartPaused = inPaused;
+	_FILETIME idle_time, kernel_time, user_time;
+	if (!GetSystemTimes(&idle_time, &kernel_time, &user_time))
 		return;
-	}
 
-	if (inPaused == mCookingPaused)
+	sample.mSystemIdleTime = FileTime(idle_time).mDateTime;
+	sample.mSystemTime     = FileTime(kernel_time).mDateTime + FileTime(user_time).mDateTime; // Kernel time includes idle time.
+
+	// All the processes started by the cooking threads are in the main job object.
+	JOBOBJECT_BASIC_ACCOUNTING_INFORMATION job_info = {};
+	if (!QueryInformationJobObject(mJobObject, JobObjectBasicAccountingInformation, &job_info, sizeof(job_info), nullptr))
 		return;
 
-	if (inPaused)
-	{
-		mCookingPaused = true;
+	sample.mCookCPUTime = job_info.TotalUserTime.QuadPart + job_info.TotalKernelTime.QuadPart;
 
-		// Empty the cooking queue.
-		mCommandsToCook.Clear();
+	AdaptiveSample previous = mLastAdaptiveSample;
+	mLastAdaptiveSample     = sample;
 
+	// Need two samples to compare.
+	if (previous.mTicks == 0 || sample.mSystemTime <= previous.mSystemTime)
+		return;
+
+	double elapsed_time = gTicksToSeconds(sample.mTicks - previous.mTicks) * 10'000'000.0; // In 100ns units, like the other times.
+	double cpu_usage    = 1.0 - (double)(sample.mSystemIdleTime - previous.mSystemIdleTime) / (double)(sample.mSystemTime - previous.mSystemTime);
+	int    active       = mCommandsToCook.GetThreadTokens();
+	int    running      = mCommandsToCook.GetThreadTokensUsed();
+	int    queued       = mCommandsToCook.GetSize();
+
+	// CPU time of the commands compared to their wall time. A low ratio means they spend most of their time waiting (usually for I/O).
+	double cook_cpu_ratio = (double)(sample.mCookCPUTime - previous.mCookCPUTime) / (elapsed_time * gMax(running, 1));
+
+	constexpr double cCPUSaturated = 0.95;
+	constexpr double cCPUAvailable = 0.80;
+	constexpr double cIOBound      = 0.50;
+
+	int wanted = active;
+	if (cpu_usage > cCPUSaturated)
+		wanted--; // More commands would only compete for the CPU (with each other, or with the user's other programs).
+	else if (queued > 0 && running >= active && (cpu_usage < cCPUAvailable || cook_cpu_ratio < cIOBound))
+		wanted++; // Commands are waiting for a thread, and there is CPU to spare (or the running commands are mostly waiting for I/O).
+
+	if (wanted != active)
+		mCommandsToCook.SetThreadTokens(wanted);
+}
+
+
+void CookingSystem::StopCooking()
+{
+	for (auto& thread : mCookingThreads)
+		thread.mThread.RequestStop();
+
+	mCommandsToCook.RequestStop();
+
+	for (auto& thread : mCookingThreads)
+		thread.mThread.Join();
+	mCookingThreads.Clear();
+
+	mJobObject = {};
+}
+
+
+void CookingSystem::SetCookingPaused(bool inPaused)
+{
+	// If cooking isn't started yet, only change the start paused bool.
+	// Setting mCookingPaused to true before starting the cooking would cause dirty commands to be queued twice.
+	if (mCookingThreads.Empty())
+	{
+		mCookingStartPaused = inPaused;
+		return;
+	}
+
+	if (inPaused == mCookingPaused)
+		return;
+
+	if (inPaused)
+	{
+		mCookingPaused = true;
+
+		// Empty the cooking queue.
+		mCommandsToCook.Clear();
+
+		// Also forget about the commands waiting for their inputs to settle, they'll be queued again when unpausing.
+		LockGuard lock(mDebouncedCommandsMutex);
+		mDebouncedCommands.Clear();
 	}
 	else
 	{
@@ -976,6 +1529,12 @@ void CookingSystem::SetCookingPaused(bool inPaused)
 
 void CookingSystem::QueueDirtyCommands()
 {
+	// All dirty commands are about to be queued, including the ones waiting for their inputs to settle.
+	{
+		LockGuard lock(mDebouncedCommandsMutex);
+		mDebouncedCommands.Clear();
+	}
+
 	LockGuard lock(mCommandsDirty.mMutex);
 
 	for (auto& bucket : mCommandsDirty.mPrioBuckets)
@@ -988,8 +1547,8 @@ void CookingSystem::QueueDirtyCommands()
 			if (cooking_state == CookingState::Cooking || cooking_state == CookingState::Waiting)
 				continue; // Skip commands already cooking.
 
-			if (cooking_state == CookingState::Error && (command.mDirtyState & (CookingCommand::InputChanged | CookingCommand::VersionMismatch)) == 0)
-				continue; // Skip commands that errored if their input hasn't changed since last time (unless the rule version changed).
+			if (cooking_state == CookingState::Error && (command.mDirtyState & (CookingCommand::InputChanged | CookingCommand::VersionMismatch | CookingCommand::FingerprintMismatch)) == 0)
+				continue; // Skip commands that errored if their input hasn't changed since last time (unless the rule changed).
 
 			mCommandsToCook.Push(command_id);
 		}
@@ -1010,54 +1569,245 @@ void CookingSystem::QueueErroredCommands()
 
 			// If the command is in error state, queue it again.
 			if (cooking_state == CookingState::Error)
+			{
+				RemoveDebouncedCommand(command_id);
 				mCommandsToCook.Push(command_id);
+			}
 		}
 	}
 }
 
 
-static bool sRunCommandLine(StringView inCommandLine, StringPool::ResizableStringView& ioOutput, HANDLE inJobObject)
+// Get the USN of the last change to any of the inputs of a command.
+static USN sGetMaxInputUSN(const CookingCommand& inCommand)
 {
-	gAppendFormat(ioOutput, "Command Line: %s\n\n", inCommandLine.AsCStr());
+	// TODO this does not work if multiple drives are involved, we can only compare USNs from the same journal
+	USN max_input_usn = 0;
+	for (FileID input_id : inCommand.GetAllInputs())
+		max_input_usn = gMax(max_input_usn, input_id.GetFile().mLastChangeUSN);
+
+	return max_input_usn;
+}
+
 
-	// Create the process for the command line.
-	subprocess_s process;
-	int options = subprocess_option_no_window | subprocess_option_combined_stdout_stderr | subprocess_option_single_string_command_line | subprocess_option_enable_async;
+void CookingSystem::QueueCommandToCook(const CookingCommand& inCommand)
+{
+	const CookingRule& rule = inCommand.GetRule();
 
-	// Not strictly needed but some launched processes fail to read files if not used (access rights issues? unclear).
-	options |= subprocess_option_inherit_environment;
+	// Only debounce commands that are dirty because their inputs were just modified.
+	bool debounce = rule.mDebounceTime > 0.f 
+		&& (inCommand.mDirtyState & CookingCommand::InputChanged) 
+		&& gFileSystem.GetInitState() == FileSystem::InitState::Ready;
 
-	const char*  command_line_array[] = { inCommandLine.AsCStr(), nullptr };
-	if (subprocess_create(command_line_array, options, &process))
+	if (!debounce)
 	{
-		gAppendFormat(ioOutput, "[error] Failed to create process - %s\n", GetLastErrorString().AsCStr());
+		mCommandsToCook.Push(inCommand.mID);
+		return;
+	}
+
+	// If it's already waiting, don't add it twice.
+	if (ExtendDebounce(inCommand))
+		return;
+
+	{
+		LockGuard lock(mDebouncedCommandsMutex);
+
+		DebouncedCommand debounced_command;
+		debounced_command.mReleaseTicks = gGetTickCount() + gSecondsToTicks(rule.mDebounceTime);
+		debounced_command.mMaxInputUSN  = sGetMaxInputUSN(inCommand);
+
+		mDebouncedCommands.Insert(inCommand.mID, debounced_command);
+	}
+
+	// Make sure the monitor thread knows when to wake up to queue this command.
+	gFileSystem.KickMonitorDirectoryThread();
+}
+
+
+bool CookingSystem::ExtendDebounce(const CookingCommand& inCommand)
+{
+	LockGuard lock(mDebouncedCommandsMutex);
+
+	auto it = mDebouncedCommands.Find(inCommand.mID);
+	if (it == mDebouncedCommands.End())
 		return false;
+
+	// If the inputs changed again, wait some more.
+	USN max_input_usn = sGetMaxInputUSN(inCommand);
+	if (max_input_usn > it->mValue.mMaxInputUSN)
+	{
+		it->mValue.mMaxInputUSN  = max_input_usn;
+		it->mValue.mReleaseTicks = gGetTickCount() + gSecondsToTicks(inCommand.GetRule().mDebounceTime);
+
+		// Without debounce, this change would have caused another cook.
+		mCooksAvoidedByDebounce.Add(1);
 	}
 
-	// Assign the job object to the process, to make sure it is killed if the Asset Cooker process ends.
-	if (AssignProcessToJobObject(inJobObject, process.hProcess) == FALSE)
-		gAppFatalError("AssignProcessToJobObject failed - %s", GetLastErrorString().AsCStr());
+	return true;
+}
 
-	// Get the output.
-	// TODO: optionally skip getting the output?
-	// TODO: periodically check if we want to exit, and terminate the process (not possible with subprocess_read_stdout, there's no timeout option)
+
+void CookingSystem::RemoveDebouncedCommand(CookingCommandID inCommandID)
+{
+	LockGuard lock(mDebouncedCommandsMutex);
+	mDebouncedCommands.Erase(inCommandID);
+}
+
+
+int64 CookingSystem::ProcessDebouncedCommands()
+{
+	LockGuard lock(mDebouncedCommandsMutex);
+
+	int64 current_ticks      = gGetTickCount();
+	int64 next_release_ticks = 0;
+
+	for (auto it = mDebouncedCommands.Begin(); it != mDebouncedCommands.End();)
 	{
-		char  buffer[1024];
-		while (true)
+		if (it->mValue.mReleaseTicks > current_ticks)
 		{
-			int bytes_read = (int)subprocess_read_stdout(&process, buffer, sizeof(buffer) - 1);
-			buffer[bytes_read] = 0;
+			// Not ready yet, but remember when it will be.
+			if (next_release_ticks == 0 || it->mValue.mReleaseTicks < next_release_ticks)
+				next_release_ticks = it->mValue.mReleaseTicks;
 
-			if (bytes_read == 0)
-				break;
+			++it;
+			continue;
+		}
+
+		// The inputs have settled, queue the command (if it still needs to cook).
+		const CookingCommand& command = GetCommand(it->mKey);
+		if (command.IsDirty() && !IsCookingPaused())
+			mCommandsToCook.Push(command.mID);
 
-			ioOutput.Append({ buffer, bytes_read });
+		it = mDebouncedCommands.Erase(it);
+	}
+
+	return next_release_ticks;
+}
+
+
+// Held while creating processes, to make sure they only inherit their own output pipe.
+// Otherwise a process created at the same time by another cooking thread could keep our pipe open, and we'd wait until it exits.
+static Mutex sCreateProcessMutex;
+
+
+// Start a process with stdout and stderr both writing to outOutputPipe.
+// If outInputPipe is null, the process gets nothing on stdin, otherwise it's set to the write end of a pipe to its stdin.
+// The process is created suspended and only resumed once it's in both job objects, so that none of its child processes can escape them.
+static bool sCreateProcess(StringView inCommandLine, HANDLE inJobObject, HANDLE inCookJobObject, OwnedHandle& outProcess, OwnedHandle& outOutputPipe,
+						   OwnedHandle* outInputPipe, StringPool::ResizableStringView& ioOutput)
+{
+	constexpr int cPipeBufferSize = 64 * 1024;
+
+	PROCESS_INFORMATION process_info = {};
+	{
+		LockGuard lock(sCreateProcessMutex);
+
+		// Create a pipe for the output, stdout and stderr both write to it.
+		SECURITY_ATTRIBUTES inheritable = { .nLength = sizeof(SECURITY_ATTRIBUTES), .lpSecurityDescriptor = nullptr, .bInheritHandle = TRUE };
+		HANDLE              read_handle = nullptr, write_handle = nullptr;
+		if (!CreatePipe(&read_handle, &write_handle, &inheritable, cPipeBufferSize))
+		{
+			gAppendFormat(ioOutput, "[error] Failed to create output pipe - %s\n", GetLastErrorString().AsCStr());
+			return false;
+		}
+
+		OwnedHandle read_pipe  = read_handle;
+		OwnedHandle write_pipe = write_handle;
+
+		// Only the write end is for the process.
+		SetHandleInformation(read_pipe, HANDLE_FLAG_INHERIT, 0);
+
+		// Either a pipe to send data to the process, or nothing to read.
+		OwnedHandle input_read_pipe, input_write_pipe;
+		if (outInputPipe)
+		{
+			if (!CreatePipe(&read_handle, &write_handle, &inheritable, cPipeBufferSize))
+			{
+				gAppendFormat(ioOutput, "[error] Failed to create input pipe - %s\n", GetLastErrorString().AsCStr());
+				return false;
+			}
+
+			input_read_pipe  = read_handle;
+			input_write_pipe = write_handle;
+
+			// Only the read end is for the process.
+			SetHandleInformation(input_write_pipe, HANDLE_FLAG_INHERIT, 0);
 		}
+		else
+		{
+			input_read_pipe = CreateFileA("NUL", GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, &inheritable, OPEN_EXISTING, 0, nullptr);
+		}
+
+		STARTUPINFOA startup_info = {};
+		startup_info.cb           = sizeof(startup_info);
+		startup_info.dwFlags      = STARTF_USESTDHANDLES;
+		startup_info.hStdInput    = input_read_pipe;
+		startup_info.hStdOutput   = write_pipe;
+		startup_info.hStdError    = write_pipe;
+
+		// Create the process suspended, it needs to be in the job objects before it can start any child process.
+		TempString command_line = inCommandLine; // CreateProcessA needs a mutable string.
+		if (!CreateProcessA(nullptr, command_line.Data(), nullptr, nullptr, TRUE, CREATE_SUSPENDED | CREATE_NO_WINDOW, nullptr, nullptr, &startup_info, &process_info))
+		{
+			gAppendFormat(ioOutput, "[error] Failed to create process - %s\n", GetLastErrorString().AsCStr());
+			return false;
+		}
+
+		outOutputPipe = gMove(read_pipe);
+		if (outInputPipe)
+			*outInputPipe = gMove(input_write_pipe);
+
+		// Note: the ends of the pipes used by the process are closed when leaving this scope, the output pipe breaks as soon as the process (and its children) exit.
+	}
+
+	outProcess = process_info.hProcess;
+	OwnedHandle thread = process_info.hThread;
+
+	// Assign the job object to the process, to make sure it is killed if the Asset Cooker process ends.
+	if (AssignProcessToJobObject(inJobObject, outProcess) == FALSE)
+		gAppFatalError("AssignProcessToJobObject failed - %s", GetLastErrorString().AsCStr());
+
+	// Also assign the job object of this command (it becomes nested in the main one), to be able to kill it if cooking gets canceled.
+	if (AssignProcessToJobObject(inCookJobObject, outProcess) == FALSE)
+		gAppFatalError("AssignProcessToJobObject failed - %s", GetLastErrorString().AsCStr());
+
+	ResumeThread(thread);
+	return true;
+}
+
+
+// Run a command line and wait for it to finish. Return false if it couldn't be started or if it failed (non-zero exit code).
+// If outStarted is provided, it is set to whether the process could be started at all.
+static bool sRunCommandLine(StringView inCommandLine, StringPool::ResizableStringView& ioOutput, HANDLE inJobObject, HANDLE inCookJobObject, bool* outStarted = nullptr)
+{
+	gAppendFormat(ioOutput, "Command Line: %s\n\n", inCommandLine.AsCStr());
+
+	constexpr int cPipeBufferSize = 64 * 1024;
+
+	OwnedHandle process;
+	OwnedHandle read_pipe;
+	bool        started = sCreateProcess(inCommandLine, inJobObject, inCookJobObject, process, read_pipe, nullptr, ioOutput);
+	if (outStarted)
+		*outStarted = started;
+
+	if (!started)
+		return false;
+
+	// Get the output.
+	// Note: if cooking is canceled, the processes are killed and reading stops since the pipe gets closed.
+	// TODO: optionally skip getting the output?
+	{
+		char  buffer[cPipeBufferSize];
+		DWORD bytes_read = 0;
+		while (ReadFile(read_pipe, buffer, sizeof(buffer), &bytes_read, nullptr) && bytes_read > 0)
+			ioOutput.Append({ buffer, (int)bytes_read });
 	}
 
 	// Wait for the process to finish.
-	int exit_code = 0;
-	bool got_exit_code = subprocess_join(&process, &exit_code) == 0;
+	WaitForSingleObject(process, INFINITE);
+
+	DWORD exit_code     = 0;
+	bool  got_exit_code = GetExitCodeProcess(process, &exit_code) != FALSE;
 
 	bool success = true;
 
@@ -1069,16 +1819,13 @@ static bool sRunCommandLine(StringView inCommandLine, StringPool::ResizableStrin
 	}
 	else
 	{
-		gAppendFormat(ioOutput, "\nExit code: %d (0x%X)\n", exit_code, (uint32)exit_code);
+		gAppendFormat(ioOutput, "\nExit code: %d (0x%X)\n", (int)exit_code, (uint32)exit_code);
 	}
 
 	// Non-zero exit code is considered an error.
 	// TODO make that optional in the Rule
 	if (exit_code != 0)
 		success = false;
-	
-	// Destruct the process handles (this can't actually fail).
-	subprocess_destroy(&process);
 
 	return success;
 }
@@ -1098,14 +1845,251 @@ bool sRunCopyFile(const CookingCommand& inCommand, StringPool::ResizableStringVi
 }
 
 
-void CookingSystem::CookCommand(CookingCommand& ioCommand, CookingThread& ioThread)
+void CookingResourceUsage::Add(const CookingResourceUsage& inOther)
 {
-	CookingLogEntry& log_entry = *ioCommand.mLastCookingLog;
+	mUserTime   += inOther.mUserTime;
+	mKernelTime += inOther.mKernelTime;
+	mPeakMemory  = gMax(mPeakMemory, inOther.mPeakMemory);
+	mReadBytes  += inOther.mReadBytes;
+	mWriteBytes += inOther.mWriteBytes;
+}
 
-	// Allocate a resizable string for the output.
-	StringPool::ResizableStringView output_str = ioThread.mStringPool.CreateResizableString();
 
-	const CookingRule& rule    = ioCommand.GetRule();
+TempString CookingResourceUsage::ToString() const
+{
+	return gTempFormat("CPU Time: %.3f seconds (User: %.3f Kernel: %.3f) Peak Memory: %s Read: %s Written: %s",
+		(double)(mUserTime + mKernelTime) / 10'000'000.0, (double)mUserTime / 10'000'000.0, (double)mKernelTime / 10'000'000.0,
+		gFormatSizeInBytes(mPeakMemory).AsCStr(), gFormatSizeInBytes(mReadBytes).AsCStr(), gFormatSizeInBytes(mWriteBytes).AsCStr());
+}
+
+
+// Get the resources used so far by all the processes of a job object (including the ones that exited).
+static bool sQueryJobResourceUsage(HANDLE inJobObject, CookingResourceUsage& outUsage)
+{
+	JOBOBJECT_BASIC_AND_IO_ACCOUNTING_INFORMATION accounting = {};
+	if (!QueryInformationJobObject(inJobObject, JobObjectBasicAndIoAccountingInformation, &accounting, sizeof(accounting), nullptr))
+		return false;
+
+	JOBOBJECT_EXTENDED_LIMIT_INFORMATION limit_info = {};
+	if (!QueryInformationJobObject(inJobObject, JobObjectExtendedLimitInformation, &limit_info, sizeof(limit_info), nullptr))
+		return false;
+
+	outUsage.mUserTime   = accounting.BasicInfo.TotalUserTime.QuadPart;
+	outUsage.mKernelTime = accounting.BasicInfo.TotalKernelTime.QuadPart;
+	outUsage.mPeakMemory = limit_info.PeakJobMemoryUsed;
+	outUsage.mReadBytes  = accounting.IoInfo.ReadTransferCount;
+	outUsage.mWriteBytes = accounting.IoInfo.WriteTransferCount;
+	return true;
+}
+
+
+// Kill the worker if it's still running, and close its handles.
+static void sDestroyWorker(CookingSystem::Worker& ioWorker)
+{
+	TerminateJobObject(ioWorker.mJobObject, 1);
+	WaitForSingleObject(ioWorker.mProcess, INFINITE);
+
+	ioWorker = {};
+}
+
+
+bool CookingSystem::RunWorkerJob(CookingCommand& ioCommand, StringView inCommandLine, CookingThread& ioThread, StringPool::ResizableStringView& ioOutput)
+{
+	const CookingRule& rule = ioCommand.GetRule();
+
+	if (ioThread.mWorkers.Size() < (int)mRules.Size())
+		ioThread.mWorkers.Resize(mRules.Size());
+
+	Worker& worker = ioThread.mWorkers[rule.mID.mIndex];
+
+	// If the worker exited since the last job (it crashed, or it was killed), start a new one.
+	if (worker.mProcess.IsValid() && WaitForSingleObject(worker.mProcess, 0) != WAIT_TIMEOUT)
+	{
+		ioOutput.Append("Worker exited since the last job, restarting it.\n");
+		sDestroyWorker(worker);
+	}
+
+	if (!worker.mProcess.IsValid())
+	{
+		TempString worker_command_line;
+		if (!rule.mWorkerCommandLineTemplate.FormatCommandString(gFileSystem.GetFile(ioCommand.GetMainInput()), worker_command_line))
+		{
+			ioOutput.Append("[error] Failed to format worker command line.\n");
+			return false;
+		}
+
+		gAppendFormat(ioOutput, "Starting Worker: %s\n", worker_command_line.AsCStr());
+
+		// Same as sRunCommandLine, the main job object makes sure the worker is killed if the Asset Cooker process ends.
+		// The worker has its own nested job object instead of the one of the command, since it outlives it.
+		worker.mJobObject = sCreateCookJobObject();
+		if (!sCreateProcess(worker_command_line, mJobObject, worker.mJobObject, worker.mProcess, worker.mOutputPipe, &worker.mInputPipe, ioOutput))
+		{
+			ioOutput.Append("[error] Failed to start the worker.\n");
+			worker = {};
+			return false;
+		}
+	}
+
+	// Killing the worker is the only way to cancel the job.
+	{
+		LockGuard lock(ioThread.mCancelMutex);
+		if (ioThread.mCancelRequested)
+			return false;
+
+		ioThread.mCookJobObject = worker.mJobObject;
+	}
+
+	// Build the job. The static inputs and outputs are sent as absolute paths, with the main input first.
+	TempString job;
+	gAppendFormat(job, "COMMAND: %s\n", inCommandLine.AsCStr());
+	for (FileID input_id : ioCommand.mInputs)
+		gAppendFormat(job, "INPUT: %s%s\n", input_id.GetRepo().mRootPath.AsCStr(), input_id.GetFile().mPath.AsCStr());
+	for (FileID output_id : ioCommand.mOutputs)
+		gAppendFormat(job, "OUTPUT: %s%s\n", output_id.GetRepo().mRootPath.AsCStr(), output_id.GetFile().mPath.AsCStr());
+	job += "END\n";
+
+	gAppendFormat(ioOutput, "Worker Job:\n%s\n", job.AsCStr());
+
+	// Kill the worker if the job takes too long. The callback runs on a thread of the default timer queue.
+	struct TimeOutData
+	{
+		HANDLE       mJobObject = nullptr;
+		Atomic<bool> mTimedOut = false;
+	};
+	TimeOutData time_out_data = { .mJobObject = worker.mJobObject };
+	HANDLE      time_out_timer = nullptr;
+	if (rule.mWorkerTimeout > 0.f)
+	{
+		constexpr ULONG cExecuteOnlyOnce = 0x8; // WT_EXECUTEONLYONCE
+
+		auto callback = [](void* inData, BOOLEAN)
+		{
+			TimeOutData& data = *(TimeOutData*)inData;
+			data.mTimedOut.Store(true);
+			TerminateJobObject(data.mJobObject, 1);
+		};
+
+		if (!CreateTimerQueueTimer(&time_out_timer, nullptr, callback, &time_out_data, (DWORD)(rule.mWorkerTimeout * 1000.f), 0, cExecuteOnlyOnce))
+			gAppFatalError("CreateTimerQueueTimer failed - %s", GetLastErrorString().AsCStr());
+	}
+
+	// The worker job object accumulates the resources used by all the jobs, remember where this one starts.
+	CookingResourceUsage usage_before_job;
+	(void)sQueryJobResourceUsage(worker.mJobObject, usage_before_job);
+
+	// Send the job.
+	DWORD bytes_written = 0;
+	bool  job_sent      = WriteFile(worker.mInputPipe, job.Data(), (DWORD)job.Size(), &bytes_written, nullptr) && bytes_written == (DWORD)job.Size();
+
+	// Read the output until the exit line.
+	// Note: if the worker crashes or gets killed, the pipe is closed and reading stops.
+	TempString job_output;
+	int        line_start    = 0;
+	bool       got_exit_code = false;
+	int        exit_code     = 0;
+	while (job_sent && !got_exit_code)
+	{
+		char  buffer[1024];
+		DWORD bytes_read = 0;
+		if (!ReadFile(worker.mOutputPipe, buffer, sizeof(buffer), &bytes_read, nullptr) || bytes_read == 0)
+			break;
+
+		job_output += StringView(buffer, (int)bytes_read);
+
+		// Look for the exit line in the complete lines received so far.
+		while (true)
+		{
+			int line_size = job_output.SubStr(line_start).Find('\n');
+			if (line_size == -1)
+				break;
+
+			StringView line = job_output.SubStr(line_start, line_size);
+			gRemoveTrailing(line, "\r");
+
+			if (gStartsWith(line, "EXIT: "))
+			{
+				exit_code     = atoi(TempString(line.SubStr(6)).AsCStr());
+				got_exit_code = true;
+				job_output.RemoveSuffix(job_output.Size() - line_start); // Anything after the exit line is ignored.
+				break;
+			}
+
+			line_start += line_size + 1;
+		}
+	}
+
+	// Wait for the timer callback to be done (if it was called at all), it uses time_out_data.
+	if (time_out_timer != nullptr)
+		DeleteTimerQueueTimer(nullptr, time_out_timer, INVALID_HANDLE_VALUE);
+
+	// Stop using the worker job object for cancellation, it's going to be reused (or destroyed).
+	{
+		LockGuard lock(ioThread.mCancelMutex);
+		ioThread.mCookJobObject = nullptr;
+	}
+
+	ioOutput.Append(job_output);
+
+	// Count only the resources used during this job (except for the peak memory, which is for the whole life of the worker).
+	CookingResourceUsage usage_after_job;
+	if (sQueryJobResourceUsage(worker.mJobObject, usage_after_job))
+	{
+		usage_after_job.mUserTime   -= usage_before_job.mUserTime;
+		usage_after_job.mKernelTime -= usage_before_job.mKernelTime;
+		usage_after_job.mReadBytes  -= usage_before_job.mReadBytes;
+		usage_after_job.mWriteBytes -= usage_before_job.mWriteBytes;
+		ioCommand.mLastCookingLog->mResourceUsage.Add(usage_after_job);
+	}
+
+	if (!got_exit_code)
+	{
+		if (time_out_data.mTimedOut.Load())
+			gAppendFormat(ioOutput, "\n[error] Worker timed out after %.1f seconds, it will be restarted.\n", rule.mWorkerTimeout);
+		else if (!job_sent)
+			ioOutput.Append("\n[error] Failed to send the job to the worker, it will be restarted.\n");
+		else
+			ioOutput.Append("\n[error] Worker exited before finishing the job, it will be restarted.\n");
+
+		// The worker is in an unknown state, don't reuse it.
+		sDestroyWorker(worker);
+		return false;
+	}
+
+	gAppendFormat(ioOutput, "\nExit code: %d (0x%X)\n", exit_code, (uint32)exit_code);
+
+	// Non-zero exit code is considered an error (but the worker itself is fine).
+	return exit_code == 0;
+}
+
+
+void CookingSystem::StopWorkers(CookingThread& ioThread)
+{
+	// How long a worker gets to exit by itself before it's killed.
+	constexpr DWORD cWorkerExitTimeoutMs = 1000;
+
+	for (Worker& worker : ioThread.mWorkers)
+	{
+		if (!worker.mProcess.IsValid())
+			continue;
+
+		// Closing stdin tells the worker there are no more jobs. Give it a chance to exit cleanly, and kill it if it doesn't.
+		worker.mInputPipe.Close();
+
+		if (WaitForSingleObject(worker.mProcess, cWorkerExitTimeoutMs) == WAIT_TIMEOUT)
+			sDestroyWorker(worker);
+		else
+			worker = {};
+	}
+
+	ioThread.mWorkers.Clear();
+}
+
+
+bool CookingSystem::PrepareCook(CookingCommand& ioCommand, StringPool::ResizableStringView& ioOutput)
+{
+	const CookingLogEntry& log_entry = *ioCommand.mLastCookingLog;
+	const CookingRule&     rule      = ioCommand.GetRule();
 
 	// Update the last cook USN (used later know if this command needs to cook again).
 	// Note: when there's a DepFile, we don't know the full list of inputs before reading it, so it will be done again later, after reading it.
@@ -1130,8 +2114,9 @@ void CookingSystem::CookCommand(CookingCommand& ioCommand, CookingThread& ioThre
 	// Update the last cook time.
 	ioCommand.mLastCookTime = log_entry.mTimeStart;
 
-	// Update the last cook version.
+	// Update the last cook version and fingerprint.
 	ioCommand.mLastCookRuleVersion = rule.mVersion;
+	ioCommand.mLastCookFingerprint = ioCommand.mFingerprint;
 
 	// Sleep to make things slow (for debugging).
 	// Note: use the command main input path as seed to make it consistent accross runs (useful if we want to add loading bars).
@@ -1147,16 +2132,12 @@ void CookingSystem::CookCommand(CookingCommand& ioCommand, CookingThread& ioThre
 			if (input.IsDeleted())
 			{
 				all_inputs_exist = false;
-				gAppendFormat(output_str, "[error] Input missing: %s\n", input.ToString().AsCStr());
+				gAppendFormat(ioOutput, "[error] Input missing: %s\n", input.ToString().AsCStr());
 			}
 		}
 
 		if (!all_inputs_exist)
-		{
-			log_entry.mOutput = output_str.AsStringView();
-			log_entry.mCookingState.Store(CookingState::Error);
-			return;
-		}
+			return false;
 	}
 
 	// Make sure the directories for all the outputs exist.
@@ -1169,56 +2150,103 @@ void CookingSystem::CookCommand(CookingCommand& ioCommand, CookingThread& ioThre
 			if (!success)
 			{
 				all_dirs_exist = false;
-				gAppendFormat(output_str, "[error] Failed to create directory for %s\n", output_file.GetFile().ToString().AsCStr());
+				gAppendFormat(ioOutput, "[error] Failed to create directory for %s\n", output_file.GetFile().ToString().AsCStr());
 			}
 		}
 
 		if (!all_dirs_exist)
-		{
-			log_entry.mOutput = output_str.AsStringView();
-			log_entry.mCookingState.Store(CookingState::Error);
-			return;
-		}
+			return false;
 	}
 
 	// Fake random failures for debugging.
 	if (gDebugFailCookingRandomly && (gRand32() % 5) == 0)
 	{
-		output_str.Append("Uh oh! This is a fake failure for debug purpose!\n");
-		log_entry.mOutput = output_str.AsStringView();
+		ioOutput.Append("Uh oh! This is a fake failure for debug purpose!\n");
+		return false;
+	}
+
+	return true;
+}
+
+
+void CookingSystem::CookCommand(CookingCommand& ioCommand, CookingThread& ioThread)
+{
+	CookingLogEntry& log_entry = *ioCommand.mLastCookingLog;
+
+	// Allocate a resizable string for the output.
+	StringPool::ResizableStringView output_str = ioThread.mStringPool.CreateResizableString();
+	defer { output_str.Free(); }; // The output is copied to the cooking log, give the memory back to the pool for the next cook.
+
+	const CookingRule& rule    = ioCommand.GetRule();
+
+	if (!PrepareCook(ioCommand, output_str))
+	{
+		mCookingLogStorage.SetOutput(log_entry, output_str.AsStringView());
 		log_entry.mCookingState.Store(CookingState::Error);
 		return;
 	}
-
 	
 	// If there is a dep file command line, build it.
 	TempString dep_command_line;
 	if (!rule.mDepFileCommandLine.Empty())
 	{
-		if (!gFormatCommandString(rule.mDepFileCommandLine, gFileSystem.GetFile(ioCommand.GetMainInput()), dep_command_line))
+		if (!rule.mDepFileCommandLineTemplate.FormatCommandString(gFileSystem.GetFile(ioCommand.GetMainInput()), dep_command_line))
 		{
 			output_str.Append("[error] Failed to format dep file command line.\n");
-			log_entry.mOutput = output_str.AsStringView();
+			mCookingLogStorage.SetOutput(log_entry, output_str.AsStringView());
 			log_entry.mCookingState.Store(CookingState::Error);
 			return;
 		}
 	}
 
+	// Create a job object for the processes of this command and make it available to CancelCooking.
+	OwnedHandle cook_job_object = sCreateCookJobObject();
+	{
+		LockGuard lock(ioThread.mCancelMutex);
+		ioThread.mCookJobObject   = cook_job_object;
+		ioThread.mCancelRequested = false;
+	}
+
+	// Make sure the job object isn't used after being closed, even on early return.
+	defer
+	{
+		LockGuard lock(ioThread.mCancelMutex);
+		ioThread.mCookJobObject = nullptr;
+	};
+
 	bool success = false;
 	if (rule.mCommandType == CommandType::CommandLine)
 	{
 		// Build the command line.
 		TempString command_line;
-		if (!gFormatCommandString(rule.mCommandLine, gFileSystem.GetFile(ioCommand.GetMainInput()), command_line))
+		if (!rule.mCommandLineTemplate.FormatCommandString(gFileSystem.GetFile(ioCommand.GetMainInput()), command_line))
 		{
 			output_str.Append("[error] Failed to format command line.\n");
-			log_entry.mOutput = output_str.AsStringView();
+			mCookingLogStorage.SetOutput(log_entry, output_str.AsStringView());
 			log_entry.mCookingState.Store(CookingState::Error);
 			return;
 		}
 
 		// Run the command line.
-		success = sRunCommandLine(command_line, output_str, mJobObject);
+		success = sRunCommandLine(command_line, output_str, mJobObject, cook_job_object);
+	}
+	else if (rule.mCommandType == CommandType::Worker)
+	{
+		// Build the command line sent with the job.
+		TempString command_line;
+		if (!rule.mCommandLineTemplate.FormatCommandString(gFileSystem.GetFile(ioCommand.GetMainInput()), command_line))
+		{
+			output_str.Append("[error] Failed to format command line.\n");
+			mCookingLogStorage.SetOutput(log_entry, output_str.AsStringView());
+			log_entry.mCookingState.Store(CookingState::Error);
+			return;
+		}
+
+		success = RunWorkerJob(ioCommand, command_line, ioThread, output_str);
+
+		// Processes started for the dep file use the job object of the command again.
+		LockGuard lock(ioThread.mCancelMutex);
+		ioThread.mCookJobObject = cook_job_object;
 	}
 	else
 	{
@@ -1235,34 +2263,212 @@ void CookingSystem::CookCommand(CookingCommand& ioCommand, CookingThread& ioThre
 		}
 	}
 
-	// If there's a dep file command line, run it next.
-	if (success && !dep_command_line.Empty())
+	// If there's a dep file command line, run it next.
+	if (success && !dep_command_line.Empty())
+	{
+		output_str.Append("\nDep File "); // No end line on purpose, we want to prepend the line added inside the sRunCommandLine.
+		success = sRunCommandLine(dep_command_line, output_str, mJobObject, cook_job_object);
+	}
+
+	// Or if the dep file comes from a built-in scanner, run it directly.
+	if (success && rule.mDepFileScanner != DepFileScanner::None)
+	{
+		output_str.Append("\nDep File ");
+		success = gRunDepFileScanner(ioCommand, output_str);
+	}
+
+	// Get the resources used by the processes of this command.
+	CookingResourceUsage usage;
+	if (sQueryJobResourceUsage(cook_job_object, usage))
+		log_entry.mResourceUsage.Add(usage);
+
+	// Check if cooking was canceled (and make sure it can't be anymore).
+	bool canceled;
+	{
+		LockGuard lock(ioThread.mCancelMutex);
+		ioThread.mCookJobObject = nullptr;
+		canceled                = ioThread.mCancelRequested;
+	}
+
+	if (canceled)
+		output_str.Append("\n[canceled] An input changed while cooking, the command will cook again.\n");
+
+	// Set the end time and add the duration at the end of the log.
+	log_entry.mTimeEnd = gGetSystemTimeAsFileTime();
+	gAppendFormat(output_str, "\nDuration: %.3f seconds\n", (double)(log_entry.mTimeEnd - log_entry.mTimeStart) / 1'000'000'000.0);
+	if (rule.mCommandType != CommandType::CopyFile) // Built-in commands don't start processes.
+		gAppendFormat(output_str, "%s\n", log_entry.mResourceUsage.ToString().AsCStr());
+
+	// Store the log output (only a part of it if it's too large, the rest goes to the session output file).
+	log_entry.mFullOutput = gSpillCookOutput(output_str);
+	mCookingLogStorage.SetOutput(log_entry, output_str.AsStringView());
+
+	if (canceled)
+	{
+		// Don't wait for the outputs, the command is still dirty and will be queued again.
+		log_entry.mCookingState.Store(CookingState::Canceled);
+	}
+	else if (!success)
+	{
+		log_entry.mCookingState.Store(CookingState::Error);
+	}
+	else
+	{
+		// Don't wait for the USN journal to confirm the outputs were written if we can check directly.
+		VerifyOutputs(ioCommand);
+
+		// Now we wait for confirmation that the outputs were written (and if yes, it's a success).
+		log_entry.mCookingState.Store(CookingState::Waiting);
+
+		// Any time an output is detected changed, we will try updating the cooking state.
+		// If all outputs were written, cooking is a success.
+		// If timeout happens first, we declare it's an error because of outputs not written.
+		AddTimeOut(&log_entry);
+	}
+
+	// Make sure the file changes are processed as soon as possible (even if there was an error, there might be some files written).
+	gFileSystem.KickMonitorDirectoryThread();
+}
+
+
+void CookingSystem::CookBatch(Span<const CookingCommandID> inCommandIDs, CookingLane inLane, CookingThread& ioThread)
+{
+	const CookingRule& rule = GetCommand(inCommandIDs[0]).GetRule();
+	gAssert(rule.UseBatching() && rule.mCommandType == CommandType::CommandLine);
+
+	// Allocate all the log entries first, so that all the commands show as cooking.
+	for (CookingCommandID command_id : inCommandIDs)
+	{
+		CookingCommand&  command   = GetCommand(command_id);
+		CookingLogEntry& log_entry = AllocateCookingLogEntry(command_id);
+		log_entry.mLane            = inLane;
+		command.mLastCookingLog    = &log_entry;
+	}
+
+	// The UI shows the first command as the one being cooked by this thread.
+	ioThread.mCurrentLogEntry.Store(GetCommand(inCommandIDs[0]).mLastCookingLog->mID);
+
+	// Prepare the commands and build the response file (one line per command).
+	TempVector<CookingCommand*> batch;
+	String                      response_file_content; // Not a TempString, it can get big.
+	for (CookingCommandID command_id : inCommandIDs)
+	{
+		CookingCommand&  command   = GetCommand(command_id);
+		CookingLogEntry& log_entry = *command.mLastCookingLog;
+
+		if (command.mDirtyState & CookingCommand::AllStaticInputsMissing)
+		{
+			CleanupCommand(command, ioThread);
+			continue;
+		}
+
+		StringPool::ResizableStringView output_str = ioThread.mStringPool.CreateResizableString();
+		defer { output_str.Free(); };
+
+		bool       success = PrepareCook(command, output_str);
+		TempString line;
+		if (success && !rule.mCommandLineTemplate.FormatCommandString(gFileSystem.GetFile(command.GetMainInput()), line))
+		{
+			output_str.Append("[error] Failed to format command line.\n");
+			success = false;
+		}
+
+		if (!success)
+		{
+			mCookingLogStorage.SetOutput(log_entry, output_str.AsStringView());
+			log_entry.mCookingState.Store(CookingState::Error);
+			continue;
+		}
+
+		response_file_content += line;
+		response_file_content += "\n";
+		batch.PushBack(&command);
+	}
+
+	if (batch.Empty())
+		return;
+
+	// The output is shared by all the commands of the batch.
+	StringPool::ResizableStringView output_str = ioThread.mStringPool.CreateResizableString();
+	defer { output_str.Free(); };
+	gAppendFormat(output_str, "Batch of %d commands.\n", batch.Size());
+
+	// Write the response file.
+	TempString batch_dir          = gGetAbsolutePath(gTempFormat(R"(%s\Batches)", gApp.mCacheDirectory.AsCStr()));
+	TempString response_file_path = gTempFormat(R"(%s\Batch_%u.rsp)", batch_dir.AsCStr(), batch[0]->mLastCookingLog->mID.mIndex);
+	bool       success            = gCreateDirectoryRecursive(batch_dir);
+	if (success)
 	{
-		output_str.Append("\nDep File "); // No end line on purpose, we want to prepend the line added inside the sRunCommandLine.
-		success = sRunCommandLine(dep_command_line, output_str, mJobObject);
+		FILE* response_file = fopen(response_file_path.AsCStr(), "wb");
+		success = response_file != nullptr && fwrite(response_file_content.Data(), 1, response_file_content.Size(), response_file) == (size_t)response_file_content.Size();
+		if (response_file != nullptr)
+			fclose(response_file);
 	}
 
-	// Set the end time and add the duration at the end of the log.
-	log_entry.mTimeEnd = gGetSystemTimeAsFileTime();
-	gAppendFormat(output_str, "\nDuration: %.3f seconds\n", (double)(log_entry.mTimeEnd - log_entry.mTimeStart) / 1'000'000'000.0);
+	if (!success)
+		gAppendFormat(output_str, "[error] Failed to write response file %s\n", response_file_path.AsCStr());
 
-	// Store the log output.
-	log_entry.mOutput = output_str.AsStringView();
-	gParseANSIColors(log_entry.mOutput, log_entry.mOutputFormatSpans);
+	// Build the command line and run it.
+	TempString command_line;
+	if (success && !rule.mBatchCommandLineTemplate.FormatCommandString(gFileSystem.GetFile(batch[0]->GetMainInput()), command_line))
+	{
+		output_str.Append("[error] Failed to format batch command line.\n");
+		success = false;
+	}
 
-	if (!success)
+	CookingResourceUsage batch_usage;
+	if (success)
 	{
-		log_entry.mCookingState.Store(CookingState::Error);
+		gAppendFormat(command_line, R"( "%s")", response_file_path.AsCStr());
+
+		// Batches can't be canceled (see RuleReader), but the processes still need a job object.
+		// A non-zero exit code is ignored since some commands of the batch might have succeeded, but if the process didn't even start nothing was written.
+		OwnedHandle cook_job_object = sCreateCookJobObject();
+		(void)sRunCommandLine(command_line, output_str, mJobObject, cook_job_object, &success);
+
+		(void)sQueryJobResourceUsage(cook_job_object, batch_usage);
 	}
-	else
+
+	DeleteFileA(response_file_path.AsCStr());
+
+	// Set the end time and add the duration at the end of the log.
+	FileTime time_end = gGetSystemTimeAsFileTime();
+	gAppendFormat(output_str, "\nDuration: %.3f seconds\n", (double)(time_end - batch[0]->mLastCookingLog->mTimeStart) / 1'000'000'000.0);
+	gAppendFormat(output_str, "%s\n", batch_usage.ToString().AsCStr());
+
+	// There's no way to know which command used what, split the resources evenly (the peak memory is shared).
+	CookingResourceUsage command_usage = batch_usage;
+	command_usage.mUserTime   /= batch.Size();
+	command_usage.mKernelTime /= batch.Size();
+	command_usage.mReadBytes  /= batch.Size();
+	command_usage.mWriteBytes /= batch.Size();
+
+	// Store the log output once, in the entry of the first command. The others share it.
+	CookOutputRef          full_output  = gSpillCookOutput(output_str);
+	const CookingLogEntry& output_owner = *batch[0]->mLastCookingLog;
+
+	for (CookingCommand* command : batch)
 	{
+		CookingLogEntry& log_entry   = *command->mLastCookingLog;
+		log_entry.mTimeEnd           = time_end;
+		log_entry.mFullOutput        = full_output;
+		log_entry.mResourceUsage     = command_usage;
 
-		// Now we wait for confirmation that the outputs were written (and if yes, it's a success).
-		log_entry.mCookingState.Store(CookingState::Waiting);
+		if (&log_entry == &output_owner)
+			mCookingLogStorage.SetOutput(log_entry, output_str.AsStringView());
+		else
+			mCookingLogStorage.SetSharedOutput(log_entry, output_owner);
 
-		// Any time an output is detected changed, we will try updating the cooking state.
-		// If all outputs were written, cooking is a success.
-		// If timeout happens first, we declare it's an error because of outputs not written.
+		if (!success)
+		{
+			log_entry.mCookingState.Store(CookingState::Error);
+			continue;
+		}
+
+		// Even if the process failed, some commands of the batch might have succeeded.
+		// Each command is a success only if all its outputs were written, same as a single command.
+		VerifyOutputs(*command);
+		log_entry.mCookingState.Store(CookingState::Waiting);
 		AddTimeOut(&log_entry);
 	}
 
@@ -1278,6 +2484,7 @@ void CookingSystem::CleanupCommand(CookingCommand& ioCommand, CookingThread& ioT
 	log_entry.mIsCleanup       = true;
 
 	StringPool::ResizableStringView output_str = ioThread.mStringPool.CreateResizableString();
+	defer { output_str.Free(); };
 
 	bool error = false;
 	for (FileID output_id : ioCommand.mOutputs)
@@ -1293,8 +2500,8 @@ void CookingSystem::CleanupCommand(CookingCommand& ioCommand, CookingThread& ioT
 		}
 	}
 
-	log_entry.mOutput       = output_str.AsStringView();
-	log_entry.mOutputFormatSpans.ClearAndFreeMemory();
+	log_entry.mFullOutput   = gSpillCookOutput(output_str);
+	mCookingLogStorage.SetOutput(log_entry, output_str.AsStringView());
 
 	log_entry.mTimeEnd      = gGetSystemTimeAsFileTime();
 
@@ -1313,79 +2520,141 @@ void CookingSystem::CleanupCommand(CookingCommand& ioCommand, CookingThread& ioT
 }
 
 
-void CookingSystem::AddTimeOut(CookingLogEntry* inLogEntry)
+void CookingSystem::CancelCooking(CookingCommandID inCommandID)
 {
+	const CookingCommand& command   = GetCommand(inCommandID);
+	const CookingRule&    rule      = command.GetRule();
+	CookingLogEntry*      log_entry = command.mLastCookingLog;
+
+	if (!rule.mCancelOnInputChange)
+		return;
+
+	if (log_entry == nullptr || log_entry->mCookingState.Load() != CookingState::Cooking)
+		return;
+
+	// Don't cancel commands that started recently if the rule asks for a minimum runtime.
+	double cooking_seconds = (double)(gGetSystemTimeAsFileTime() - log_entry->mTimeStart) / 1'000'000'000.0;
+	if (cooking_seconds < rule.mCancelMinRuntime)
+		return;
+
+	// Find the thread cooking this command.
+	for (CookingThread& thread : mCookingThreads)
 	{
-		LockGuard lock(mTimeOutMutex);
-		mTimeOutNextBatch.Insert(inLogEntry);
-	}
+		if (thread.mCurrentLogEntry.Load() != log_entry->mID)
+			continue;
+
+		LockGuard lock(thread.mCancelMutex);
+
+		// Check again with the lock, the command might have finished cooking in the meantime.
+		if (thread.mCurrentLogEntry.Load() != log_entry->mID || thread.mCookJobObject == nullptr || thread.mCancelRequested)
+			return;
 
-	// Tell the thread there are timeouts to process.
-	mTimeOutAddedSignal.NotifyOne();
+		thread.mCancelRequested = true;
+
+		gAppLog("Canceling %s, an input changed while cooking.", gToString(command).AsCStr());
+
+		// Kill all the processes of this command. This also unblocks the cooking thread waiting for their output.
+		if (TerminateJobObject(thread.mCookJobObject, 1) == FALSE)
+			gAppLogError("TerminateJobObject failed - %s", GetLastErrorString().AsCStr());
+
+		return;
+	}
 }
 
 
-void CookingSystem::TimeOutUpdateThread()
+void CookingSystem::VerifyOutputs(const CookingCommand& inCommand)
 {
-	// The logic in this loop is a bit weird, but the idea is to wait *at least* this amount of time before declaring a command is in error.
-	// Many commands will wait twice as much because they won't be in the first batch to be processed, but that's okay.
-	constexpr auto cTimeout = 0.3_S;
+	// Only the static outputs can be checked here, the others are in the dep file which is read by the monitor thread.
+	if (GetRule(inCommand.mRuleID).UseDepFile())
+		return;
 
-	while (true)
+	TempVector<VerifiedOutput> verified_outputs;
+	verified_outputs.Reserve(inCommand.mOutputs.Size());
+
+	for (FileID output_id : inCommand.mOutputs)
 	{
-		{
-			LockGuard lock(mTimeOutMutex);
+		FileRepo&   repo      = output_id.GetRepo();
+		TempString  full_path = gConcat(repo.mRootPath, output_id.GetFile().mPath);
+		OwnedHandle handle    = CreateFileA(full_path.AsCStr(), FILE_GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
 
-			// Wait until there are time outs to update.
-			while (mTimeOutNextBatch.Empty())
-			{
-				mTimeOutAddedSignal.Wait(lock);
+		// If it fails (not written, or still in use), the USN journal will tell.
+		if (!handle.IsValid())
+			continue;
 
-				if (mTimeOutUpdateThread.IsStopRequested())
-					return;
-			}
+		VerifiedOutput output;
+		output.mFileID = output_id;
+		if (repo.mDrive.GetUSN(handle, output.mUSN, output.mRefNumber))
+			verified_outputs.PushBack(output);
+	}
 
-			// Swap the buffers.
-			gSwap(mTimeOutNextBatch, mTimeOutCurrentBatch);
-		}
+	if (verified_outputs.Empty())
+		return;
 
-		do
-		{
-			// Wait for the time out.
-			(void)mTimeOutTimerSignal.TryAcquireFor(cTimeout);
+	LockGuard lock(mVerifiedOutputsMutex);
+	for (const VerifiedOutput& output : verified_outputs)
+		mVerifiedOutputs.PushBack(output);
+}
 
-			if (mTimeOutUpdateThread.IsStopRequested())
-				return;
 
-			// If the file system is still busy, wait more. Otherwise we might incorrectly declare some commands are errors.
-			// It can take a long time to process the events, especially if we need to open a lot of new files to get their path.
-		} while (!gFileSystem.IsMonitoringIdle());
-		
-		// Declare all the unfinished commands in the current buffer as errored.
-		{
-			LockGuard lock(mTimeOutMutex);
+bool CookingSystem::ProcessVerifiedOutputs()
+{
+	Vector<VerifiedOutput> verified_outputs;
+	{
+		LockGuard lock(mVerifiedOutputsMutex);
+		gSwap(verified_outputs, mVerifiedOutputs);
+	}
 
-			for (CookingLogEntry* log_entry : mTimeOutCurrentBatch)
-			{
-				// At this point if the state is still Waiting, we can consider it a failure: some outputs were not written.
-				if (log_entry->mCookingState.Load() == CookingState::Waiting)
-				{
-					log_entry->mCookingState.Store(CookingState::Error);
+	for (const VerifiedOutput& output : verified_outputs)
+	{
+		FileInfo& file = output.mFileID.GetFile();
 
-					// Update the total count of errors.
-					mCookingErrors.Add(1);
+		// If the file was replaced (eg. written to a temp file then renamed) or isn't known to exist yet, let the USN journal handle it.
+		if (file.mRefNumber != output.mRefNumber)
+			continue;
 
-					// Notify the system that this command has officially finished cooking.
-					mCommandsToCook.FinishedCooking(*log_entry);
+		// Already seen.
+		if (output.mUSN <= file.mLastChangeUSN)
+			continue;
 
-					// Update the dirty state so that it's set to Error.
-					QueueUpdateDirtyState(log_entry->mCommandID);
-				}
-			}
+		file.mLastChangeUSN = output.mUSN;
 
-			mTimeOutCurrentBatch.Clear();
-		}
+		// Same as a change seen in the USN journal: update the command that wrote it and the ones that depend on it.
+		// The journal events for this change will be ignored since their USN isn't newer.
+		QueueUpdateDirtyStates(file.mID);
 	}
+
+	return !verified_outputs.Empty();
+}
+
+
+void CookingSystem::AddTimeOut(CookingLogEntry* inLogEntry)
+{
+	// The timer is processed by the monitor thread after it's done with the pending file system events,
+	// so that commands aren't declared in error only because their outputs weren't noticed yet.
+	constexpr double cTimeOut = 0.3; // In seconds.
+
+	gFileSystem.AddTimer(MonitorTimer::OutputTimeOut(inLogEntry->mID), cTimeOut);
+}
+
+
+void CookingSystem::TimeOutLogEntry(CookingLogEntryID inID)
+{
+	CookingLogEntry& log_entry = GetLogEntry(inID);
+
+	// At this point if the state is still Waiting, we can consider it a failure: some outputs were not written.
+	if (log_entry.mCookingState.Load() != CookingState::Waiting)
+		return;
+
+	log_entry.mCookingState.Store(CookingState::Error);
+
+	// Update the total count of errors.
+	mCookingErrors.Add(1);
+
+	// Notify the system that this command has officially finished cooking.
+	mCommandsToCook.FinishedCooking(log_entry);
+
+	// Update the dirty state so that it's set to Error.
+	QueueUpdateDirtyState(log_entry.mCommandID);
 }
 
 
@@ -1401,6 +2670,34 @@ void CookingSystem::QueueUpdateDirtyStates(FileID inFileID)
 	if (file.mInputOf.Empty() && file.mOutputOf.Empty())
 		return; // Early out if we know there will be nothing to do.
 
+	// After init, changes to source files (or to outputs of interactive commands) come from someone iterating on them.
+	// Move the commands they affect to the interactive lane so they don't wait behind the background commands.
+	if (gFileSystem.GetInitState() == FileSystem::InitState::Ready)
+	{
+		bool is_interactive_change = file.mOutputOf.Empty();
+		for (CookingCommandID command_id : file.mOutputOf)
+			is_interactive_change |= GetCommand(command_id).mIsInteractive;
+
+		if (is_interactive_change)
+		{
+			for (CookingCommandID command_id : file.mInputOf)
+			{
+				CookingCommand& command = GetCommand(command_id);
+				if (command.mIsInteractive)
+					continue;
+
+				command.mIsInteractive = true;
+
+				// If it was already queued in the background lane, move it.
+				(void)mCommandsToCook.MoveToInteractiveLane(command_id);
+			}
+		}
+	}
+
+	// If commands are still cooking with the previous version of this file, cancel them (if their rule allows it).
+	for (CookingCommandID command_id : file.mInputOf)
+		CancelCooking(command_id);
+
 	LockGuard lock(mCommandsQueuedForUpdateDirtyStateMutex);
 
 	for (CookingCommandID command_id : file.mInputOf)
@@ -1443,10 +2740,65 @@ bool CookingSystem::ProcessUpdateDirtyStates()
 
 void CookingSystem::UpdateAllDirtyStates()
 {
+	// Find all the commands that need to read their dep file.
+	TempVector<CookingCommandID> dep_files_to_read;
+	for (CookingCommand& command : mCommands)
+	{
+		if (command.NeedsToReadDepFile() && !command.GetDepFile().GetFile().IsDeleted())
+			dep_files_to_read.PushBack(command.mID);
+	}
+
+	// Reading the dep files one by one is very slow when they're not in the file cache (lots of small reads), so read and parse them in parallel first.
+	// Applying their content (updating the InputOf/OutputOf lists) isn't thread safe, that is done below by UpdateDirtyState.
+	Vector<DepFileContent> dep_files_content;
+	dep_files_content.Resize(dep_files_to_read.Size());
+
+	if (!dep_files_to_read.Empty())
+	{
+		gAppLog("Reading %d Dep Files.", dep_files_to_read.Size());
+		Timer timer;
+
+		// Reading is mostly IO bound, having more reads in flight helps even with few cores.
+		constexpr int cMaxDepFileThreadCount = 8;
+		const int     dep_file_thread_count  = gMin(gThreadHardwareConcurrency(), cMaxDepFileThreadCount);
+
+		// Create temporary worker threads to read the dep files.
+		Thread dep_file_threads[cMaxDepFileThreadCount];
+		AtomicInt32 current_index = 0;
+		for (auto& thread : Span(dep_file_threads, dep_file_thread_count))
+		{
+			thread.Create({ .mName = "Dep File Read Thread", .mTempMemSize = 1_MiB }, [&](Thread&)
+			{
+				int index;
+				while ((index = current_index.Add(1)) < dep_files_to_read.Size())
+				{
+					const CookingCommand& command = GetCommand(dep_files_to_read[index]);
+					DepFileContent&       content = dep_files_content[index];
+
+					content.mSuccess = gReadDepFile(command.GetRule().mDepFileFormat, command.GetDepFile(), content.mInputs, content.mOutputs);
+				}
+			});
+		}
+
+		// Wait for the threads to finish their work.
+		for (auto& thread : dep_file_threads)
+			thread.Join();
+
+		gAppLog("Done. Read %d Dep Files in %.2f seconds.", dep_files_to_read.Size(), gTicksToSeconds(timer.GetTicks()));
+	}
+
 	LockGuard lock(mCommandsQueuedForUpdateDirtyStateMutex);
 
+	// Note: dep_files_to_read is sorted since it was filled in the same order.
+	int dep_file_index = 0;
 	for (CookingCommand& command : mCommands)
-		command.UpdateDirtyState();
+	{
+		DepFileContent* dep_file_content = nullptr;
+		if (dep_file_index < dep_files_to_read.Size() && dep_files_to_read[dep_file_index] == command.mID)
+			dep_file_content = &dep_files_content[dep_file_index++];
+
+		command.UpdateDirtyState(dep_file_content);
+	}
 
 	mCommandsQueuedForUpdateDirtyState.Clear();
 }
@@ -1460,26 +2812,205 @@ void CookingSystem::ForceCook(CookingCommandID inCommandID)
 	if (cooking_state == CookingState::Cooking || cooking_state == CookingState::Waiting)
 		return; // Already cooking, don't do anything.
 
+	// Someone is waiting for it, cook it in the interactive lane.
+	command.mIsInteractive = true;
+
 	// Remove it from the queue (if present) and add it at the front.
+	RemoveDebouncedCommand(inCommandID);
 	mCommandsToCook.Remove(inCommandID);
 	mCommandsToCook.Push(inCommandID, PushPosition::Front);
 }
 
 
+void CookingSystem::RequestOutputs(OutputRequest& ioRequest)
+{
+	gAssert(ioRequest.mState.Load() == OutputRequest::State::Pending);
+	ioRequest.mStartTicks = gGetTickCount();
+
+	{
+		LockGuard lock(mOutputRequestsMutex);
+		mOutputRequests.PushBack(&ioRequest);
+	}
+
+	// The monitor thread finds and queues the commands (it's the only one allowed to read the inputs/outputs lists).
+	gFileSystem.KickMonitorDirectoryThread();
+}
+
+
+void CookingSystem::CancelOutputRequest(OutputRequest& ioRequest)
+{
+	LockGuard lock(mOutputRequestsMutex);
+	(void)gSwapEraseFirstIf(mOutputRequests, [&ioRequest](OutputRequest* inRequest) { return inRequest == &ioRequest; });
+}
+
+
+// Add a command after all the commands producing its inputs (recursively).
+static void sAddUpstreamCommands(CookingCommandID inCommandID, TempHashSet<CookingCommandID>& ioVisited, TempVector<CookingCommandID>& ioCommands)
+{
+	if (ioVisited.Contains(inCommandID))
+		return;
+
+	ioVisited.Insert(inCommandID);
+
+	for (FileID input_id : gCookingSystem.GetCommand(inCommandID).GetAllInputs())
+		for (CookingCommandID producer_id : input_id.GetFile().mOutputOf)
+			sAddUpstreamCommands(producer_id, ioVisited, ioCommands);
+
+	ioCommands.PushBack(inCommandID);
+}
+
+
+void CookingSystem::StartOutputRequest(OutputRequest& ioRequest)
+{
+	TempHashSet<CookingCommandID> visited;
+	TempVector<CookingCommandID>  commands;
+
+	for (const String& path : ioRequest.mPaths)
+	{
+		FileID file_id = gFileSystem.FindFileIDByPath(path);
+		if (!file_id.IsValid() || file_id.GetFile().mOutputOf.Empty())
+		{
+			gAppLogError(R"(Requested output "%s" is not the output of any command.)", path.AsCStr());
+			ioRequest.mUnknownPaths.PushBack(path);
+			continue;
+		}
+
+		for (CookingCommandID command_id : file_id.GetFile().mOutputOf)
+			sAddUpstreamCommands(command_id, visited, commands);
+	}
+
+	ioRequest.mCommands.Resize(commands.Size());
+
+	// Move the dirty commands to the interactive lane.
+	// Commands are popped from the back of the queue, so push the downstream commands first to cook the upstream ones first.
+	for (int i = commands.Size() - 1; i >= 0; --i)
+	{
+		CookingCommand&                  command   = GetCommand(commands[i]);
+		OutputRequest::RequestedCommand& requested = ioRequest.mCommands[i];
+		CookingState                     cooking_state = command.GetCookingState();
+		bool                             is_cooking    = cooking_state == CookingState::Cooking || cooking_state == CookingState::Waiting;
+
+		requested.mCommandID      = command.mID;
+		requested.mLastCookingLog = is_cooking ? nullptr : command.mLastCookingLog;
+
+		// Even if it's up to date now, it might get dirty when the upstream commands cook.
+		command.mIsInteractive = true;
+
+		if (!command.IsDirty())
+			continue;
+
+		if (cooking_state == CookingState::Error && (command.mDirtyState & (CookingCommand::InputChanged | CookingCommand::VersionMismatch | CookingCommand::FingerprintMismatch)) == 0)
+			continue; // Don't cook again a command that errored if its inputs haven't changed since (same as QueueDirtyCommands).
+
+		requested.mQueued = true;
+
+		// If cooking is paused, they'll be queued in the interactive lane when unpausing.
+		if (is_cooking || IsCookingPaused())
+			continue;
+
+		RemoveDebouncedCommand(command.mID);
+		mCommandsToCook.Remove(command.mID);
+		mCommandsToCook.Push(command.mID);
+	}
+}
+
+
+bool CookingSystem::IsOutputRequestDone(OutputRequest& ioRequest) const
+{
+	int error_count = 0;
+
+	for (const OutputRequest::RequestedCommand& requested : ioRequest.mCommands)
+	{
+		const CookingCommand& command       = mCommands[requested.mCommandID.mIndex];
+		CookingState          cooking_state = command.GetCookingState();
+
+		if (cooking_state == CookingState::Cooking || cooking_state == CookingState::Waiting)
+			return false;
+
+		if (!command.IsDirty())
+			continue;
+
+		// Only count errors from cooks that happened after the request started (unless the command wasn't queued at all).
+		bool is_error = cooking_state == CookingState::Error && (!requested.mQueued || command.mLastCookingLog != requested.mLastCookingLog);
+		if (!is_error)
+			return false;
+
+		error_count++;
+	}
+
+	ioRequest.mErrorCount = error_count;
+	return true;
+}
+
+
+void CookingSystem::ProcessOutputRequests()
+{
+	LockGuard lock(mOutputRequestsMutex);
+
+	for (int i = 0; i < mOutputRequests.Size();)
+	{
+		OutputRequest& request = *mOutputRequests[i];
+
+		if (request.mState.Load() == OutputRequest::State::Pending)
+		{
+			StartOutputRequest(request);
+			request.mState.Store(OutputRequest::State::Cooking);
+		}
+
+		if (!IsOutputRequestDone(request))
+		{
+			++i;
+			continue;
+		}
+
+		gAppLog("Requested outputs ready in %.2f seconds (%d Commands, %d Errors).", 
+			gTicksToSeconds(gGetTickCount() - request.mStartTicks), request.mCommands.Size(), request.mErrorCount);
+
+		// Remove it before signaling, the owner is allowed to destroy it as soon as it's signaled.
+		mOutputRequests.Erase(i);
+		request.mState.Store(OutputRequest::State::Done);
+		request.mDoneSignal.Set();
+	}
+}
+
+
 void CookingSystem::CookingThreadFunction(CookingThread& ioThread)
 {
 	while (true)
 	{
-		CookingCommandID command_id = mCommandsToCook.Pop();
+		CookingLane      lane       = CookingLane::Background;
+		CookingCommandID command_id = mCommandsToCook.Pop(ioThread.mInteractiveOnly, lane, ioThread.mBatch);
 
 		if (ioThread.mThread.IsStopRequested())
+		{
+			StopWorkers(ioThread);
 			return;
+		}
+
+		// Commands of rules using batching are cooked together by a single process.
+		if (command_id.IsValid() && !ioThread.mBatch.Empty())
+		{
+			ioThread.mBatch.Insert(0, command_id);
+
+			CookBatch(ioThread.mBatch, lane, ioThread);
 
-		if (command_id.IsValid())
+			// The process is done, let other commands use its resources.
+			mCommandsToCook.FinishedRunning(GetCommand(command_id).GetRule());
+
+			for (CookingCommandID batch_command_id : ioThread.mBatch)
+				ProcessCookResult(*GetCommand(batch_command_id).mLastCookingLog);
+
+			// Remove the current log entry for the cooking thread.
+			ioThread.mCurrentLogEntry.Store(CookingLogEntryID::cInvalid());
+		}
+		else if (command_id.IsValid())
 		{
 			CookingCommand&	 command   = GetCommand(command_id);
 			CookingLogEntry& log_entry = AllocateCookingLogEntry(command_id);
 
+			// Remember the lane, FinishedCooking needs it.
+			log_entry.mLane = lane;
+
 			// Set the log entry on the command.
 			command.mLastCookingLog = &log_entry;
 
@@ -1491,19 +3022,10 @@ void CookingSystem::CookingThreadFunction(CookingThread& ioThread)
 			else
 				CookCommand(command, ioThread);
 
-			if (log_entry.mCookingState.Load() == CookingState::Error)
-			{
-				// Update the total count of errors.
-				mCookingErrors.Add(1);
-
-				// Notify the system that this command has officially finished cooking.
-				mCommandsToCook.FinishedCooking(log_entry);
+			// The process is done, let other commands use its resources.
+			mCommandsToCook.FinishedRunning(command.GetRule());
 
-				// If the command ends in error, we need to make sure that its dirty state is updated.
-				// That normally happens when the outputs (and the dep file) are written, but that might not happen at all if there is an error.
-				// This is important to then properly detect when the inputs change again and the command can re-cook.
-				QueueUpdateDirtyState(command_id);
-			}
+			ProcessCookResult(log_entry);
 
 			// Remove the current log entry for the cooking thread.
 			ioThread.mCurrentLogEntry.Store(CookingLogEntryID::cInvalid());
@@ -1512,6 +3034,47 @@ void CookingSystem::CookingThreadFunction(CookingThread& ioThread)
 }
 
 
+void CookingSystem::ProcessCookResult(CookingLogEntry& ioLogEntry)
+{
+	// Add the resources used to the totals of the rule.
+	{
+		const CookingRule& rule = GetCommand(ioLogEntry.mCommandID).GetRule();
+
+		LockGuard lock(mRuleResourceUsageMutex);
+
+		if (rule.mID.mIndex >= mRuleResourceUsage.Size())
+			mRuleResourceUsage.Resize(rule.mID.mIndex + 1);
+
+		RuleResourceUsage& rule_usage = mRuleResourceUsage[rule.mID.mIndex];
+		rule_usage.mCookCount++;
+		rule_usage.mWallTime += (uint64)gMax(ioLogEntry.mTimeEnd - ioLogEntry.mTimeStart, (int64)0) / 100; // Nanoseconds to 100ns units.
+		rule_usage.mTotal.Add(ioLogEntry.mResourceUsage);
+	}
+
+	if (ioLogEntry.mCookingState.Load() == CookingState::Error)
+	{
+		// Update the total count of errors.
+		mCookingErrors.Add(1);
+
+		// Notify the system that this command has officially finished cooking.
+		mCommandsToCook.FinishedCooking(ioLogEntry);
+
+		// If the command ends in error, we need to make sure that its dirty state is updated.
+		// That normally happens when the outputs (and the dep file) are written, but that might not happen at all if there is an error.
+		// This is important to then properly detect when the inputs change again and the command can re-cook.
+		QueueUpdateDirtyState(ioLogEntry.mCommandID);
+	}
+	else if (ioLogEntry.mCookingState.Load() == CookingState::Canceled)
+	{
+		// Notify the system that this command has finished cooking.
+		mCommandsToCook.FinishedCooking(ioLogEntry);
+
+		// Updating the dirty state will queue it again.
+		QueueUpdateDirtyState(ioLogEntry.mCommandID);
+	}
+}
+
+
 CookingLogEntry& CookingSystem::AllocateCookingLogEntry(CookingCommandID inCommandID)
 {
 	auto             lock      = mCookingLog.Lock();
@@ -1528,6 +3091,28 @@ CookingLogEntry& CookingSystem::AllocateCookingLogEntry(CookingCommandID inComma
 }
 
 
+RuleResourceUsage CookingSystem::GetRuleResourceUsage(CookingRuleID inRuleID) const
+{
+	LockGuard lock(mRuleResourceUsageMutex);
+
+	if (inRuleID.mIndex >= mRuleResourceUsage.Size())
+		return {};
+
+	return mRuleResourceUsage[inRuleID.mIndex];
+}
+
+
+void CookingSystem::SetRuleResourceUsage(CookingRuleID inRuleID, const RuleResourceUsage& inUsage)
+{
+	LockGuard lock(mRuleResourceUsageMutex);
+
+	if (inRuleID.mIndex >= mRuleResourceUsage.Size())
+		mRuleResourceUsage.Resize(inRuleID.mIndex + 1);
+
+	mRuleResourceUsage[inRuleID.mIndex] = inUsage;
+}
+
+
 bool CookingSystem::IsIdle() const
 {
 	// If there are things to cook, we're not idle.
@@ -1540,14 +3125,8 @@ bool CookingSystem::IsIdle() const
 			return false;
 
 	// If any command is still waiting for its final status, we're not idle.
-	{
-		LockGuard lock(mTimeOutMutex);
-
-		if (!mTimeOutCurrentBatch.Empty())
-				return false;
-		if (!mTimeOutNextBatch.Empty())
-				return false;
-	}
+	if (gFileSystem.GetTimerCount(MonitorTimer::Type::OutputTimeOut) > 0)
+		return false;
 
 	// If any command needs a dirty state update, we're not idle.
 	{
@@ -1556,6 +3135,13 @@ bool CookingSystem::IsIdle() const
 			return false;
 	}
 
+	// If any command is waiting for its inputs to settle, we're not idle.
+	{
+		LockGuard lock(mDebouncedCommandsMutex);
+		if (!mDebouncedCommands.Empty())
+			return false;
+	}
+
 	// If we're still initializing, we're not idle.
 	if (gFileSystem.GetInitState() != FileSystem::InitState::Ready)
 		return false;
@@ -9,6 +9,13 @@
 #include "Strings.h"
 #include "FileSystem.h"
 #include "CookingSystemIDs.h"
+#include "SyncSignal.h"
+#include "CookOutput.h"
+#include "CookingLog.h"
+#include "RuleMatchIndex.h"
+#include "PathPattern.h"
+#include "CommandVariables.h"
+#include "FileSetPool.h"
 
 #include <Bedrock/String.h>
 #include <Bedrock/Thread.h>
@@ -18,12 +25,15 @@
 #include <Bedrock/Atomic.h>
 #include <Bedrock/HashMap.h>
 
+struct DepFileContent;
+struct CommandStaging;
 
 
 struct InputFilter
 {
-	uint32     mRepoIndex = FileID::cInvalid().mRepoIndex;
-	StringView mPathPattern;
+	uint32      mRepoIndex = FileID::cInvalid().mRepoIndex;
+	StringView  mPathPattern;
+	PathPattern mCompiledPathPattern; // Compiled version of mPathPattern, to match paths without allocating.
 
 	bool       Pass(const FileInfo& inFile) const;
 };
@@ -33,6 +43,7 @@ enum class DepFileFormat : uint8
 {
 	AssetCooker, // Custom Asset Cooker dep file format.
 	Make,        // For dep files generated with -M from Clang/GCC/DXC.
+	AssetCookerBinary, // Binary format for tools that use AssetCookerDepFile.h.
 	_Count,
 };
 
@@ -43,6 +54,7 @@ constexpr StringView gToStringView(DepFileFormat inVar)
 	{
 		"AssetCooker",
 		"Make",
+		"AssetCookerBinary",
 	};
 	static_assert(gElemCount(cStrings) == (size_t)DepFileFormat::_Count);
 
@@ -50,10 +62,32 @@ constexpr StringView gToStringView(DepFileFormat inVar)
 };
 
 
+enum class DepFileScanner : uint8
+{
+	None,    // The dep file is written by the command (or by the DepFileCommandLine).
+	Include, // Built-in scanner following the #include directives of the main input, see DepFileScanner.h.
+	_Count,
+};
+
+
+constexpr StringView gToStringView(DepFileScanner inVar)
+{
+	constexpr StringView cStrings[]
+	{
+		"None",
+		"Include",
+	};
+	static_assert(gElemCount(cStrings) == (size_t)DepFileScanner::_Count);
+
+	return cStrings[(int)inVar];
+};
+
+
 enum class CommandType : uint8
 {
 	CommandLine,
 	CopyFile,
+	Worker,		// Jobs are sent to a long-lived process started with CookingRule::mWorkerCommandLine (see Readme).
 	_Count
 };
 
@@ -64,6 +98,7 @@ constexpr StringView gToStringView(CommandType inVar)
 	{
 		"CommandLine",
 		"CopyFile",
+		"Worker",
 	};
 	static_assert(gElemCount(cStrings) == (size_t)CommandType::_Count);
 
@@ -83,17 +118,41 @@ struct CookingRule : NoCopy
 	uint16                   mVersion             = 0;
 	CommandType              mCommandType         = CommandType::CommandLine;
 	bool                     mMatchMoreRules      = false; // If false, we'll stop matching rules once an input file is matched with this rule. If true, we'll keep looking.
+	bool                     mCancelOnInputChange = false; // If true, commands are canceled (and cooked again) when one of their inputs changes while they're cooking.
+	float                    mCancelMinRuntime    = 0.f;   // Only cancel commands that have been cooking for at least this many seconds.
+	float                    mDebounceTime        = 0.f;   // Number of seconds inputs need to stay unchanged before cooking. Avoids cooking several times when a file is saved in multiple steps.
+	int                      mBatchSize           = 0;     // If greater than 1, up to this many commands are cooked by a single run of mBatchCommandLine.
+	int                      mMaxConcurrent       = 0;     // Maximum number of commands (or batches) of this rule cooking at the same time. Zero means no limit.
+	int                      mThreadWeight        = 1;     // Number of cooking threads a command uses (eg. for tools that are internally multi-threaded).
+	float                    mMemoryWeight        = 0.f;   // Memory (in GiB) a command uses. Commands only start if they fit in the cooking memory budget.
+	float                    mWorkerTimeout       = 0.f;   // If a worker takes more than this many seconds for a job, it is killed (and restarted for the next job). Zero means no timeout.
 	DepFileFormat            mDepFileFormat       = DepFileFormat::AssetCooker;
+	DepFileScanner           mDepFileScanner      = DepFileScanner::None; // If set, the dep file is written by a built-in scanner instead of a process.
 	StringView               mDepFilePath;        // Optional file containing extra inputs/ouputs for the command.
 	StringView               mDepFileCommandLine; // Optional separate command line used to generate the dep file (in case the main command cannot generate it directly).
-	StringView               mCommandLine;
+	StringView               mCommandLine;        // If batching, this is the line written to the response file for each command. If using a worker, this is sent with each job.
+	StringView               mBatchCommandLine;   // Command line run for a batch of commands. The path of the response file is added at the end.
+	StringView               mWorkerCommandLine;  // Command line starting the worker process (if CommandType is Worker).
 	Vector<InputFilter>      mInputFilters;
 	Vector<StringView>       mInputPaths;
 	Vector<StringView>       mOutputPaths;
+	Vector<StringView>       mDepFileIncludePaths; // Directories searched by the Include dep file scanner (after the directory of the including file for "" includes).
+
+	// Compiled versions of the format strings above (see CookingSystem::ValidateRules), to not parse them every time a command is created or cooked.
+	CommandTemplate          mCommandLineTemplate;
+	CommandTemplate          mBatchCommandLineTemplate;
+	CommandTemplate          mWorkerCommandLineTemplate;
+	CommandTemplate          mDepFileCommandLineTemplate;
+	CommandTemplate          mDepFilePathTemplate;
+	Vector<CommandTemplate>  mInputPathTemplates;
+	Vector<CommandTemplate>  mOutputPathTemplates;
+	Vector<CommandTemplate>  mDepFileIncludePathTemplates;
 
 	mutable AtomicInt32      mCommandCount = 0;
 
 	bool                     UseDepFile() const { return !mDepFilePath.Empty(); }
+	bool                     UseBatching() const { return mBatchSize > 1; }
+	int64                    GetMemoryWeightMiB() const { return (int64)(mMemoryWeight * 1024.f); }
 };
 
 
@@ -104,6 +163,7 @@ enum class CookingState : uint8
 	Waiting,	// After cooking, we need to wait a little to get the USN events and see if all outputs were written (otherwise it's an Error instead of Success).
 	Error,		// TODO: maybe we need a second error value for the kind that will never go away (ie. generating command line fails)
 	Success,
+	Canceled,	// An input changed while cooking, the processes were killed and the command will cook again.
 	_Count,
 };
 
@@ -117,6 +177,7 @@ constexpr StringView gToStringView(CookingState inVar)
 		"Waiting",
 		"Error",
 		"Success",
+		"Canceled",
 	};
 	static_assert(gElemCount(cNames) == (int)CookingState::_Count);
 
@@ -124,16 +185,50 @@ constexpr StringView gToStringView(CookingState inVar)
 };
 
 
+// Cooking threads serve the interactive lane first.
+enum class CookingLane : uint8
+{
+	Background,		// Commands dirty since startup (or made dirty by a background command).
+	Interactive,	// Commands dirtied by someone editing files while AssetCooker is running.
+};
+
+
+// Resources used by the processes of a cook (from the accounting of their job object).
+struct CookingResourceUsage
+{
+	uint64                    mUserTime   = 0; // CPU time, in 100ns units.
+	uint64                    mKernelTime = 0; // CPU time, in 100ns units.
+	uint64                    mPeakMemory = 0; // Peak committed memory of all the processes, in bytes.
+	uint64                    mReadBytes  = 0;
+	uint64                    mWriteBytes = 0;
+
+	void                      Add(const CookingResourceUsage& inOther); // Sum everything except mPeakMemory (max).
+	TempString                ToString() const;
+};
+
+
+// Resources used by all the cooks of a rule. Stored in the cache.
+struct RuleResourceUsage
+{
+	uint64                    mCookCount = 0;
+	uint64                    mWallTime  = 0; // Total duration of the cooks, in 100ns units.
+	CookingResourceUsage      mTotal;         // mPeakMemory is the max of all cooks.
+};
+static_assert(sizeof(RuleResourceUsage) == 56);
+
+
 struct CookingLogEntry
 {
 	CookingLogEntryID         mID;
 	CookingCommandID          mCommandID;
 	Atomic<CookingState>      mCookingState = CookingState::Unknown;
 	bool                      mIsCleanup    = false;
+	CookingLane               mLane         = CookingLane::Background; // Lane the command was popped from.
 	FileTime                  mTimeStart;
 	FileTime                  mTimeEnd;		// Unsafe to read unless CookingState is > Cooking. TODO add getters that assert this
-	StringView                mOutput;		// Unsafe to read unless CookingState is > Cooking.
-	Vector<FormatSpan>        mOutputFormatSpans; // Unsafe to read unless CookingState is > Cooking.
+	CookingLogOutput          mOutput;		// Only the head, tail and error lines if the output was too large. Use CookingSystem::ReadLogEntryOutput to read it.
+	CookOutputRef             mFullOutput;	// Unsafe to read unless CookingState is > Cooking. Only valid if mOutput was shrunk.
+	CookingResourceUsage      mResourceUsage;     // Unsafe to read unless CookingState is > Cooking.
 };
 
 
@@ -144,45 +239,52 @@ struct CookingCommand : NoCopy
 	CookingRuleID       mRuleID;
 	Vector<FileID>      mInputs;         // Static inputs.
 	Vector<FileID>      mOutputs;        // Static outputs.
-	Vector<FileID>      mDepFileInputs;  // Dynamic inputs specified by the dep file.
-	Vector<FileID>      mDepFileOutputs; // Dynamic outputs specified by the dep file.
+	FileSetID           mDepFileInputs;  // Dynamic inputs specified by the dep file. Shared with the commands that have the same ones, see GetDepFileInputs().
+	FileSetID           mDepFileOutputs; // Dynamic outputs specified by the dep file.
 
-	enum DirtyState : uint8
+	enum DirtyState : uint16
 	{
 		NotDirty               = 0,
-		InputMissing           = 0b00000001, // Inputs can be missing because they'll be created by an earlier command. If they're still missing by the time we try to cook, it's an error.
-		InputChanged           = 0b00000010,
-		OutputMissing          = 0b00000100, // Output file does not exist.
-		OutputOutdated         = 0b00001000, // Output file exists but was not written.
-		AllStaticInputsMissing = 0b00010000, // Command needs to be cleaned up.
-		AllOutputsMissing      = 0b00100000,
-		Error                  = 0b01000000, // Last cook errored.
-		VersionMismatch        = 0b10000000, // Rule version changed.
+		InputMissing           = 0b000000001, // Inputs can be missing because they'll be created by an earlier command. If they're still missing by the time we try to cook, it's an error.
+		InputChanged           = 0b000000010,
+		OutputMissing          = 0b000000100, // Output file does not exist.
+		OutputOutdated         = 0b000001000, // Output file exists but was not written.
+		AllStaticInputsMissing = 0b000010000, // Command needs to be cleaned up.
+		AllOutputsMissing      = 0b000100000,
+		Error                  = 0b001000000, // Last cook errored.
+		VersionMismatch        = 0b010000000, // Rule version changed.
+		FingerprintMismatch    = 0b100000000, // Rule changed in a way that changes this command (eg. different command line or outputs).
 	};
 
 	DirtyState                      mDirtyState          = NotDirty;
 	bool                            mIsQueued            = false;
+	bool                            mIsInteractive       = false;	// Dirtied by a file change after init (or force cooked), cooks in the interactive lane.
 	uint16                          mLastCookRuleVersion = CookingRule::cInvalidVersion;
+	uint64                          mFingerprint         = 0;		// Hash of the formatted command lines and paths of this command.
+	uint64                          mLastCookFingerprint = 0;		// Value of mFingerprint the last time this command was cooked.
 	USN                             mLastDepFileRead     = 0;
 	USN                             mLastCookUSN         = 0;		// Value that represents the last time this command was cooked. All outputs USN have to be greater than this for the command to be NotDirty.
 	FileTime                        mLastCookTime        = {};
 	CookingLogEntry*                mLastCookingLog      = nullptr;
 
-	void                            UpdateDirtyState();
+	void                            UpdateDirtyState(DepFileContent* ioPrefetchedDepFile = nullptr); // Pass the dep file content if it was already read.
 	bool                            IsDirty() const { return mDirtyState != NotDirty && !IsCleanedUp(); }
 	bool                            NeedsCleanup() const { return (mDirtyState & AllStaticInputsMissing) && !IsCleanedUp(); }
 	bool                            IsCleanedUp() const { return (mDirtyState & (AllStaticInputsMissing | AllOutputsMissing)) == (AllStaticInputsMissing | AllOutputsMissing); }
 
 	CookingState                    GetCookingState() const { return mLastCookingLog ? mLastCookingLog->mCookingState.Load() : CookingState::Unknown; }
 
-	bool                            ReadDepFile();
+	bool                            NeedsToReadDepFile() const;
+	bool                            ReadDepFile(DepFileContent* ioPrefetchedDepFile = nullptr);
 
 	FileID                          GetMainInput() const { return mInputs[0]; }
 	FileID                          GetDepFile() const;
 	const CookingRule&              GetRule() const;
 
-	MultiSpanRange<const FileID, 2> GetAllInputs() const { return { mInputs, mDepFileInputs }; }
-	MultiSpanRange<const FileID, 2> GetAllOutputs() const { return { mOutputs, mDepFileOutputs }; }
+	Span<const FileID>              GetDepFileInputs() const;
+	Span<const FileID>              GetDepFileOutputs() const;
+	MultiSpanRange<const FileID, 2> GetAllInputs() const { return { mInputs, GetDepFileInputs() }; }
+	MultiSpanRange<const FileID, 2> GetAllOutputs() const { return { mOutputs, GetDepFileOutputs() }; }
 };
 
 constexpr CookingCommand::DirtyState& operator|=(CookingCommand::DirtyState& ioA, CookingCommand::DirtyState inB) { return ioA = (CookingCommand::DirtyState)(ioA | inB); }
@@ -215,8 +317,6 @@ struct CookingQueue : NoCopy
 	int              GetSize() const;
 	bool             IsEmpty() const { return GetSize() == 0; }
 
-	void             PushInternal(MutexLockGuard& ioLock, int inPriority, CookingCommandID inCommandID, PushPosition inPosition);
-
 	struct PrioBucket
 	{
 		int                           mPriority = 0;
@@ -227,17 +327,30 @@ struct CookingQueue : NoCopy
 		auto                          operator<=>(const PrioBucket& inOther) const { return mPriority <=> inOther.mPriority; }
 	};
 
+	void             PushInternal(MutexLockGuard& ioLock, Vector<PrioBucket>& ioBuckets, int inPriority, CookingCommandID inCommandID, PushPosition inPosition);
+	bool             RemoveInternal(MutexLockGuard& ioLock, Vector<PrioBucket>& ioBuckets, int inPriority, CookingCommandID inCommandID, RemoveOption inOption); // Return true if removed.
+
 	Vector<PrioBucket> mPrioBuckets;
 	int                mTotalSize = 0;
 	mutable Mutex      mMutex;
 };
 
 
+// Queue with two lanes: the interactive lane is always popped first, and some threads can be reserved for it.
+// The lane is chosen on push from CookingCommand::mIsInteractive.
 struct CookingThreadsQueue : CookingQueue
 {
 	void                    Push(CookingCommandID inCommandID, PushPosition inPosition = PushPosition::Back);
-	CookingCommandID        Pop();
+	CookingCommandID        Pop(bool inInteractiveOnly, CookingLane& outLane, Vector<CookingCommandID>& outBatch); // outBatch gets the other commands to cook in the same process (see CookingRule::mBatchSize).
+	bool                    Remove(CookingCommandID inCommandID, RemoveOption inOption = RemoveOption::None);	// Return true if removed (from either lane).
+	void                    Clear();
+	bool                    MoveToInteractiveLane(CookingCommandID inCommandID); // Return true if the command was in the background lane.
 	void                    FinishedCooking(const CookingLogEntry& inLogEntry);
+	void                    FinishedRunning(const CookingRule& inRule); // Release the resources taken by Pop, once the command (or batch) isn't running anymore.
+	void                    SetResourceBudget(int inMaxThreadTokens, int inReservedInteractiveTokens, int64 inMemoryBudgetMiB);
+	void                    SetThreadTokens(int inThreadTokens); // Change the number of active cooking threads. Can be called while cooking.
+	int                     GetThreadTokens() const;
+	int                     GetThreadTokensUsed() const;
 
 	void                    RequestStop();
 
@@ -250,9 +363,56 @@ struct CookingThreadsQueue : CookingQueue
 		auto operator==(int inOrder) const { return mPriority == inOrder; }
 		auto operator<=>(const PrioBucket& inOther) const { return mPriority <=> inOther.mPriority; }
 	};
-	Vector<PrioData>        mPrioData;
-	ConditionVariable		mBarrier;
+
+	CookingCommandID        PopInternal(MutexLockGuard& ioLock, CookingLane inLane, Vector<PrioBucket>& ioBuckets, Vector<PrioData>& ioPrioData, Vector<CookingCommandID>& outBatch);
+	void                    NotifyPush(CookingLane inLane);
+	bool                    CanStartRunning(MutexLockGuard& ioLock, CookingLane inLane, const CookingRule& inRule);
+	void                    StartRunning(MutexLockGuard& ioLock, const CookingRule& inRule);
+	int                     GetThreadWeight(const CookingRule& inRule) const { return gClamp(inRule.mThreadWeight, 1, mMaxThreadTokens); } // Can't be more than the number of threads, or it would never run.
+
+	Vector<PrioData>        mPrioData;						// Background lane (buckets are in CookingQueue::mPrioBuckets).
+	Vector<PrioBucket>      mInteractivePrioBuckets;
+	Vector<PrioData>        mInteractivePrioData;
+	ConditionVariable		mBarrier;						// Signaled for the threads cooking any lane.
+	ConditionVariable		mInteractiveBarrier;			// Signaled for the threads reserved for the interactive lane.
 	bool                    mStopRequested = false;
+
+	// Resources used by the running commands. Commands only start if there are enough left (see CookingRule::mThreadWeight, mMemoryWeight and mMaxConcurrent).
+	int                     mThreadTokens        = 1;		// One per active cooking thread.
+	int                     mMaxThreadTokens     = 1;		// One per cooking thread (active or not).
+	int                     mReservedInteractiveTokens = 0;	// Tokens the background lane can't use, to keep threads for the interactive lane.
+	int                     mThreadTokensUsed    = 0;
+	int64                   mMemoryBudgetMiB     = 0;		// Zero means no limit.
+	int64                   mMemoryUsedMiB       = 0;
+	Vector<int>             mRunningCountPerRule;			// Indexed by rule.
+	bool                    mHasBlockedCommands  = false;	// Some commands couldn't start because of their resources, threads need to be woken up when resources are released.
+};
+
+
+// Request to cook the commands producing some outputs before anything else (eg. the files a game is about to load).
+struct OutputRequest : NoCopy
+{
+	enum class State : uint8
+	{
+		Pending,	// Not processed yet.
+		Cooking,	// Commands are found and queued.
+		Done,		// All commands are up to date or in error. mDoneSignal is set.
+	};
+
+	struct RequestedCommand
+	{
+		CookingCommandID mCommandID;
+		CookingLogEntry* mLastCookingLog = nullptr; // Last finished cook when the request started, to tell errors from previous cooks apart.
+		bool             mQueued         = false;   // False if the command wasn't queued because it would fail again (error and inputs didn't change).
+	};
+
+	Vector<String>           mPaths;                // Absolute paths of the requested outputs.
+	Vector<RequestedCommand> mCommands;             // Commands producing these outputs and all their inputs, upstream commands first.
+	Vector<String>           mUnknownPaths;         // Requested paths that aren't the output of any command.
+	int                      mErrorCount = 0;       // Number of commands in error. Only valid once Done.
+	int64                    mStartTicks = 0;
+	Atomic<State>            mState      = State::Pending;
+	SyncSignal               mDoneSignal;
 };
 
 
@@ -264,23 +424,39 @@ struct CookingSystem : NoCopy
 	const CookingRule&                    GetRule(CookingRuleID inID) const { return mRules[inID.mIndex]; }
 	CookingCommand&                       GetCommand(CookingCommandID inID) { return mCommands[inID.mIndex]; }
 	CookingLogEntry&                      GetLogEntry(CookingLogEntryID inID) { return mCookingLog[inID.mIndex]; }
+	void                                  SetLogEntryOutput(CookingLogEntry& ioEntry, StringView inOutput) { mCookingLogStorage.SetOutput(ioEntry, inOutput); } // Entry must not be finished cooking yet.
+	bool                                  ReadLogEntryOutput(const CookingLogEntry& inEntry, String& outOutput) { return mCookingLogStorage.ReadOutput(inEntry, outOutput); } // Entry must be finished cooking.
+	void                                  TimeOutLogEntry(CookingLogEntryID inID); // If this entry is still waiting for its outputs, set it to Error. Called by the monitor thread when its time out expires.
+	void                                  UpdateCookingLogStorage() { mCookingLogStorage.Update(mCookingLog); } // Compress/archive the outputs of old log entries. Called by the monitor thread.
+	CookingLogStorage::Stats              GetCookingLogStats() { return mCookingLogStorage.GetStats(); }
 
 	CookingRule&                          AddRule() { return mRules.Emplace({}, CookingRuleID{ (int16)mRules.Size() }); }
 	StringPool&                           GetStringPool() { return mStringPool; }
 	void                                  CreateCommandsForFile(FileInfo& ioFile);
+	void                                  CreateCommandsForAllFiles(); // Same as above for all the files (and the files their commands add), in parallel. Only used during init.
 
 	const CookingRule*                    FindRule(StringView inRuleName) const;
 	CookingCommand*                       FindCommandByMainInput(CookingRuleID inRule, FileID inFileID);
 	Span<const CookingRule>               GetRules() const { return { mRules }; }
 	Span<const CookingCommand>            GetCommands() const { return { mCommands }; }
 
-	bool                                  ValidateRules(); // Return false if problems were found (see log).
+	bool                                  ValidateRules(); // Return false if problems were found (see log). Also compiles the command templates of the rules.
+	void                                  BuildRuleMatchIndex() { mRuleMatchIndex.Build(GetRules()); } // Needs to be called once all the rules are added, before creating commands.
 	void                                  StartCooking();
 	void                                  StopCooking();
 	void                                  SetCookingPaused(bool inPaused);
 	bool                                  IsCookingPaused() const { return mCookingPaused; }
-	void                                  SetCookingThreadCount(int inThreadCount) { mWantedCookingThreadCount = inThreadCount; }
+	void                                  SetCookingThreadCount(int inThreadCount); // Takes effect immediately if cooking is started.
 	int                                   GetCookingThreadCount() const { return mWantedCookingThreadCount; }
+	int                                   GetActiveCookingThreadCount() const { return mCommandsToCook.GetThreadTokens(); }
+	int                                   GetMaxCookingThreadCount() const { return mCookingThreads.Size(); }
+	void                                  SetAdaptiveCookingThreads(bool inEnabled) { mAdaptiveCookingThreads = inEnabled; }
+	bool                                  IsAdaptiveCookingThreads() const { return mAdaptiveCookingThreads; }
+	void                                  UpdateAdaptiveCookingThreads(); // Adjust the number of active cooking threads to the load. Called by the monitor thread.
+	void                                  SetInteractiveCookingThreadCount(int inThreadCount) { mWantedInteractiveCookingThreadCount = inThreadCount; }
+	int                                   GetInteractiveCookingThreadCount() const { return mWantedInteractiveCookingThreadCount; }
+	void                                  SetCookingMemoryBudget(float inBudgetGiB) { mWantedCookingMemoryBudget = inBudgetGiB; }
+	float                                 GetCookingMemoryBudget() const { return mWantedCookingMemoryBudget; }
 	int									  GetCookingErrorCount() const { return mCookingErrors.Load(); }
 
 	int                                   GetCommandCount() const { return mCommands.Size(); } // Total number of commands, for debug/display.
@@ -290,14 +466,26 @@ struct CookingSystem : NoCopy
 	void                                  QueueUpdateDirtyStates(FileID inFileID);
 	void                                  QueueUpdateDirtyState(CookingCommandID inCommandID);
 	bool                                  ProcessUpdateDirtyStates(); // Return true if there are still commands to update.
+	bool                                  ProcessVerifiedOutputs(); // Apply the output USNs read by the cooking threads. Return true if there were any.
 	void                                  UpdateAllDirtyStates(); // Update the dirty state of all commands. Only needed during init.
 	void                                  UpdateNotifications();
+	int64                                 ProcessDebouncedCommands(); // Queue the commands whose inputs have settled. Return the ticks when the next one will be ready, or 0 if there are none left.
+	int                                   GetCooksAvoidedByDebounce() const { return mCooksAvoidedByDebounce.Load(); }
 
 	void                                  ForceCook(CookingCommandID inCommandID);
+	void                                  RequestOutputs(OutputRequest& ioRequest);       // Cook the commands needed for these outputs first. ioRequest must stay alive until it's Done or canceled.
+	void                                  CancelOutputRequest(OutputRequest& ioRequest);  // Forget about a request that isn't Done yet.
+	void                                  ProcessOutputRequests();                        // Queue the new requests and signal the finished ones. Called by the monitor thread.
 	bool                                  IsIdle() const; // Return true if nothing is happening. Used by the UI to decide if it needs to draw.
 
 	CookingLogEntry&                      AllocateCookingLogEntry(CookingCommandID inCommandID);
 
+	RuleResourceUsage                     GetRuleResourceUsage(CookingRuleID inRuleID) const;
+	void                                  SetRuleResourceUsage(CookingRuleID inRuleID, const RuleResourceUsage& inUsage); // Used when loading the cache.
+
+	FileSetPool&                          GetDepFileSets() { return mDepFileSets; } // Only modified when applying dep files (on the monitor thread, or while loading the cache).
+	const FileSetPool&                    GetDepFileSets() const { return mDepFileSets; }
+
 	bool                                  mSlowMode = false; // Slows down cooking, for debugging.
 private:
 	friend struct CookingCommand;
@@ -309,49 +497,109 @@ private:
 
 	void                                  CookingThreadFunction(CookingThread& ioThread);
 	void                                  CookCommand(CookingCommand& ioCommand, CookingThread& ioThread);
+	void                                  CookBatch(Span<const CookingCommandID> inCommandIDs, CookingLane inLane, CookingThread& ioThread); // Cook several commands of the same rule with a single process.
+	bool                                  RunWorkerJob(CookingCommand& ioCommand, StringView inCommandLine, CookingThread& ioThread, StringPool::ResizableStringView& ioOutput); // Send the command to the worker of its rule (starting it if needed) and wait for the result.
+	void                                  StopWorkers(CookingThread& ioThread);
+	bool                                  PrepareCook(CookingCommand& ioCommand, StringPool::ResizableStringView& ioOutput); // Update the last cook info, check the inputs and create the output directories. Return false on error.
+	void                                  ProcessCookResult(CookingLogEntry& ioLogEntry); // Add the resources used to the rule totals, and handle commands that finished in Error or Canceled state.
 	void                                  CleanupCommand(CookingCommand& ioCommand, CookingThread& ioThread); // Delete all outputs.
-	void                                  AddTimeOut(CookingLogEntry* inLogEntry);
-	void                                  TimeOutUpdateThread();
+	void                                  CancelCooking(CookingCommandID inCommandID); // Kill the processes of this command if it is cooking.
+	void                                  VerifyOutputs(const CookingCommand& inCommand); // Read the USN of the outputs directly instead of waiting for the USN journal to confirm they were written.
+	void                                  StageCommandsForFile(const FileInfo& inFile, CommandStaging& ioStaging) const; // Find the commands of this file without adding them. Thread safe.
+	void                                  AddStagedCommands(const CommandStaging& inStaging);
+	void                                  AddTimeOut(CookingLogEntry* inLogEntry); // Declare the command in error if its outputs aren't all written soon.
 	void                                  QueueDirtyCommands();
 	void                                  QueueErroredCommands();
+	void                                  QueueCommandToCook(const CookingCommand& inCommand); // Push to the cooking queue, or wait for the inputs to settle if the rule uses a debounce time.
+	bool                                  ExtendDebounce(const CookingCommand& inCommand);     // If this command is waiting for its inputs to settle and they changed again, wait longer. Return false if it isn't waiting.
+	void                                  RemoveDebouncedCommand(CookingCommandID inCommandID);
+	void                                  StartOutputRequest(OutputRequest& ioRequest);
+	bool                                  IsOutputRequestDone(OutputRequest& ioRequest) const;
 
 	VMemArray<CookingRule>                mRules      = { 1024ull * 1024, 4096 };
+	RuleMatchIndex                        mRuleMatchIndex;
+	FileSetPool                           mDepFileSets; // Dep file inputs/outputs of all the commands.
 	StringPool                            mStringPool = { 64ull * 1024 };
 	VMemArray<CookingCommand>             mCommands;
 
 	VMemHashSet<CookingCommandID>		  mCommandsQueuedForUpdateDirtyState;
 	mutable Mutex						  mCommandsQueuedForUpdateDirtyStateMutex;
 
+	struct VerifiedOutput
+	{
+		FileID                            mFileID;
+		FileRefNumber                     mRefNumber;
+		USN                               mUSN = 0;
+	};
+	Vector<VerifiedOutput>                mVerifiedOutputs; // Filled by the cooking threads, applied by the monitor thread.
+	Mutex                                 mVerifiedOutputsMutex;
+
 	CookingQueue                          mCommandsDirty;	// All dirty commands.
 	CookingThreadsQueue                   mCommandsToCook;	// Commands that will get cooked by the cooking threads.
 
+	struct DebouncedCommand
+	{
+		int64                             mReleaseTicks = 0; // Time after which the command can be queued for cooking.
+		USN                               mMaxInputUSN  = 0; // Last input change seen, to detect further changes.
+	};
+	HashMap<CookingCommandID, DebouncedCommand> mDebouncedCommands; // Commands waiting for their inputs to settle before being queued for cooking.
+	mutable Mutex                         mDebouncedCommandsMutex;
+	AtomicInt32                           mCooksAvoidedByDebounce = 0;
+
+	Vector<RuleResourceUsage>             mRuleResourceUsage; // Indexed by rule.
+	mutable Mutex                         mRuleResourceUsageMutex;
+
+	Vector<OutputRequest*>                mOutputRequests; // Requests that aren't Done yet.
+	Mutex                                 mOutputRequestsMutex;
+
+	// Long-lived process cooking the commands of a rule one at a time (see CommandType::Worker).
+	struct Worker
+	{
+		OwnedHandle mProcess;		// Invalid if the worker isn't started.
+		OwnedHandle mInputPipe;		// Write end of the stdin of the worker. Closed to tell it there are no more jobs.
+		OwnedHandle mOutputPipe;	// Read end of the stdout (and stderr) of the worker.
+		OwnedHandle mJobObject;		// Nested in the main job object. Terminated to kill the worker on cancel or timeout.
+	};
+
 	struct CookingThread
 	{
 		Thread						      mThread;
 		StringPool					      mStringPool;
 		Atomic<CookingLogEntryID>	      mCurrentLogEntry;
+		Mutex						      mCancelMutex;
+		void*						      mCookJobObject   = nullptr; // Job object of the processes currently running (not owned). Protected by mCancelMutex.
+		bool						      mCancelRequested = false;   // Protected by mCancelMutex.
+		bool						      mInteractiveOnly = false;   // Reserved for the interactive lane.
+		Vector<CookingCommandID>	      mBatch;                     // Commands popped together with the current one.
+		Vector<Worker>				      mWorkers;                   // Worker processes started by this thread, indexed by rule.
 	};
 	FixedVector<CookingThread, 128>       mCookingThreads;
 	bool                                  mCookingStartPaused     = false;
 	bool                                  mCookingPaused          = true;
 	int                                   mWantedCookingThreadCount = 0;	// Number of threads requested. Actual number of threads created might be lower. 
+	int                                   mWantedInteractiveCookingThreadCount = 1; // Number of threads reserved for the interactive lane. At least one thread is always left for the background lane.
+	float                                 mWantedCookingMemoryBudget = 0.f; // Memory (in GiB) available to the commands (see CookingRule::mMemoryWeight). Zero means the installed physical memory.
+	bool                                  mAdaptiveCookingThreads = false; // If true, the number of active cooking threads changes with the CPU load (starting from mWantedCookingThreadCount).
+
+	struct AdaptiveSample
+	{
+		int64                             mTicks          = 0;
+		uint64                            mSystemIdleTime = 0; // In 100ns units, like all the times below.
+		uint64                            mSystemTime     = 0; // Kernel + user time of all cores (idle included).
+		uint64                            mCookCPUTime    = 0; // Kernel + user time of all the processes started by the cooking threads.
+	};
+	AdaptiveSample                        mLastAdaptiveSample;
 
 	friend void                           gDrawCookingLog();
 	friend void                           gDrawSelectedCookingLogEntry();
 	VMemArray<CookingLogEntry>            mCookingLog;
+	CookingLogStorage                     mCookingLogStorage;
 
 	AtomicInt32                           mCookingErrors           = 0; // Total number of commands that ended in error.
 	int                                   mLastNotifCookingErrors  = 0;
 	int									  mLastNotifCookingLogSize = 0;
 	int64                                 mLastNotifTicks          = 0;
 
-	HashSet<CookingLogEntry*>             mTimeOutCurrentBatch;
-	HashSet<CookingLogEntry*>             mTimeOutNextBatch;
-	mutable Mutex                         mTimeOutMutex;
-	Thread                                mTimeOutUpdateThread;
-	ConditionVariable                     mTimeOutAddedSignal;
-	Semaphore                             mTimeOutTimerSignal = Semaphore(0, 1);
-
 	OwnedHandle                           mJobObject; // JobObject used to make sure child processes are killed if this process ends.
 };
 
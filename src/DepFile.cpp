@@ -15,6 +15,16 @@
 #include "win32/file.h"
 #include "win32/io.h"
 
+#include "xxHash/xxh3.h"
+
+// The writer is only used by the tests here, but it's compiled in Asset Cooker to make sure it stays in sync with the reader.
+#define AC_DEP_FILE_IMPLEMENTATION
+#include "AssetCookerDepFile.h"
+
+#include <algorithm> // for std::sort, sad!
+#include <bit>
+#include <emmintrin.h>
+
 bool gReadFile(StringView inPath, TempVector<uint8>& outFileData)
 {
 	TempString long_path;
@@ -58,11 +68,60 @@ static bool sMakeEscapedWithDollar(char inChar)
 	return inChar == '$';
 }
 
+static bool sIsSpecialChar(char inChar)
+{
+	return sIsSpace(inChar) || inChar == '\\' || inChar == '$';
+}
+
+// Return the position of the first space, tab, backslash or dollar (the only characters that matter when tokenizing Make dep files),
+// starting at inStart. Return the size of the string if there are none.
+// Dep files can contain thousands of long paths, so test 16 characters at a time with SSE2.
+static int sFindSpecialChar(StringView inString, int inStart)
+{
+	const char* data = inString.Data();
+	const int   size = inString.Size();
+	int         i    = inStart;
+
+	const __m128i space     = _mm_set1_epi8(' ');
+	const __m128i tab       = _mm_set1_epi8('\t');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i dollar    = _mm_set1_epi8('$');
+
+	for (; i + 16 <= size; i += 16)
+	{
+		__m128i chars = _mm_loadu_si128((const __m128i*)(data + i));
+		__m128i found = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chars, space), _mm_cmpeq_epi8(chars, tab)),
+									 _mm_or_si128(_mm_cmpeq_epi8(chars, backslash), _mm_cmpeq_epi8(chars, dollar)));
+
+		uint32 mask = (uint32)_mm_movemask_epi8(found);
+		if (mask != 0)
+			return i + std::countr_zero(mask);
+	}
+
+	// Test the remaining characters one by one.
+	for (; i < size; ++i)
+		if (sIsSpecialChar(data[i]))
+			return i;
+
+	return size;
+}
+
+REGISTER_TEST("FindSpecialChar")
+{
+	TEST_TRUE(sFindSpecialChar("", 0) == 0);
+	TEST_TRUE(sFindSpecialChar("file.txt", 0) == 8);
+	TEST_TRUE(sFindSpecialChar("a very long path with spaces.txt", 0) == 1);
+	TEST_TRUE(sFindSpecialChar("a very long path with spaces.txt", 2) == 6);
+	TEST_TRUE(sFindSpecialChar("a_very_long_path_without_spaces\\file.txt", 0) == 31);
+	TEST_TRUE(sFindSpecialChar("a_very_long_path_without_spaces_file.txt\t", 0) == 40);
+	TEST_TRUE(sFindSpecialChar("a_very_long_path_without_spaces_file.txt", 3) == 40);
+	TEST_TRUE(sFindSpecialChar("$$a_very_long_path_without_spaces_file.txt", 1) == 1);
+};
+
 // glslang and GNU make expects a series of paths on a single line.
 // Spaces in paths are escaped with backslashes.
 static StringView sExtractFirstPath(StringView inLine)
 {
-	bool escaping_next_character = false;
 	// Trim spaces before processing.
 	while (!inLine.Empty() && sIsSpace(inLine[0]))
 	{
@@ -73,22 +132,17 @@ static StringView sExtractFirstPath(StringView inLine)
 		inLine.RemoveSuffix(1);
 	}
 
-	StringView remaining = inLine;
-	while (!remaining.Empty())
+	// Only stop on the characters that matter.
+	int pos = 0;
+	while ((pos = sFindSpecialChar(inLine, pos)) < inLine.Size())
 	{
-		char c = remaining[0];
-		if (escaping_next_character)
-		{
-			escaping_next_character = false;
-		}
-		else if (c == '\\')
-		{
-			escaping_next_character = true;
-		}
-		else if(sIsSpace(c))
-			return inLine.SubStr(0, remaining.Data() - inLine.Data());
-
-		remaining = remaining.SubStr(1);
+		char c = inLine[pos];
+		if (c == '\\')
+			pos += 2; // Skip the escaped character.
+		else if (sIsSpace(c))
+			return inLine.SubStr(0, pos);
+		else
+			pos += 1;
 	}
 	return inLine;
 }
@@ -107,20 +161,21 @@ REGISTER_TEST("ExtractFirstPath")
 static TempString sCleanupPath(StringView line)
 { 
 	TempString cleaned_path;
-	for (auto it = line.begin(); it != line.end(); ++it)
+	cleaned_path.Reserve(line.Size());
+
+	// Copy everything between the escape characters in one go.
+	int copy_start = 0;
+	for (int i = sFindSpecialChar(line, 0); i < line.Size(); i = sFindSpecialChar(line, i + 1))
 	{
-		auto next_character = it + 1;
-		if (*it == '\\' && next_character != line.end() && sMakeEscapedWithBackslash(*next_character))
+		bool has_next = i + 1 < line.Size();
+		if ((line[i] == '\\' && has_next && sMakeEscapedWithBackslash(line[i + 1])) ||
+			(line[i] == '$' && has_next && sMakeEscapedWithDollar(line[i + 1])))
 		{
-			continue;
-		}
-		if (*it == '$' && next_character != line.end() && sMakeEscapedWithDollar(*next_character))
-		{
-			continue;
+			cleaned_path.Append(line.SubStr(copy_start, i - copy_start));
+			copy_start = i + 1;
 		}
-		char c = *it;
-		cleaned_path.Append({ &c, 1 });
 	}
+	cleaned_path.Append(line.SubStr(copy_start));
 	return cleaned_path;
 }
 
@@ -164,6 +219,59 @@ REGISTER_TEST("CleanupPath")
 };
 
 
+// Cache of the files found in dep files, by path as written in the dep file.
+// Dep files are read again every time their command cooks, and the dep files of different commands often contain the same paths (eg. common headers),
+// so most paths are found in there and don't need a syscall to get the absolute path, a repo lookup, and a normalized path hash.
+// The FileID of a path never changes (files are never removed, only marked as deleted), so entries never need to be invalidated.
+// Note: relative paths depend on the current directory, but it's only set once at startup.
+// Per thread because dep files are read from multiple threads.
+struct DepFilePathCache
+{
+	static constexpr int cMaxSize = 256 * 1024; // Entries are small, but don't grow forever.
+
+	HashMap<Hash128, FileID> mFileIDByPath;     // Key is the case sensitive hash of the path spelling.
+};
+static thread_local DepFilePathCache tDepFilePathCache;
+
+
+// Get (or add) the file corresponding to a path found in a dep file.
+// Return an invalid FileID if the path doesn't belong in any repo, and set outAbsPath for the error message.
+static FileID sGetOrAddDepFileFile(StringView inPath, TempString& outAbsPath)
+{
+	XXH128_hash_t hash_xx = XXH3_128bits(inPath.Data(), inPath.Size());
+	Hash128       path_hash;
+	memcpy(path_hash.mData, &hash_xx, sizeof(path_hash.mData));
+
+	HashMap<Hash128, FileID>& cache = tDepFilePathCache.mFileIDByPath;
+	if (auto it = cache.Find(path_hash); it != cache.End())
+		return it->mValue;
+
+	// Make a copy because we need a null terminated string.
+	TempString path = inPath;
+
+	// Get a proper absolute path, in case some relative parts are involved (might happen when doing #include "../something.h").
+	outAbsPath = gGetAbsolutePath(path);
+
+	// Find the repo.
+	FileRepo* repo = gFileSystem.FindRepoByPath(outAbsPath);
+	if (repo == nullptr)
+		return FileID::cInvalid();
+
+	// Skip the repo path to get the file part.
+	StringView file_path = outAbsPath.SubStr(repo->mRootPath.Size());
+
+	// Find or add the file.
+	// The file probably exists, but we can't be sure of that (maybe we're reading the dep file after it was deleted).
+	FileID     file_id = repo->GetOrAddFile(file_path, FileType::File, {}).mID;
+
+	if (cache.Size() >= DepFilePathCache::cMaxSize)
+		cache.Clear();
+
+	cache.Insert(path_hash, file_id);
+	return file_id;
+}
+
+
 // Barebones GNU Make-like dependency file parser. 
 static bool sParseDepFileMake(FileID inDepFileID, StringView inDepFileContent, Vector<FileID>& outInputs)
 {
@@ -220,28 +328,18 @@ static bool sParseDepFileMake(FileID inDepFileID, StringView inDepFileContent, V
 
 			current_line = current_line.SubStr(dep_file_path.Data() + dep_file_path.Size() - current_line.Data());
 
-			// Make a copy because we need a null terminated string.
 			TempString path = sCleanupPath(dep_file_path);
 
-			// Get a proper absolute path, in case some relative parts are involved (might happen when doing #include "../something.h").
-			TempString abs_path = gGetAbsolutePath(path);
-
-			// Find the repo.
-			FileRepo* repo = gFileSystem.FindRepoByPath(abs_path);
-			if (repo == nullptr)
+			// Find or add the file.
+			TempString abs_path;
+			FileID     file_id = sGetOrAddDepFileFile(path, abs_path);
+			if (!file_id.IsValid())
 			{
 				gAppLogError(R"(Failed to parse Dep File %s, path doesn't belong in any Repo ("%s"))", 
 					inDepFileID.GetFile().ToString().AsCStr(), abs_path.AsCStr());
 				return false;
 			}
 
-			// Skip the repo path to get the file part.
-			StringView file_path = abs_path.SubStr(repo->mRootPath.Size());
-
-			// Find or add the file.
-			// The file probably exists, but we can't be sure of that (maybe we're reading the dep file after it was deleted).
-			FileID     file_id = repo->GetOrAddFile(file_path, FileType::File, {}).mID;
-
 			// Add it to the input list, while making sure there are no duplicates.
 			gEmplaceSorted(outInputs, file_id);
 		}
@@ -390,26 +488,15 @@ static bool sParseDepFileAssetCooker(FileID inDepFileID, StringView inDepFileCon
 	// Process the file paths.
 	for (const Dependency& dep : dependencies)
 	{
-		// Make a copy because we need a null terminated string.
-		TempString path = dep.mPath;
-
-		// Get a proper absolute path, in case some relative parts are involved (might happen when doing #include "../something.h").
-		TempString abs_path = gGetAbsolutePath(path);
-
-		// Find the repo.
-		FileRepo* repo = gFileSystem.FindRepoByPath(abs_path);
-		if (repo == nullptr)
+		// Find or add the file.
+		TempString abs_path;
+		FileID     file_id = sGetOrAddDepFileFile(dep.mPath, abs_path);
+		if (!file_id.IsValid())
 		{
 			errors.PushBack(gFormat(R"(Path doesn't belong in any Repo ("%s"))", abs_path.AsCStr()));
+			continue;
 		}
 
-		// Skip the repo path to get the file part.
-		StringView file_path = abs_path.SubStr(repo->mRootPath.Size());
-
-		// Find or add the file.
-		// The file probably exists, but we can't be sure of that (maybe we're reading the dep file after it was deleted).
-		FileID     file_id = repo->GetOrAddFile(file_path, FileType::File, {}).mID;
-
 		// Add it to the input/output lists, while making sure there are no duplicates.
 		switch (dep.mType)
 		{
@@ -438,6 +525,234 @@ static bool sParseDepFileAssetCooker(FileID inDepFileID, StringView inDepFileCon
 }
 
 
+// Check the header and the bounds of the binary dep file format (see AssetCookerDepFile.h).
+// Return the number of entries, or -1 (and set outError) if the content is invalid.
+static int sValidateDepFileBinary(StringView inDepFileContent, AcDepFileHeader& outHeader, const char*& outError)
+{
+	if (inDepFileContent.Size() < (int)sizeof(AcDepFileHeader))
+	{
+		outError = "File too small";
+		return -1;
+	}
+
+	memcpy(&outHeader, inDepFileContent.Data(), sizeof(AcDepFileHeader));
+
+	if (outHeader.mMagic != AC_DEP_FILE_MAGIC)
+	{
+		outError = "Not a binary dep file";
+		return -1;
+	}
+
+	if (outHeader.mVersion != AC_DEP_FILE_VERSION)
+	{
+		outError = "Unsupported version";
+		return -1;
+	}
+
+	uint64 entry_size    = sizeof(AcDepFileEntry) + ((outHeader.mFlags & AC_DEP_FILE_FLAG_PATH_HASHES) ? sizeof(Hash128) : 0);
+	uint64 expected_size = sizeof(AcDepFileHeader) + entry_size * outHeader.mEntryCount + outHeader.mStringTableSize;
+	if (expected_size != (uint64)inDepFileContent.Size())
+	{
+		outError = "File size doesn't match the header";
+		return -1;
+	}
+
+	return (int)outHeader.mEntryCount;
+}
+
+
+REGISTER_TEST("DepFile_BinaryHeader")
+{
+	AcDepFileHeader header     = { AC_DEP_FILE_MAGIC, AC_DEP_FILE_VERSION, 0, 1, 3 };
+	AcDepFileEntry  entry      = { 0, 3, 1, 0 };
+	char            content[sizeof(header) + sizeof(entry) + 3];
+	memcpy(content, &header, sizeof(header));
+	memcpy(content + sizeof(header), &entry, sizeof(entry));
+	memcpy(content + sizeof(header) + sizeof(entry), "a.h", 3);
+
+	AcDepFileHeader read_header;
+	const char*     error = nullptr;
+	TEST_TRUE(sValidateDepFileBinary({ content, (int)sizeof(content) }, read_header, error) == 1);
+	TEST_TRUE(read_header.mStringTableSize == 3);
+
+	// Truncated.
+	TEST_TRUE(sValidateDepFileBinary({ content, (int)sizeof(content) - 1 }, read_header, error) == -1);
+
+	// Claims to have hashes, but doesn't.
+	header.mFlags = AC_DEP_FILE_FLAG_PATH_HASHES;
+	memcpy(content, &header, sizeof(header));
+	TEST_TRUE(sValidateDepFileBinary({ content, (int)sizeof(content) }, read_header, error) == -1);
+
+	// Wrong version.
+	header.mFlags   = 0;
+	header.mVersion = AC_DEP_FILE_VERSION + 1;
+	memcpy(content, &header, sizeof(header));
+	TEST_TRUE(sValidateDepFileBinary({ content, (int)sizeof(content) }, read_header, error) == -1);
+};
+
+
+namespace
+{
+	struct BinaryDependency
+	{
+		StringView mPath;
+		PathHash   mPathHash; // All zeros if the writer didn't provide it.
+		bool       mIsOutput = false;
+	};
+}
+
+// Decode the binary dep file format written by AssetCookerDepFile.h.
+// Return false if the header is invalid. Entries with an invalid path are skipped and added to outErrors.
+static bool sParseDepFileBinary(StringView inDepFileContent, TempVector<BinaryDependency>& outDependencies, Vector<String>& outErrors)
+{
+	AcDepFileHeader header;
+	const char*     error       = nullptr;
+	int             entry_count = sValidateDepFileBinary(inDepFileContent, header, error);
+	if (entry_count < 0)
+	{
+		outErrors.PushBack(error);
+		return false;
+	}
+
+	const char* entries      = inDepFileContent.Data() + sizeof(AcDepFileHeader);
+	const char* hashes       = (header.mFlags & AC_DEP_FILE_FLAG_PATH_HASHES) ? entries + sizeof(AcDepFileEntry) * entry_count : nullptr;
+	const char* string_table = inDepFileContent.Data() + inDepFileContent.Size() - header.mStringTableSize;
+
+	outDependencies.Reserve(entry_count);
+
+	for (int i = 0; i < entry_count; ++i)
+	{
+		AcDepFileEntry entry;
+		memcpy(&entry, entries + sizeof(AcDepFileEntry) * i, sizeof(AcDepFileEntry));
+
+		if ((uint64)entry.mPathOffset + entry.mPathSize > header.mStringTableSize || entry.mPathSize == 0)
+		{
+			outErrors.PushBack(gFormat("Entry %d has an invalid path", i));
+			continue;
+		}
+
+		BinaryDependency& dep = outDependencies.EmplaceBack();
+		dep.mPath             = { string_table + entry.mPathOffset, (int)entry.mPathSize };
+		dep.mIsOutput         = entry.mIsOutput != 0;
+
+		if (hashes)
+			memcpy(&dep.mPathHash, hashes + sizeof(PathHash) * i, sizeof(PathHash));
+	}
+
+	return true;
+}
+
+
+REGISTER_TEST("DepFile_BinaryRoundTrip")
+{
+	TEST_INIT_TEMP_MEMORY(10_KiB);
+
+	constexpr StringView cTestFilePath = "DepFile_BinaryRoundTrip.tmp";
+	defer { DeleteFileA(cTestFilePath.AsCStr()); };
+
+	PathHash hash;
+	hash.mData[0] = 0x0123456789ABCDEF;
+	hash.mData[1] = 0xFEDCBA9876543210;
+
+	for (bool with_hashes : { false, true })
+	{
+		AcDepFileWriter writer;
+		ac_dep_file_init(&writer);
+		ac_dep_file_add(&writer, R"(D:\inputs\file.png)", 0, with_hashes ? (const uint8*)hash.mData : nullptr);
+		ac_dep_file_add(&writer, "relative/path with spaces.txt", 0, nullptr);
+		ac_dep_file_add(&writer, R"(X:\outputs\file.dds)", 1, nullptr);
+		TEST_TRUE(ac_dep_file_write(&writer, cTestFilePath.AsCStr()) == 1);
+		ac_dep_file_free(&writer);
+
+		TempVector<uint8> buffer;
+		TEST_TRUE(gReadFile(cTestFilePath, buffer));
+		StringView content((const char*)buffer.Begin(), buffer.Size() - 1); // -1 to exclude the null terminator
+
+		TempVector<BinaryDependency> dependencies;
+		Vector<String>               errors;
+		TEST_TRUE(sParseDepFileBinary(content, dependencies, errors));
+		TEST_TRUE(errors.Empty());
+		TEST_TRUE(dependencies.Size() == 3);
+
+		TEST_TRUE(dependencies[0].mPath == R"(D:\inputs\file.png)");
+		TEST_FALSE(dependencies[0].mIsOutput);
+		TEST_TRUE(dependencies[0].mPathHash == (with_hashes ? hash : PathHash{}));
+
+		TEST_TRUE(dependencies[1].mPath == "relative/path with spaces.txt");
+		TEST_FALSE(dependencies[1].mIsOutput);
+		TEST_TRUE(dependencies[1].mPathHash == PathHash{});
+
+		TEST_TRUE(dependencies[2].mPath == R"(X:\outputs\file.dds)");
+		TEST_TRUE(dependencies[2].mIsOutput);
+
+		// The hashes are only written when at least one entry has one.
+		uint64 expected_size = sizeof(AcDepFileHeader) + 3 * (sizeof(AcDepFileEntry) + (with_hashes ? sizeof(PathHash) : 0))
+			+ dependencies[0].mPath.Size() + dependencies[1].mPath.Size() + dependencies[2].mPath.Size();
+		TEST_TRUE((uint64)content.Size() == expected_size);
+	}
+};
+
+
+// Read the binary dep file format written by AssetCookerDepFile.h.
+// No text parsing, and when the writer provided path hashes, files that are already known don't need their path resolved at all.
+static bool sParseDepFileBinary(FileID inDepFileID, StringView inDepFileContent, Vector<FileID>& outInputs, Vector<FileID>& outOutputs)
+{
+	TempVector<BinaryDependency> dependencies;
+	Vector<String>               errors;
+
+	// Decode the content.
+	if (sParseDepFileBinary(inDepFileContent, dependencies, errors))
+	{
+		// Process the file paths.
+		for (const BinaryDependency& dep : dependencies)
+		{
+			FileID file_id;
+
+			// If the writer provided the hash, try to find the file directly.
+			if (dep.mPathHash != PathHash{})
+				file_id = gFileSystem.FindFileIDByPathHash(dep.mPathHash);
+
+			// Otherwise resolve the path.
+			if (!file_id.IsValid())
+			{
+				TempString abs_path;
+				file_id = sGetOrAddDepFileFile(dep.mPath, abs_path);
+				if (!file_id.IsValid())
+				{
+					errors.PushBack(gFormat(R"(Path doesn't belong in any Repo ("%s"))", abs_path.AsCStr()));
+					continue;
+				}
+			}
+
+			// Sort and remove duplicates at the end, inserting sorted would be quadratic for large dep files.
+			if (dep.mIsOutput)
+				outOutputs.PushBack(file_id);
+			else
+				outInputs.PushBack(file_id);
+		}
+	}
+
+	auto sort_and_remove_duplicates = [](Vector<FileID>& ioFiles)
+	{
+		std::sort(ioFiles.begin(), ioFiles.end());
+		ioFiles.Resize((int)(std::unique(ioFiles.begin(), ioFiles.end()) - ioFiles.begin()));
+	};
+	sort_and_remove_duplicates(outInputs);
+	sort_and_remove_duplicates(outOutputs);
+
+	if (!errors.Empty())
+	{
+		gAppLogError(R"(Failed to parse Dep File %s)", inDepFileID.GetFile().ToString().AsCStr());
+		for (String& error : errors)
+			gAppLogError("  %s", error.AsCStr());
+
+		return false;
+	}
+
+	return true;
+}
+
+
 
 bool gReadDepFile(DepFileFormat inFormat, FileID inDepFileID, Vector<FileID>& outInputs, Vector<FileID>& outOutputs)
 {
@@ -463,6 +778,10 @@ bool gReadDepFile(DepFileFormat inFormat, FileID inDepFileID, Vector<FileID>& ou
 	{
 		return sParseDepFileMake(inDepFileID, dep_file_content, outInputs);
 	}
+	else if (inFormat == DepFileFormat::AssetCookerBinary)
+	{
+		return sParseDepFileBinary(inDepFileID, dep_file_content, outInputs, outOutputs);
+	}
 	else
 	{
 		// Unsupported.
@@ -471,47 +790,47 @@ bool gReadDepFile(DepFileFormat inFormat, FileID inDepFileID, Vector<FileID>& ou
 }
 
 
-void gApplyDepFileContent(CookingCommand& ioCommand, Span<FileID> inDepFileInputs, Span<FileID> inDepFileOutputs)
+// Update the InputOf/OutputOf lists of the files that were (or are now) in a dep file.
+static void sUpdateDepFileEdges(CookingCommandID inCommandID, Span<const FileID> inStaticFiles, FileSetID inOldDepFileSet, FileSetID inNewDepFileSet,
+								CommandEdgeList FileInfo::* inEdges)
 {
-	// Update the mInputOf fields.
-	{
-		TempHashSet<FileID> old_dep_file_inputs = gToHashSet(Span(ioCommand.mDepFileInputs));
-		TempHashSet<FileID> new_dep_file_inputs = gToHashSet(Span(inDepFileInputs));
+	// Most of the time the dep file didn't change, nothing to do.
+	// Note: sets are shared, if the content is the same, the ID is the same.
+	if (inOldDepFileSet == inNewDepFileSet)
+		return;
+
+	const FileSetPool& pool      = gCookingSystem.GetDepFileSets();
+	Span<const FileID> old_files = pool.Get(inOldDepFileSet);
+	Span<const FileID> new_files = pool.Get(inNewDepFileSet);
+
+	// Remove this command from the old files and add it to the new ones.
+	// Adding and removing are O(1) (even for files used by many commands), this is cheaper than finding which files actually changed.
+	// Note: the static files always keep this command, and files can be listed twice in a dep file, so the lists may already be up to date.
+	for (FileID old_file : old_files)
+		if (!gContains(inStaticFiles, old_file))
+			(void)(old_file.GetFile().*inEdges).Remove(inCommandID);
+
+	for (FileID new_file : new_files)
+		if (!gContains(inStaticFiles, new_file) && !(new_file.GetFile().*inEdges).Contains(inCommandID))
+			(new_file.GetFile().*inEdges).Add(inCommandID);
+}
 
-		// If there are new inputs, let them know about this command.
-		for (FileID input : inDepFileInputs)
-			if (!old_dep_file_inputs.Contains(input) && !gContains(ioCommand.mInputs, input))
-				input.GetFile().mInputOf.PushBack(ioCommand.mID);
 
-		// If some inputs disappeared, remove this command from them.
-		for (FileID old_input : old_dep_file_inputs)
-			if (!new_dep_file_inputs.Contains(old_input) && !gContains(ioCommand.mInputs, old_input))
-			{
-				bool found = gSwapEraseFirstIf(old_input.GetFile().mInputOf, [&ioCommand](CookingCommandID inID) { return inID == ioCommand.mID; });
-				gAssert(found);
-			}
-	}
+void gApplyDepFileContent(CookingCommand& ioCommand, Span<const FileID> inDepFileInputs, Span<const FileID> inDepFileOutputs)
+{
+	FileSetPool& pool = gCookingSystem.GetDepFileSets();
 
-	// Update the mOutputOf fields.
-	{
-		TempHashSet<FileID> old_dep_file_outputs = gToHashSet(Span(ioCommand.mDepFileOutputs));
-		TempHashSet<FileID> new_dep_file_outputs = gToHashSet(Span(inDepFileOutputs));
+	// Acquire the new sets before releasing the old ones, they're likely the same.
+	FileSetID dep_file_inputs  = pool.Acquire(inDepFileInputs);
+	FileSetID dep_file_outputs = pool.Acquire(inDepFileOutputs);
 
-		// If there are new outputs, let them know about this command.
-		for (FileID output : inDepFileOutputs)
-			if (!old_dep_file_outputs.Contains(output) && !gContains(ioCommand.mOutputs, output))
-				output.GetFile().mOutputOf.PushBack(ioCommand.mID);
+	sUpdateDepFileEdges(ioCommand.mID, ioCommand.mInputs, ioCommand.mDepFileInputs, dep_file_inputs, &FileInfo::mInputOf);
+	sUpdateDepFileEdges(ioCommand.mID, ioCommand.mOutputs, ioCommand.mDepFileOutputs, dep_file_outputs, &FileInfo::mOutputOf);
 
-		// If some outputs disappeared, remove this command from them.
-		for (FileID old_output : old_dep_file_outputs)
-			if (!new_dep_file_outputs.Contains(old_output) && !gContains(ioCommand.mOutputs, old_output))
-			{
-				bool found = gSwapEraseFirstIf(old_output.GetFile().mOutputOf, [&ioCommand](CookingCommandID inID) { return inID == ioCommand.mID; });
-				gAssert(found);
-			}
-	}
+	pool.Release(ioCommand.mDepFileInputs);
+	pool.Release(ioCommand.mDepFileOutputs);
 
 	// Update the DepFile input/output lists.
-	ioCommand.mDepFileInputs = inDepFileInputs;
-	ioCommand.mDepFileOutputs = inDepFileOutputs;
+	ioCommand.mDepFileInputs  = dep_file_inputs;
+	ioCommand.mDepFileOutputs = dep_file_outputs;
 }
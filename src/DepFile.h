@@ -9,5 +9,14 @@
 
 #include "CookingSystem.h"
 
+// Content of a dep file read ahead of time, to be applied later (see CookingSystem::UpdateAllDirtyStates).
+struct DepFileContent
+{
+	bool           mSuccess = false; // False if the dep file couldn't be read or parsed.
+	Vector<FileID> mInputs;
+	Vector<FileID> mOutputs;
+};
+
+bool gReadFile(StringView inPath, TempVector<uint8>& outFileData); // Read a whole file. The data is null terminated, in case it's text.
 bool gReadDepFile(DepFileFormat inFormat, FileID inDepFileID, Vector<FileID>& outInputs, Vector<FileID>& outOutputs);
-void gApplyDepFileContent(CookingCommand& ioCommand, Span<FileID> inDepFileInputs, Span<FileID> inDepFileOutputs);
\ No newline at end of file
+void gApplyDepFileContent(CookingCommand& ioCommand, Span<const FileID> inDepFileInputs, Span<const FileID> inDepFileOutputs);
\ No newline at end of file
@@ -0,0 +1,307 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include "DepFileScanner.h"
+
+#include "DepFile.h"
+#include "FileSystem.h"
+#include "FileUtils.h"
+#include <Bedrock/HashMap.h>
+#include <Bedrock/Mutex.h>
+#include <Bedrock/Test.h>
+
+#include "AssetCookerDepFile.h" // Implementation compiled in DepFile.cpp.
+
+
+namespace
+{
+	// An #include directive, as written in the file.
+	struct IncludeDirective
+	{
+		String mPath;
+		bool   mIsAngled = false; // #include <path>, the directory of the including file isn't searched.
+	};
+}
+
+
+// Find the #include directives in a file.
+// Doesn't know about comments or #if blocks, so directives in there are found too. That only means a few extra dependencies.
+static void sParseIncludes(StringView inContent, Vector<IncludeDirective>& outIncludes)
+{
+	StringView content = inContent;
+
+	while (!content.Empty())
+	{
+		StringView line = content.SubStr(0, content.FindFirstOf("\r\n"));
+
+		// Go to next line.
+		content.RemovePrefix(line.Size());
+		gRemoveLeading(content, "\r\n");
+
+		// Look for '#', 'include', and the opening quote, with any white space in between.
+		gRemoveLeading(line, " \t");
+		if (!line.StartsWith("#"))
+			continue;
+
+		line.RemovePrefix(1);
+		gRemoveLeading(line, " \t");
+
+		constexpr StringView cInclude = "include";
+		if (!line.StartsWith(cInclude))
+			continue;
+
+		line.RemovePrefix(cInclude.Size());
+		gRemoveLeading(line, " \t");
+
+		// Also skips #include_next and includes of macros, those can't be followed.
+		if (line.Empty() || (line.Front() != '"' && line.Front() != '<'))
+			continue;
+
+		bool is_angled = line.Front() == '<';
+		line.RemovePrefix(1);
+
+		int path_end = line.FindFirstOf(is_angled ? ">" : "\"");
+		if (path_end <= 0)
+			continue;
+
+		outIncludes.PushBack({ line.SubStr(0, path_end), is_angled });
+	}
+}
+
+
+REGISTER_TEST("ParseIncludes")
+{
+	constexpr StringView content =
+		"#include \"simple.h\"\n"
+		"  #  include\t<angled/path.h>  // comment\r\n"
+		"#include_next <next.h>\n"
+		"#include MACRO_PATH\n"
+		"#include \"unterminated.h\n"
+		"#include \"\"\n"
+		"int a; // #include \"not_at_start.h\"\n"
+		"#define include \"not_an_include.h\"\n"
+		"#include\"no_space.h\"";
+
+	Vector<IncludeDirective> includes;
+	sParseIncludes(content, includes);
+
+	TEST_TRUE(includes.Size() == 3);
+
+	TEST_TRUE(includes[0].mPath == "simple.h");
+	TEST_FALSE(includes[0].mIsAngled);
+
+	TEST_TRUE(includes[1].mPath == "angled/path.h");
+	TEST_TRUE(includes[1].mIsAngled);
+
+	TEST_TRUE(includes[2].mPath == "no_space.h");
+	TEST_FALSE(includes[2].mIsAngled);
+};
+
+
+// Cache of the #include directives of each file.
+// Common headers are included by many commands, this avoids reading and parsing them again every time.
+// An entry is only valid for the version of the file it was parsed from, the file is parsed again when it changes.
+struct IncludeCache
+{
+	struct Entry
+	{
+		USN                      mUSN = 0;
+		Vector<IncludeDirective> mIncludes;
+	};
+
+	Mutex                   mMutex; // The scanners run on the cooking threads.
+	HashMap<FileID, Entry>  mEntries;
+};
+static IncludeCache sIncludeCache;
+
+
+// Get the #include directives of a file. Return false if it couldn't be read.
+static bool sGetIncludes(FileID inFileID, Vector<IncludeDirective>& outIncludes)
+{
+	// Get the USN before reading the file. If it changes in between, the entry will be outdated and the file parsed again next time.
+	USN usn = inFileID.GetFile().mLastChangeUSN;
+
+	{
+		LockGuard lock(sIncludeCache.mMutex);
+
+		auto it = sIncludeCache.mEntries.Find(inFileID);
+		if (it != sIncludeCache.mEntries.End() && it->mValue.mUSN == usn && usn != 0)
+		{
+			outIncludes = it->mValue.mIncludes;
+			return true;
+		}
+	}
+
+	TempVector<uint8> buffer;
+	if (!gReadFile(gConcat(inFileID.GetRepo().mRootPath, inFileID.GetFile().mPath), buffer))
+		return false;
+
+	sParseIncludes(StringView((const char*)buffer.Begin(), buffer.Size() - 1), outIncludes); // -1 to exclude the null terminator
+
+	{
+		LockGuard lock(sIncludeCache.mMutex);
+
+		auto it = sIncludeCache.mEntries.Find(inFileID);
+		if (it != sIncludeCache.mEntries.End())
+		{
+			it->mValue.mUSN      = usn;
+			it->mValue.mIncludes = outIncludes;
+		}
+		else
+		{
+			sIncludeCache.mEntries.Insert(inFileID, { usn, outIncludes });
+		}
+	}
+
+	return true;
+}
+
+
+// Find the file an #include directive refers to, the same way compilers do.
+// Only files inside Repos can be found, others (eg. system headers) are ignored.
+// If no existing file is found, return the first known deleted one instead (if any), so that creating it again makes the command cook again.
+static FileID sResolveInclude(const IncludeDirective& inInclude, FileID inIncluder, Span<const String> inIncludeDirs)
+{
+	FileID first_deleted;
+
+	auto try_dir = [&](StringView inDir)
+	{
+		TempString path;
+		if (inInclude.mPath.Size() >= 2 && inInclude.mPath[1] == ':')
+			path = inInclude.mPath; // Already absolute.
+		else
+			path = gTempFormat(R"(%s\%s)", TempString(gNoTrailingSlash(inDir)).AsCStr(), inInclude.mPath.AsCStr());
+
+		FileID file_id = gFileSystem.FindFileIDByPath(gGetAbsolutePath(path));
+		if (!file_id.IsValid() || file_id.GetFile().IsDirectory())
+			return FileID{};
+
+		if (file_id.GetFile().IsDeleted())
+		{
+			if (!first_deleted.IsValid())
+				first_deleted = file_id;
+
+			return FileID{};
+		}
+
+		return file_id;
+	};
+
+	// For "" includes, look in the directory of the including file first.
+	if (!inInclude.mIsAngled)
+	{
+		TempString includer_dir = gConcat(inIncluder.GetRepo().mRootPath, inIncluder.GetFile().GetDirectory());
+		if (FileID file_id = try_dir(includer_dir); file_id.IsValid())
+			return file_id;
+	}
+
+	for (const String& include_dir : inIncludeDirs)
+	{
+		if (FileID file_id = try_dir(include_dir); file_id.IsValid())
+			return file_id;
+	}
+
+	return first_deleted;
+}
+
+
+static bool sRunIncludeScanner(const CookingCommand& inCommand, Vector<FileID>& outInputs, StringPool::ResizableStringView& ioOutput)
+{
+	const CookingRule& rule          = inCommand.GetRule();
+	FileID             main_input_id = inCommand.GetMainInput();
+
+	// Format the include directories for this command.
+	Vector<String> include_dirs;
+	for (const CommandTemplate& include_path_template : rule.mDepFileIncludePathTemplates)
+	{
+		TempString include_dir;
+		if (!include_path_template.FormatCommandString(main_input_id.GetFile(), include_dir))
+		{
+			ioOutput.Append("[error] Failed to format dep file include path.\n");
+			return false;
+		}
+
+		include_dirs.PushBack(include_dir);
+	}
+
+	// Follow the includes recursively, starting from the main input.
+	Vector<FileID>           files_to_scan;
+	Vector<IncludeDirective> includes;
+	files_to_scan.PushBack(main_input_id);
+
+	while (!files_to_scan.Empty())
+	{
+		FileID file_id = files_to_scan.Back();
+		files_to_scan.PopBack();
+
+		includes.Clear();
+		if (!sGetIncludes(file_id, includes))
+		{
+			gAppendFormat(ioOutput, "[error] Failed to read %s\n", file_id.GetFile().ToString().AsCStr());
+			return false;
+		}
+
+		for (const IncludeDirective& include : includes)
+		{
+			FileID include_id = sResolveInclude(include, file_id, include_dirs);
+			if (!include_id.IsValid() || include_id == main_input_id)
+				continue;
+
+			// Add it to the inputs, while making sure there are no duplicates.
+			// If it was already there, it was already scanned (or will be).
+			int previous_size = outInputs.Size();
+			gEmplaceSorted(outInputs, include_id);
+			if (outInputs.Size() == previous_size)
+				continue;
+
+			if (!include_id.GetFile().IsDeleted())
+				files_to_scan.PushBack(include_id);
+		}
+	}
+
+	return true;
+}
+
+
+bool gRunDepFileScanner(const CookingCommand& inCommand, StringPool::ResizableStringView& ioOutput)
+{
+	const CookingRule& rule = inCommand.GetRule();
+
+	Vector<FileID> inputs;
+	switch (rule.mDepFileScanner)
+	{
+	case DepFileScanner::Include:
+		if (!sRunIncludeScanner(inCommand, inputs, ioOutput))
+			return false;
+		break;
+	default:
+		gAssert(false);
+		return false;
+	}
+
+	// Write the dep file.
+	// Include the path hashes, most of these files are already known and don't need their path resolved when the dep file is read.
+	AcDepFileWriter writer;
+	ac_dep_file_init(&writer);
+	defer { ac_dep_file_free(&writer); };
+
+	for (FileID input_id : inputs)
+	{
+		const FileInfo& input = input_id.GetFile();
+		TempString      path  = gConcat(input_id.GetRepo().mRootPath, input.mPath);
+		ac_dep_file_add(&writer, path.AsCStr(), 0, (const uint8*)input.mPathHash.mData);
+	}
+
+	FileID     dep_file_id   = inCommand.GetDepFile();
+	TempString dep_file_path = gConcat(dep_file_id.GetRepo().mRootPath, dep_file_id.GetFile().mPath);
+	if (!ac_dep_file_write(&writer, dep_file_path.AsCStr()))
+	{
+		gAppendFormat(ioOutput, "[error] Failed to write %s\n", dep_file_id.GetFile().ToString().AsCStr());
+		return false;
+	}
+
+	gAppendFormat(ioOutput, "%s scanner found %d dependencies.\n", gToStringView(rule.mDepFileScanner).AsCStr(), inputs.Size());
+	return true;
+}
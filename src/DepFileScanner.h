@@ -0,0 +1,14 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include "CookingSystem.h"
+#include "StringPool.h"
+
+// Run the built-in dep file scanner of the rule on the main input of the command, and write the dep file (in the AssetCookerBinary format).
+// Does the job of a DepFileCommandLine without starting a process. The dep file is then read like any other.
+// Called from the cooking threads. Return false on error (and add the details to ioOutput).
+bool gRunDepFileScanner(const CookingCommand& inCommand, StringPool::ResizableStringView& ioOutput);
@@ -0,0 +1,140 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include "FileSetPool.h"
+
+#include <Bedrock/Test.h>
+
+
+static uint64 sHashFiles(Span<const FileID> inFiles)
+{
+	return gHash(inFiles.Data(), inFiles.Size() * sizeof(FileID));
+}
+
+
+static bool sIsSame(Span<const FileID> inA, Span<const FileID> inB)
+{
+	if (inA.Size() != inB.Size())
+		return false;
+
+	for (int i = 0; i < inA.Size(); ++i)
+		if (inA[i] != inB[i])
+			return false;
+
+	return true;
+}
+
+
+FileSetPool::FileSetPool()
+{
+	// Add the empty list, it's never freed.
+	mSets.Emplace();
+}
+
+
+FileSetID FileSetPool::Acquire(Span<const FileID> inFiles)
+{
+	if (inFiles.Empty())
+		return {};
+
+	uint64 hash = sHashFiles(inFiles);
+
+	// Find an existing list with the same content.
+	auto it = mIndexByHash.Find(hash);
+	if (it != mIndexByHash.End())
+	{
+		Set& set = mSets[it->mValue];
+		if (sIsSame(set.mFiles, inFiles))
+		{
+			set.mRefCount++;
+			return { it->mValue };
+		}
+	}
+
+	// Not found, add a new one (re-using a free slot if possible).
+	uint32 index;
+	if (!mFreeIndices.Empty())
+	{
+		index = mFreeIndices.Back();
+		mFreeIndices.PopBack();
+	}
+	else
+	{
+		index = (uint32)mSets.Size();
+		mSets.Emplace();
+	}
+
+	Set& set      = mSets[index];
+	set.mFiles    = inFiles;
+	set.mHash     = hash;
+	set.mRefCount = 1;
+
+	// If there's a collision, keep the old one in the map. This one won't be shared, but that's still correct.
+	if (it == mIndexByHash.End())
+		mIndexByHash.Insert(hash, index);
+
+	return { index };
+}
+
+
+void FileSetPool::AddRef(FileSetID inID)
+{
+	if (inID.IsEmpty())
+		return;
+
+	gAssert(mSets[inID.mIndex].mRefCount > 0);
+	mSets[inID.mIndex].mRefCount++;
+}
+
+
+void FileSetPool::Release(FileSetID inID)
+{
+	if (inID.IsEmpty())
+		return;
+
+	Set& set = mSets[inID.mIndex];
+	gAssert(set.mRefCount > 0);
+
+	if (--set.mRefCount > 0)
+		return;
+
+	auto it = mIndexByHash.Find(set.mHash);
+	if (it != mIndexByHash.End() && it->mValue == inID.mIndex)
+		mIndexByHash.Erase(it);
+
+	set.mFiles.ClearAndFreeMemory();
+	mFreeIndices.PushBack(inID.mIndex);
+}
+
+
+REGISTER_TEST("FileSetPool")
+{
+	FileSetPool pool;
+
+	FileID files[] = { FileID{ 0, 1 }, FileID{ 0, 2 }, FileID{ 1, 3 } };
+
+	FileSetID a = pool.Acquire(files);
+	FileSetID b = pool.Acquire(files);
+	FileSetID c = pool.Acquire(Span(files, 2));
+
+	// Same content, same list.
+	TEST_TRUE(a == b);
+	TEST_TRUE(a != c);
+	TEST_TRUE(pool.GetSetCount() == 2);
+	TEST_TRUE(pool.Get(a).Size() == 3);
+	TEST_TRUE(pool.Acquire({}).IsEmpty());
+
+	// Still referenced by b.
+	pool.Release(a);
+	TEST_TRUE(pool.GetSetCount() == 2);
+
+	pool.Release(b);
+	TEST_TRUE(pool.GetSetCount() == 1);
+
+	// The free slot is re-used.
+	FileSetID d = pool.Acquire(Span(files + 1, 2));
+	TEST_TRUE(d == a);
+	TEST_TRUE(pool.Get(d)[0] == files[1]);
+};
@@ -0,0 +1,54 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include "Core.h"
+#include "FileSystem.h"
+#include "VMemArray.h"
+
+#include <Bedrock/HashMap.h>
+#include <Bedrock/Vector.h>
+
+
+// Identifier of a list of files in a FileSetPool.
+struct FileSetID
+{
+	uint32 mIndex = 0; // Zero is the empty list.
+
+	bool IsEmpty() const { return mIndex == 0; }
+	auto operator<=>(const FileSetID&) const = default;
+};
+
+
+// Immutable lists of files, shared by everyone that needs the same list.
+// Used for the dep file inputs/outputs, because many commands have the exact same ones (eg. shader permutations including the same headers).
+// Lists are hash-consed: acquiring a list with the same content as an existing one returns the existing one and adds a reference to it.
+// Acquire/AddRef/Release must only be called by one thread at a time. Get can be called from any thread, as long as a reference is held.
+struct FileSetPool : NoCopy
+{
+	FileSetPool();
+
+	FileSetID          Acquire(Span<const FileID> inFiles); // Find or add a list with this content, and add a reference to it.
+	void               AddRef(FileSetID inID);
+	void               Release(FileSetID inID);             // The list is freed when its last reference is released.
+
+	Span<const FileID> Get(FileSetID inID) const { return mSets[inID.mIndex].mFiles; }
+
+	int                GetSetCount() const { return mSets.Size() - 1 - mFreeIndices.Size(); } // Number of lists in use (not including the empty list).
+	int                GetIndexEnd() const { return mSets.Size(); }                           // All the FileSetID indices are lower than this.
+
+private:
+	struct Set
+	{
+		Vector<FileID> mFiles;
+		uint64         mHash     = 0;
+		int            mRefCount = 0;
+	};
+
+	VMemArray<Set>           mSets;
+	HashMap<uint64, uint32>  mIndexByHash; // Lists with a hash collision aren't in there, they're simply not shared.
+	Vector<uint32>           mFreeIndices;
+};
@@ -197,6 +197,13 @@ FileInfo& FileRepo::GetOrAddFile(StringView inPath, FileType inType, FileRefNumb
 	// Calculate the case insensitive path hash that will be used to identify the file.
 	PathHash  path_hash = gHashPath(gConcat(mRootPath, path));
 
+	return GetOrAddFile(path, path_hash, inType, inRefNumber);
+}
+
+FileInfo& FileRepo::GetOrAddFile(StringView inPath, PathHash inPathHash, FileType inType, FileRefNumber inRefNumber)
+{
+	gAssert(gIsNormalized(inPath));
+
 	FileInfo*     file                 = nullptr;
 	FileRefNumber ref_number_to_remove = {};
 
@@ -213,7 +220,7 @@ FileInfo& FileRepo::GetOrAddFile(StringView inPath, FileType inType, FileRefNumb
 			// TODO: not great to access these internals, maybe find a better way?
 			LockGuard map_lock(gFileSystem.mFilesByPathHashMutex);
 
-			auto [_, value, result] = gFileSystem.mFilesByPathHash.Insert(path_hash, new_file_id);
+			auto [_, value, result] = gFileSystem.mFilesByPathHash.Insert(inPathHash, new_file_id);
 			if (result == EInsertResult::Found)
 			{
 				actual_file_id = value;
@@ -270,10 +277,10 @@ FileInfo& FileRepo::GetOrAddFile(StringView inPath, FileType inType, FileRefNumb
 				// Check if the existing file is the same (ie. same path).
 				// The file could have been renamed but kept the same ref number (and we've missed that rename event?),
 				// or it could be a junction/hardlink to the same file (TODO: detect that, at least to error properly?)
-				if (previous_file_id != actual_file_id || previous_file_id.GetFile().mPathHash != path_hash)
+				if (previous_file_id != actual_file_id || previous_file_id.GetFile().mPathHash != inPathHash)
 				{
 					gAppLogError(R"(Found two files with the same RefNumber! %c:\%s and %s%s)", 
-						mDrive.mLetter, path.AsCStr(),
+						mDrive.mLetter, TempString(inPath).AsCStr(),
 						previous_file_id.GetRepo().mRootPath.AsCStr(), previous_file_id.GetFile().mPath.AsCStr());
 
 					// Mark the old file as deleted, and add the new one instead.
@@ -286,7 +293,7 @@ FileInfo& FileRepo::GetOrAddFile(StringView inPath, FileType inType, FileRefNumb
 		if (actual_file_id == new_file_id)
 		{
 			// The file wasn't already known, add it to the list.
-			file = &mFiles.Emplace(files_lock, new_file_id, gNormalizePath(mStringPool.AllocateCopy(path)), path_hash, inType, inRefNumber);
+			file = &mFiles.Emplace(files_lock, new_file_id, mStringPool.AllocateCopy(inPath), inPathHash, inType, inRefNumber);
 		}
 		else
 		{
@@ -650,27 +657,46 @@ bool FileDrive::GetFullPath(const OwnedHandle& inFileHandle, TempString& outFull
 
 
 USN FileDrive::GetUSN(const OwnedHandle& inFileHandle) const
+{
+	USN           usn;
+	FileRefNumber ref_number;
+	if (!GetUSN(inFileHandle, usn, ref_number))
+		gAppFatalError("Failed to get USN data"); // TODO add file path to message
+
+	return usn;
+}
+
+
+bool FileDrive::GetUSN(const OwnedHandle& inFileHandle, USN& outUSN, FileRefNumber& outRefNumber) const
 {
 	PathBufferUTF16 buffer;
 	DWORD available_bytes = 0;
 	if (!DeviceIoControl(inFileHandle, FSCTL_READ_FILE_USN_DATA, nullptr, 0, buffer, gElemCount(buffer) * sizeof(buffer[0]), &available_bytes, nullptr))
-		gAppFatalError("Failed to get USN data"); // TODO add file path to message
+		return false;
 
 	auto record_header = (USN_RECORD_COMMON_HEADER*)buffer;
 	if (record_header->MajorVersion == 2)
 	{
 		auto record = (USN_RECORD_V2*)buffer;
-		return record->Usn;	
+		outUSN      = record->Usn;
+
+		// 64-bit ref numbers are the same as 128-bit ones with the high part set to zero.
+		FILE_ID_128 ref_number_128 = {};
+		memcpy(ref_number_128.Identifier, &record->FileReferenceNumber, sizeof(record->FileReferenceNumber));
+		outRefNumber = ref_number_128;
+		return true;
 	}
 	else if (record_header->MajorVersion == 3)
 	{
-		auto record = (USN_RECORD_V3*)buffer;
-		return record->Usn;
+		auto record  = (USN_RECORD_V3*)buffer;
+		outUSN       = record->Usn;
+		outRefNumber = record->FileReferenceNumber;
+		return true;
 	}
 	else
 	{
 		gAppFatalError("Got unexpected USN record version (%u.%u)", record_header->MajorVersion, record_header->MinorVersion);
-		return 0;
+		return false;
 	}
 }
 
@@ -926,11 +952,16 @@ bool FileDrive::ProcessMonitorDirectory(Span<uint8> ioBufferUSN, ScanQueue &ioSc
 			{
 				FileInfo& file = file_id.GetFile();
 
+				file.mLastChangeTime = inRecord.TimeStamp.QuadPart;
+
+				// If the change was already seen (the cooking threads read the USN of outputs directly), there's nothing else to do.
+				if (inRecord.Usn <= file.mLastChangeUSN)
+					return;
+
 				if (gApp.mLogFSActivity >= LogLevel::Verbose)
 					gAppLog("Modified %s", file.ToString().AsCStr());
 
 				file.mLastChangeUSN  = inRecord.Usn;
-				file.mLastChangeTime = inRecord.TimeStamp.QuadPart;
 
 				gCookingSystem.QueueUpdateDirtyStates(file.mID);
 			}
@@ -1008,9 +1039,32 @@ FileRepo* FileSystem::FindRepo(StringView inRepoName)
 
 FileRepo* FileSystem::FindRepoByPath(StringView inAbsolutePath)
 {
-	for (FileRepo& repo : mRepos)
+	if (mRepoRootPathSizes.Empty() || inAbsolutePath.Size() < mRepoRootPathSizes.Front())
+		return nullptr;
+
+	// Repos can't overlap, so at most one root path is a prefix of this path.
+	// Instead of comparing with every root path, look up the prefixes that have the size of a root path.
+	TempString lowercase_path = inAbsolutePath.SubStr(0, mRepoRootPathSizes.Back());
+	gToLowercase(lowercase_path);
+
+	for (int root_path_size : mRepoRootPathSizes)
+	{
+		if (root_path_size > inAbsolutePath.Size())
+			break;
+
+		// Root paths end with a slash, no need to hash the prefixes that don't.
+		if (lowercase_path[root_path_size - 1] != '\\')
+			continue;
+
+		auto it = mRepoIndexByRootPath.Find(gHash(lowercase_path.SubStr(0, root_path_size)));
+		if (it == mRepoIndexByRootPath.End())
+			continue;
+
+		// Make sure it's not a hash collision.
+		FileRepo& repo = mRepos[it->mValue];
 		if (gStartsWithNoCase(inAbsolutePath, repo.mRootPath))
 			return &repo;
+	}
 
 	return nullptr;
 }
@@ -1084,6 +1138,12 @@ FileRepo& FileSystem::AddRepo(StringView inName, StringView inRootPath)
 		}
 	}
 
+	// Add the root path to the table used by FindRepoByPath.
+	TempString lowercase_root_path = root_path;
+	gToLowercase(lowercase_root_path);
+	mRepoIndexByRootPath.Insert(gHash(StringView(lowercase_root_path)), (uint32)mRepos.Size());
+	gEmplaceSorted(mRepoRootPathSizes, root_path.Size());
+
 	return mRepos.Emplace({}, (uint32)mRepos.Size(), inName, root_path, GetOrAddDrive(root_path[0]));
 }
 
@@ -1327,6 +1387,13 @@ void FileSystem::KickMonitorDirectoryThread()
 }
 
 
+// Timers are in milliseconds, the wheel doesn't need more precision than that.
+static int64 sGetTimerTimeMs()
+{
+	return (int64)gTicksToMilliseconds(gGetTickCount());
+}
+
+
 // TODO this is doing a bit more than monitoring the filesystem, give it a more general name and move to app?
 void FileSystem::MonitorDirectoryThread(const Thread& inThread)
 {
@@ -1372,9 +1439,7 @@ void FileSystem::MonitorDirectoryThread(const Thread& inThread)
 	mInitState.Store(InitState::PreparingCommands);
 
 	// Create the commands for all the files.
-	for (auto& repo : mRepos)
-		for (auto& file : repo.mFiles)
-			gCookingSystem.CreateCommandsForFile(file);
+	gCookingSystem.CreateCommandsForAllFiles();
 
 	// Check which commmands need to cook.
 	gCookingSystem.UpdateAllDirtyStates();
@@ -1389,44 +1454,6 @@ void FileSystem::MonitorDirectoryThread(const Thread& inThread)
 	{
 		bool any_work_done = false;
 
-		// Check the queue of files to re-scan (we try again if it eg. fails because the file was in use).
-		while (true)
-		{
-			int64  current_time = gGetTickCount();
-			FileID file_to_rescan;
-			{
-				// Check if there's an item in the queue, and if it's time to scan it again.
-				LockGuard lock(mFilesToRescanMutex);
-				if (!mFilesToRescan.IsEmpty() && mFilesToRescan.Front().mWaitUntilTicks <= current_time)
-				{
-					file_to_rescan = mFilesToRescan.Front().mFileID;
-					mFilesToRescan.PopFront();
-				}
-				else
-				{
-					// Nothing more to re-scan.
-					break;
-				}
-			}
-
-			// Scan it.
-			FileRepo& repo = file_to_rescan.GetRepo();
-			if (file_to_rescan.GetFile().IsDirectory())
-			{
-				FileID dir_id = file_to_rescan;
-				do
-				{
-					repo.ScanDirectory(dir_id, scan_queue, buffer_scan);
-				} while ((dir_id = scan_queue.Pop()) != FileID::cInvalid());
-			}
-			else
-			{
-				repo.ScanFile(file_to_rescan.GetFile(), FileRepo::RequestedAttributes::All);
-			}
-
-			any_work_done = true;
-		}
-
 		// Check the USN journal of every drive to see if files changed.
 		for (auto& drive : mDrives)
 		{
@@ -1443,13 +1470,34 @@ void FileSystem::MonitorDirectoryThread(const Thread& inThread)
 				break;
 		}
 
+		// Apply the changes the cooking threads saw directly on their outputs.
+		if (gCookingSystem.ProcessVerifiedOutputs())
+			any_work_done = true;
+
+		// Rescan the files that were in use and time out the commands still waiting for their outputs.
+		// Done after processing the USN journal, so that output timeouts can't miss changes that are already in it.
+		if (ProcessTimers(scan_queue, buffer_scan))
+			any_work_done = true;
+
 		// Note: we don't update any_work_done here because we don't want to cause a busy loop waiting to update commands that are still cooking.
 		// Instead the cooking threads will wake this thread up any time a command finishes (which usually also means there are file changes to process).
 		gCookingSystem.ProcessUpdateDirtyStates();
 
+		// Queue the commands whose inputs have settled (see CookingRule::mDebounceTime).
+		int64 next_debounce_ticks = gCookingSystem.ProcessDebouncedCommands();
+
+		// Cook the outputs requested by clients first, and tell them when they're ready.
+		gCookingSystem.ProcessOutputRequests();
+
 		// Launch notifications if there are errors or cooking is finished.
 		gCookingSystem.UpdateNotifications();
 
+		// Adjust the number of active cooking threads to the CPU load (if enabled).
+		gCookingSystem.UpdateAdaptiveCookingThreads();
+
+		// Keep the memory used by the cooking log flat by compressing/archiving old outputs.
+		gCookingSystem.UpdateCookingLogStorage();
+
 		// If running without UI, we want to exit when cooking is finished.
 		if (gApp.mNoUI)
 		{
@@ -1465,7 +1513,30 @@ void FileSystem::MonitorDirectoryThread(const Thread& inThread)
 			mIsMonitorDirThreadIdle.Store(true);
 
 			// Wait for some time before checking the USN journals again (unless we're being signaled).
-			(void)mMonitorDirThreadSignal.WaitFor(gSecondsToTicks(1.0));
+			// If some commands are waiting for their inputs to settle, don't wait longer than necessary to queue them.
+			int64 wait_ticks = gSecondsToTicks(1.0);
+			if (next_debounce_ticks != 0)
+				wait_ticks = gClamp(next_debounce_ticks - gGetTickCount(), (int64)0, wait_ticks);
+
+			// Same for the next timer.
+			{
+				LockGuard lock(mTimersMutex);
+
+				int64 now_ms       = sGetTimerTimeMs();
+				int64 next_wake_ms = mTimers.GetNextWakeUpTime();
+				if (next_wake_ms != 0)
+					wait_ticks = gClamp(gMillisecondsToTicks((double)(next_wake_ms - now_ms)), (int64)0, wait_ticks);
+
+				// Timers added before that time don't need to wake the thread up.
+				mTimersWakeUpMs = now_ms + (int64)gTicksToMilliseconds(wait_ticks);
+			}
+
+			(void)mMonitorDirThreadSignal.WaitFor(wait_ticks);
+
+			{
+				LockGuard lock(mTimersMutex);
+				mTimersWakeUpMs = 0;
+			}
 
 			// Not idle anymore.
 			mIsMonitorDirThreadIdle.Store(false);
@@ -1480,10 +1551,118 @@ void FileSystem::MonitorDirectoryThread(const Thread& inThread)
 
 void FileSystem::RescanLater(FileID inFileID)
 {
-	constexpr double cFileRescanDelayMS = 300.0; // In milliseconds.
+	// Try again quickly first, then back off exponentially if the file stays in use (eg. a large file being written).
+	constexpr double cFirstRescanDelay = 0.3; // In seconds.
+	constexpr double cMaxRescanDelay   = 10.0;
+
+	MonitorTimer timer = MonitorTimer::Rescan(inFileID);
+	double       delay;
+	{
+		LockGuard lock(mTimersMutex);
+
+		// Already scheduled, don't push it back.
+		if (mTimers.Contains(timer))
+			return;
+
+		int  attempts = 0;
+		auto it       = mRescanAttempts.Find(inFileID);
+		if (it != mRescanAttempts.End())
+			attempts = ++it->mValue;
+		else
+			mRescanAttempts.Insert(inFileID, 0);
+
+		delay = gMin(cFirstRescanDelay * (double)(1 << gMin(attempts, 8)), cMaxRescanDelay);
+	}
+
+	AddTimer(timer, delay);
+}
+
+
+void FileSystem::AddTimer(MonitorTimer inTimer, double inDelaySeconds)
+{
+	int64 deadline_ms = sGetTimerTimeMs() + (int64)(inDelaySeconds * 1000.0);
+	bool  kick        = false;
+	{
+		LockGuard lock(mTimersMutex);
+
+		if (mTimers.Add(inTimer, deadline_ms))
+			mTimerCount[(int)inTimer.mType]++;
+
+		// Only wake the monitor thread up if it's sleeping past the deadline.
+		kick = deadline_ms < mTimersWakeUpMs;
+	}
 
-	LockGuard lock(mFilesToRescanMutex);
-	mFilesToRescan.PushBack({ inFileID, gGetTickCount() + gMillisecondsToTicks(cFileRescanDelayMS) });
+	if (kick)
+		KickMonitorDirectoryThread();
+}
+
+
+void FileSystem::RemoveTimer(MonitorTimer inTimer)
+{
+	LockGuard lock(mTimersMutex);
+
+	if (mTimers.Remove(inTimer))
+		mTimerCount[(int)inTimer.mType]--;
+}
+
+
+int FileSystem::GetTimerCount(MonitorTimer::Type inType) const
+{
+	LockGuard lock(mTimersMutex);
+	return mTimerCount[(int)inType];
+}
+
+
+bool FileSystem::ProcessTimers(ScanQueue& ioScanQueue, Span<uint8> ioBufferScan)
+{
+	TempVector<MonitorTimer> expired_timers;
+	{
+		LockGuard lock(mTimersMutex);
+		mTimers.Advance(sGetTimerTimeMs(), [&](MonitorTimer inTimer)
+		{
+			expired_timers.PushBack(inTimer);
+			mTimerCount[(int)inTimer.mType]--;
+		});
+	}
+
+	// Handle them outside the lock, they can add timers again.
+	for (MonitorTimer timer : expired_timers)
+	{
+		switch (timer.mType)
+		{
+		case MonitorTimer::Type::Rescan:
+		{
+			FileID    file_id = timer.GetFileID();
+			FileRepo& repo    = file_id.GetRepo();
+			if (file_id.GetFile().IsDirectory())
+			{
+				FileID dir_id = file_id;
+				do
+				{
+					repo.ScanDirectory(dir_id, ioScanQueue, ioBufferScan);
+				} while ((dir_id = ioScanQueue.Pop()) != FileID::cInvalid());
+			}
+			else
+			{
+				repo.ScanFile(file_id.GetFile(), FileRepo::RequestedAttributes::All);
+			}
+
+			// If it didn't fail again, reset the backoff.
+			LockGuard lock(mTimersMutex);
+			if (!mTimers.Contains(timer))
+				mRescanAttempts.Erase(file_id);
+			break;
+		}
+		case MonitorTimer::Type::OutputTimeOut:
+			gCookingSystem.TimeOutLogEntry(timer.GetLogEntryID());
+			break;
+		default:
+			gAssert(false);
+			break;
+		}
+	}
+
+	return !expired_timers.Empty();
 }
 
 
@@ -1508,19 +1687,20 @@ struct SerializedCommand
 	uint64   mLastCookUSN     : 63 = 0;
 	uint64   mLastCookIsError : 1  = 0;
 	FileTime mLastCookTime         = {};
+	uint64   mLastCookFingerprint  = 0;
 };
-static_assert(sizeof(SerializedCommand) == 32);
+static_assert(sizeof(SerializedCommand) == 40);
 
 struct SerializedDepFileHeader
 {
-	USN      mLastDepFileRead    = 0;
-	uint32   mDepFileInputCount  = 0;
-	uint32   mDepFileOutputCount = 0;
+	USN      mLastDepFileRead     = 0;
+	uint32   mDepFileInputsIndex  = 0; // Index in the list of dep file sets. Zero is the empty set.
+	uint32   mDepFileOutputsIndex = 0;
 };
 static_assert(sizeof(SerializedDepFileHeader) == 16);
 
 
-constexpr int        cCacheFormatVersion = 5;
+constexpr int        cCacheFormatVersion = 8;
 constexpr StringView cCacheFileName      = "cache.bin";
 
 void FileSystem::LoadCache()
@@ -1734,10 +1914,39 @@ void FileSystem::LoadCache()
 	struct ErroredCommand
 	{
 		CookingCommandID mCommandID;
-		StringView       mLastCookOutput;
+		StringView       mLastCookOutput; // Points inside the reader buffer.
 	};
 	Vector<ErroredCommand> errored_commands;
 
+	// Read the dep file sets. They're shared by all the commands that have the same dep file inputs/outputs.
+	Vector<Vector<FileID>> dep_file_sets;
+	dep_file_sets.Resize(1); // Zero is the empty set.
+	if (bin.ExpectLabel("DEPFILESETS"))
+	{
+		uint32 set_count = 0;
+		bin.Read(set_count);
+
+		for (int set_index = 0; set_index < (int)set_count && !bin.mError; ++set_index)
+		{
+			uint32 file_count = 0;
+			bin.Read(file_count);
+
+			Vector<FileID>& files = dep_file_sets.EmplaceBack();
+			files.Reserve(file_count);
+
+			for (int file_index = 0; file_index < (int)file_count; ++file_index)
+			{
+				PathHash path_hash;
+				bin.Read(path_hash);
+
+				// Files that don't exist anymore are skipped, if it makes two sets identical, they'll be merged when applied.
+				FileID file_id = FindFileIDByPathHash(path_hash);
+				if (file_id.IsValid())
+					files.PushBack(file_id);
+			}
+		}
+	}
+
 	// Read the commands.
 	int	   total_commands = 0;
 	uint16 rule_count	  = 0;
@@ -1758,12 +1967,19 @@ void FileSystem::LoadCache()
 		uint16 rule_version = 0;
 		bin.Read(rule_version);
 
+		RuleResourceUsage rule_resource_usage;
+		bin.Read(rule_resource_usage);
+
 		uint32 command_count = 0;
 		bin.Read(command_count);
 
 		const CookingRule* rule       = gCookingSystem.FindRule(rule_name);
 		const bool         rule_valid = (rule != nullptr);
 
+		// Keep accumulating the resources used by the rule, even if its version changed.
+		if (rule_valid)
+			gCookingSystem.SetRuleResourceUsage(rule->mID, rule_resource_usage);
+
 		if (rule_valid)
 			total_commands += (int)command_count;
 
@@ -1790,6 +2006,7 @@ void FileSystem::LoadCache()
 					command->mLastCookUSN         = (USN)serialized_command.mLastCookUSN;
 					command->mLastCookTime        = serialized_command.mLastCookTime;
 					command->mLastCookRuleVersion = rule_version;
+					command->mLastCookFingerprint = serialized_command.mLastCookFingerprint;
 				}
 			}
 
@@ -1798,7 +2015,7 @@ void FileSystem::LoadCache()
 			{
 				// If the rule/command are valid, also read the last cooking log output, otherwise skip it.
 				if (command)
-					errored_commands.PushBack({ command->mID, bin.Read(gCookingSystem.GetStringPool()) });
+					errored_commands.PushBack({ command->mID, bin.ReadView() });
 				else
 					bin.SkipString();
 			}
@@ -1808,34 +2025,17 @@ void FileSystem::LoadCache()
 				SerializedDepFileHeader serialized_dep_file;
 				bin.Read(serialized_dep_file);
 
-				Vector<FileID> inputs, outputs;
-				inputs.Reserve(serialized_dep_file.mDepFileInputCount);
-				inputs.Reserve(serialized_dep_file.mDepFileOutputCount);
-
-				for (int input_index = 0; input_index < (int)serialized_dep_file.mDepFileInputCount; ++input_index)
-				{
-					PathHash path_hash;
-					bin.Read(path_hash);
-
-					FileID input_file = FindFileIDByPathHash(path_hash);
-					if (input_file.IsValid())
-						inputs.PushBack(input_file);
-				}
-
-				for (int output_index = 0; output_index < (int)serialized_dep_file.mDepFileOutputCount; ++output_index)
+				if (serialized_dep_file.mDepFileInputsIndex >= (uint32)dep_file_sets.Size() ||
+					serialized_dep_file.mDepFileOutputsIndex >= (uint32)dep_file_sets.Size())
 				{
-					PathHash path_hash;
-					bin.Read(path_hash);
-
-					FileID output_file = FindFileIDByPathHash(path_hash);
-					if (output_file.IsValid())
-						outputs.PushBack(output_file);
+					bin.mError = true;
+					break;
 				}
 
 				if (rule_valid && rule->UseDepFile() && command != nullptr)
 				{
 					command->mLastDepFileRead = serialized_dep_file.mLastDepFileRead;
-					gApplyDepFileContent(*command, inputs, outputs);
+					gApplyDepFileContent(*command, dep_file_sets[serialized_dep_file.mDepFileInputsIndex], dep_file_sets[serialized_dep_file.mDepFileOutputsIndex]);
 				}
 			}
 		}
@@ -1855,7 +2055,12 @@ void FileSystem::LoadCache()
 
 			CookingLogEntry& log_entry = gCookingSystem.AllocateCookingLogEntry(command_id);
 			log_entry.mTimeStart       = command.mLastCookTime;
-			log_entry.mOutput          = output_log;
+
+			// Only keep a part of the output in memory if it's too large, like for the outputs of new cooks.
+			TempString shrunk_output_storage;
+			StringView output = gSpillCookOutput(output_log, shrunk_output_storage, log_entry.mFullOutput);
+			gCookingSystem.SetLogEntryOutput(log_entry, output);
+
 			log_entry.mCookingState.Store(CookingState::Error);
 
 			command.mLastCookingLog    = &log_entry;
@@ -1992,14 +2197,64 @@ void FileSystem::SaveCache()
 		if (command.IsCleanedUp())
 			continue;
 
-		// Skip commands that didn't cook since the rule version changed.
+		// Skip commands that didn't cook since the rule version (or the command itself) changed.
 		// They are dirty and not saving them will make them appear dirty when we restart.
-		if (command.mLastCookRuleVersion != command.GetRule().mVersion)
+		if (command.mLastCookRuleVersion != command.GetRule().mVersion || command.mLastCookFingerprint != command.mFingerprint)
 			continue;
 
 		commands_per_rule[command.mRuleID.mIndex].PushBack(command.mID);
 	}
 
+	// Gather the dep file sets used by these commands.
+	// Many commands share the same sets, write each one only once and make the commands refer to them by index.
+	const FileSetPool&    dep_file_set_pool = gCookingSystem.GetDepFileSets();
+	TempVector<uint32>    dep_file_set_indices;  // Serialized index of each set of the pool (zero if not serialized).
+	TempVector<FileSetID> dep_file_sets;
+	dep_file_set_indices.Resize(dep_file_set_pool.GetIndexEnd(), 0);
+
+	auto get_dep_file_set_index = [&](FileSetID inSetID)
+	{
+		if (inSetID.IsEmpty())
+			return 0u;
+
+		uint32& index = dep_file_set_indices[inSetID.mIndex];
+		if (index == 0)
+		{
+			dep_file_sets.PushBack(inSetID);
+			index = (uint32)dep_file_sets.Size(); // Zero is the empty set, so start at one.
+		}
+		return index;
+	};
+
+	for (const CookingRule& rule : rules)
+	{
+		if (!rule.UseDepFile())
+			continue;
+
+		for (CookingCommandID command_id : commands_per_rule[rule.mID.mIndex])
+		{
+			const CookingCommand& command = gCookingSystem.GetCommand(command_id);
+			get_dep_file_set_index(command.mDepFileInputs);
+			get_dep_file_set_index(command.mDepFileOutputs);
+		}
+	}
+
+	// Write the dep file sets.
+	bin.WriteLabel("DEPFILESETS");
+	bin.Write((uint32)dep_file_sets.Size());
+	for (FileSetID set_id : dep_file_sets)
+	{
+		Span files = dep_file_set_pool.Get(set_id);
+		bin.Write((uint32)files.Size());
+
+		for (FileID file_id : files)
+		{
+			const FileInfo& file = file_id.GetFile();
+			PathHash path_hash = gHashPath(gConcat(file.GetRepo().mRootPath, file.mPath));
+			bin.Write(path_hash);
+		}
+	}
+
 	// Write the commands, sorted by rule.
 	bin.Write((uint16)rules.Size());
 	for (const CookingRule& rule : rules)
@@ -2009,6 +2264,7 @@ void FileSystem::SaveCache()
 		bin.Write(rule.mName);
 		bin.Write(rule.UseDepFile());
 		bin.Write(rule.mVersion);
+		bin.Write(gCookingSystem.GetRuleResourceUsage(rule.mID));
 
 		Span commands = commands_per_rule[rule.mID.mIndex];
 		bin.Write((uint32)commands.Size());
@@ -2022,17 +2278,22 @@ void FileSystem::SaveCache()
 			// Write the base command data.
 			SerializedCommand     serialized_command;
 			const FileInfo&       main_input      = command.GetMainInput().GetFile();
-			serialized_command.mMainInputPathHash = gHashPath(gConcat(main_input.GetRepo().mRootPath, main_input.mPath));
-			serialized_command.mLastCookUSN       = command.mLastCookUSN;
-			serialized_command.mLastCookIsError   = (command.mDirtyState & CookingCommand::Error) != 0;
-			serialized_command.mLastCookTime      = command.mLastCookTime;
+			serialized_command.mMainInputPathHash   = gHashPath(gConcat(main_input.GetRepo().mRootPath, main_input.mPath));
+			serialized_command.mLastCookUSN         = command.mLastCookUSN;
+			serialized_command.mLastCookIsError     = (command.mDirtyState & CookingCommand::Error) != 0;
+			serialized_command.mLastCookTime        = command.mLastCookTime;
+			serialized_command.mLastCookFingerprint = command.mLastCookFingerprint;
 			bin.Write(serialized_command);
 
 			// If the command had an error, also write the last cooking log output.
 			if (serialized_command.mLastCookIsError)
 			{
-				if (command.mLastCookingLog)
-					bin.Write(command.mLastCookingLog->mOutput);
+				// Write the full output if it was spilled to the session output file.
+				String output;
+				if (command.mLastCookingLog && command.mLastCookingLog->mFullOutput.IsValid() && gReadCookOutput(command.mLastCookingLog->mFullOutput, output))
+					bin.Write(output);
+				else if (command.mLastCookingLog && gCookingSystem.ReadLogEntryOutput(*command.mLastCookingLog, output))
+					bin.Write(output);
 				else
 					bin.Write("No output recorded."); // Can this case happen? Probably not, but better be safe.
 			}
@@ -2041,24 +2302,10 @@ void FileSystem::SaveCache()
 			if (rule.UseDepFile())
 			{
 				SerializedDepFileHeader serialized_dep_file;
-				serialized_dep_file.mLastDepFileRead    = command.mLastDepFileRead;
-				serialized_dep_file.mDepFileInputCount  = (uint32)command.mDepFileInputs.Size();
-				serialized_dep_file.mDepFileOutputCount = (uint32)command.mDepFileOutputs.Size();
+				serialized_dep_file.mLastDepFileRead     = command.mLastDepFileRead;
+				serialized_dep_file.mDepFileInputsIndex  = get_dep_file_set_index(command.mDepFileInputs);
+				serialized_dep_file.mDepFileOutputsIndex = get_dep_file_set_index(command.mDepFileOutputs);
 				bin.Write(serialized_dep_file);
-
-				for (FileID file_id : command.mDepFileInputs)
-				{
-					const FileInfo& file = file_id.GetFile();
-					PathHash path_hash = gHashPath(gConcat(file.GetRepo().mRootPath, file.mPath));
-					bin.Write(path_hash);
-				}
-
-				for (FileID file_id : command.mDepFileOutputs)
-				{
-					const FileInfo& file = file_id.GetFile();
-					PathHash path_hash = gHashPath(gConcat(file.GetRepo().mRootPath, file.mPath));
-					bin.Write(path_hash);
-				}
 			}
 		}
 	}
@@ -2086,4 +2333,58 @@ REGISTER_TEST("USNToString")
 	TEST_TRUE(gUSNToString(12'345) == "12'345");
 	TEST_TRUE(gUSNToString(123'456) == "123'456");
 	TEST_TRUE(gUSNToString(1'234'567) == "1'234'567");
-};
\ No newline at end of file
+};
+
+REGISTER_TEST("TimerWheel")
+{
+	TimerWheel<int> wheel(10);
+	TempVector<int> expired;
+	auto            on_expired = [&](int inKey) { expired.PushBack(inKey); };
+
+	wheel.Advance(100'000, on_expired);
+
+	wheel.Add(1, 100'050);
+	wheel.Add(2, 100'500);
+	wheel.Add(3, 200'000); // Further than the first levels, needs to be cascaded.
+	wheel.Add(4, 100'050);
+	TEST_TRUE(wheel.Size() == 4);
+	TEST_TRUE(wheel.GetNextWakeUpTime() <= 100'050);
+
+	// Moving and removing timers.
+	TEST_TRUE(wheel.Add(4, 100'600) == false);
+	TEST_TRUE(wheel.Remove(2));
+	TEST_TRUE(wheel.Remove(2) == false);
+
+	wheel.Advance(100'049, on_expired);
+	TEST_TRUE(expired.Empty());
+
+	wheel.Advance(100'050, on_expired);
+	TEST_TRUE(expired.Size() == 1 && expired[0] == 1);
+
+	wheel.Advance(100'599, on_expired);
+	TEST_TRUE(expired.Size() == 1);
+
+	wheel.Advance(100'600, on_expired);
+	TEST_TRUE(expired.Size() == 2 && expired[1] == 4);
+
+	for (int64 time = 100'600; time < 200'000; time += 1000)
+		wheel.Advance(time, on_expired);
+	TEST_TRUE(expired.Size() == 2);
+
+	wheel.Advance(200'000, on_expired);
+	TEST_TRUE(expired.Size() == 3 && expired[2] == 3);
+	TEST_TRUE(wheel.IsEmpty());
+	TEST_TRUE(wheel.GetNextWakeUpTime() == 0);
+
+	// A timer in a higher level can be due before the first timer in level 0.
+	TimerWheel<int> wheel2(1);
+	expired.Clear();
+
+	wheel2.Add(5, 70);   // Goes to level 1, cascaded at slot 64.
+	wheel2.Advance(60, on_expired);
+	wheel2.Add(6, 120);  // Goes to level 0.
+	TEST_TRUE(wheel2.GetNextWakeUpTime() <= 70);
+
+	wheel2.Advance(70, on_expired);
+	TEST_TRUE(expired.Size() == 1 && expired[0] == 5);
+};
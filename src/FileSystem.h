@@ -7,7 +7,9 @@
 #include "Core.h"
 #include "StringPool.h"
 #include "CookingSystemIDs.h"
+#include "CommandEdgeList.h"
 #include "Queue.h"
+#include "TimerWheel.h"
 #include "SyncSignal.h"
 #include "FileUtils.h"
 #include "FileTime.h"
@@ -154,6 +156,34 @@ template <> struct Hash<FileID>
 	uint64 operator()(FileID inID) const { return gHash(inID.AsUInt()); }
 };
 
+
+// Timer handled by the monitor directory thread.
+struct MonitorTimer
+{
+	enum class Type : uint8
+	{
+		Rescan,			// Scan a file again (eg. because it was in use). The value is a FileID.
+		OutputTimeOut,	// Declare a command still waiting for its outputs in error. The value is a CookingLogEntryID.
+		_Count,
+	};
+
+	Type   mType  = Type::Rescan;
+	uint32 mValue = 0;
+
+	static MonitorTimer Rescan(FileID inFileID)                     { return { Type::Rescan, inFileID.AsUInt() }; }
+	static MonitorTimer OutputTimeOut(CookingLogEntryID inLogEntry) { return { Type::OutputTimeOut, inLogEntry.mIndex }; }
+
+	FileID              GetFileID() const                           { gAssert(mType == Type::Rescan); FileID id; memcpy(&id, &mValue, sizeof(id)); return id; }
+	CookingLogEntryID   GetLogEntryID() const                       { gAssert(mType == Type::OutputTimeOut); return { mValue }; }
+
+	auto operator<=>(const MonitorTimer& inOther) const = default;
+};
+
+template <> struct Hash<MonitorTimer>
+{
+	uint64 operator()(MonitorTimer inTimer) const { return gHash(((uint64)inTimer.mType << 32) | inTimer.mValue); }
+};
+
 enum class FileType : int
 {
 	File,
@@ -177,8 +207,8 @@ struct FileInfo : NoCopy
 	USN                           mLastChangeUSN  = 0;  // Identifier of the last change to this file.
 	FileTime                      mLastChangeTime = {}; // Time of the last change to this file.
 
-	Vector<CookingCommandID>      mInputOf;             // List of commands that use this file as input.
-	Vector<CookingCommandID>      mOutputOf;            // List of commands that use this file as output. There should be only one, otherwise it's an error. // TODO tiny vector optimization // TODO actually detect that error
+	CommandEdgeList               mInputOf;             // List of commands that use this file as input.
+	CommandEdgeList               mOutputOf;            // List of commands that use this file as output. There should be only one, otherwise it's an error. // TODO actually detect that error
 
 	bool                          IsDeleted() const { return !mRefNumber.IsValid(); }
 	bool                          IsDirectory() const { return mIsDirectory; }
@@ -258,6 +288,7 @@ struct FileRepo : NoCopy
 	FileInfo&			GetFile(FileID inFileID)		{ gAssert(inFileID.mRepoIndex == mIndex); return mFiles[inFileID.mFileIndex]; }
 	const FileInfo&		GetFile(FileID inFileID) const	{ gAssert(inFileID.mRepoIndex == mIndex); return mFiles[inFileID.mFileIndex]; }
 	FileInfo&           GetOrAddFile(StringView inPath, FileType inType, FileRefNumber inRefNumber);
+	FileInfo&           GetOrAddFile(StringView inPath, PathHash inPathHash, FileType inType, FileRefNumber inRefNumber); // Same, with the hash of the full path already computed (see gHashPath). inPath must be normalized.
 	void                MarkFileDeleted(FileInfo& ioFile, FileTime inTimeStamp);
 	void                MarkFileDeleted(FileInfo& ioFile, FileTime inTimeStamp, const LockGuard<Mutex>& inLock);
 
@@ -298,6 +329,7 @@ struct FileDrive : NoCopy
 	HandleOrError          OpenFileByRefNumber(FileRefNumber inRefNumber, OpenFileAccess inDesiredAccess, FileID inFileID) const;
 	[[nodiscard]] bool     GetFullPath(const OwnedHandle& inFileHandle, TempString& outFullPath) const;   // Get the full path of this file, including the drive letter part. Return true on succes.
 	USN                    GetUSN(const OwnedHandle& inFileHandle) const;
+	[[nodiscard]] bool     GetUSN(const OwnedHandle& inFileHandle, USN& outUSN, FileRefNumber& outRefNumber) const; // Same as above but doesn't fail fatally. Return true on success.
 
 	FileID                 FindFileID(FileRefNumber inRefNumber) const;                                   // Return an invalid FileID if not found.
 
@@ -345,6 +377,10 @@ struct FileSystem : NoCopy
 
 	void			KickMonitorDirectoryThread();
 
+	void            AddTimer(MonitorTimer inTimer, double inDelaySeconds); // Move the deadline if the timer already exists.
+	void            RemoveTimer(MonitorTimer inTimer);
+	int             GetTimerCount(MonitorTimer::Type inType) const;
+
 	enum class InitState
 	{
 		NotInitialized,
@@ -365,6 +401,7 @@ private:
 	void			MonitorDirectoryThread(const Thread& ioThread);
 
 	void            RescanLater(FileID inFileID);
+	bool            ProcessTimers(ScanQueue& ioScanQueue, Span<uint8> ioBufferScan); // Return true if any timer expired.
 
 	FileDrive&		GetOrAddDrive(char inDriveLetter);
 
@@ -375,6 +412,8 @@ private:
 
 	VMemArray<FileRepo>        mRepos  = { 10_MiB, gVMemCommitGranularity() };
 	VMemArray<FileDrive>       mDrives = { 10_MiB, gVMemCommitGranularity() };        // All the drives that have at least one repo on them.
+	HashMap<uint64, uint32>    mRepoIndexByRootPath;                                   // Key is the hash of the lowercase root path. See FindRepoByPath.
+	Vector<int>                mRepoRootPathSizes;                                     // All the different sizes of root paths, sorted.
 
 	Atomic<InitState>          mInitState = InitState::NotInitialized;
 	struct InitStats
@@ -389,14 +428,12 @@ private:
 	SyncSignal                 mMonitorDirThreadSignal;
 	AtomicBool                 mIsMonitorDirThreadIdle = true;
 
-	struct FileToRescan
-	{
-		FileID mFileID;         // The file to re-scan (can be a directory).
-		int64  mWaitUntilTicks; // The time to wait before re-scanning the file.
-	};
-
-	Queue<FileToRescan> mFilesToRescan;
-	Mutex               mFilesToRescanMutex;
+	// Timers are in milliseconds since the tick count can only be converted at runtime.
+	TimerWheel<MonitorTimer> mTimers = TimerWheel<MonitorTimer>(10);
+	int                      mTimerCount[(int)MonitorTimer::Type::_Count] = {};
+	int64                    mTimersWakeUpMs   = 0;	// When the monitor thread will wake up if not kicked, to know if it needs to be kicked for a new timer.
+	HashMap<FileID, int>     mRescanAttempts;		// Number of consecutive rescans of a file, for the exponential backoff.
+	mutable Mutex            mTimersMutex;
 
 	using FilesByPathHash = VMemHashMap<PathHash, FileID>;
 	FilesByPathHash mFilesByPathHash;      // Map to find files by path hash.
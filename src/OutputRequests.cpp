@@ -0,0 +1,213 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include "OutputRequests.h"
+#include "App.h"
+#include "CookingSystem.h"
+#include "Debug.h"
+#include "FileUtils.h"
+#include <Bedrock/Thread.h>
+#include <Bedrock/Event.h>
+#include <Bedrock/StringFormat.h>
+#include <Bedrock/Ticks.h>
+
+#include "win32/file.h"
+#include "win32/io.h"
+#include "win32/misc.h"
+#include "win32/threads.h"
+
+
+// Add one output path per line. Relative paths are relative to the working directory.
+static void sAddRequestedPaths(StringView inText, OutputRequest& ioRequest)
+{
+	while (!inText.Empty())
+	{
+		int        line_end = inText.Find('\n');
+		StringView line     = (line_end == -1) ? inText : inText.SubStr(0, line_end);
+		inText              = (line_end == -1) ? StringView() : inText.SubStr(line_end + 1);
+
+		gRemoveLeading(line, " \t\r");
+		gRemoveTrailing(line, " \t\r");
+
+		if (line.Empty())
+			continue;
+
+		TempString path = gGetAbsolutePath(TempString(line));
+		ioRequest.mPaths.PushBack(path);
+	}
+}
+
+
+// The request from the command line. Only logged when ready, nobody waits for it.
+static OutputRequest sCommandLineRequest;
+
+
+void gRequestOutputsFromFile(StringView inPath)
+{
+	FILE* file = fopen(inPath.AsCStr(), "rb");
+	if (file == nullptr)
+	{
+		gAppLogError(R"(Failed to open requested outputs file "%s" - %s (0x%X))", inPath.AsCStr(), strerror(errno), errno);
+		return;
+	}
+
+	defer { fclose(file); };
+
+	TempString text;
+	char       buffer[4096];
+	size_t     bytes_read;
+	while ((bytes_read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		text += StringView(buffer, (int)bytes_read);
+
+	sAddRequestedPaths(text, sCommandLineRequest);
+
+	gAppLog(R"(Requesting %d outputs from "%s".)", sCommandLineRequest.mPaths.Size(), inPath.AsCStr());
+
+	gCookingSystem.RequestOutputs(sCommandLineRequest);
+}
+
+
+static OwnedHandle sServerPipe;
+static Thread      sServerThread;
+static Event       sServerStopEvent = { Event::ManualReset }; // Used to interrupt the pipe operations when stopping.
+
+
+// Wait for an overlapped operation on the pipe. Return false if it failed or if the server is stopping.
+static bool sWaitForOverlapped(HANDLE inPipe, BOOL inStartResult, OVERLAPPED& ioOverlapped, DWORD& outBytes)
+{
+	outBytes = 0;
+
+	if (!inStartResult && GetLastError() != ERROR_IO_PENDING)
+		return false;
+
+	HANDLE handles[] = { ioOverlapped.hEvent, sServerStopEvent.GetOSHandle() };
+	if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0)
+	{
+		// Stopping. The OVERLAPPED must stay valid until the operation is actually canceled.
+		CancelIoEx(inPipe, &ioOverlapped);
+		(void)GetOverlappedResult(inPipe, &ioOverlapped, &outBytes, TRUE);
+		return false;
+	}
+
+	return GetOverlappedResult(inPipe, &ioOverlapped, &outBytes, FALSE);
+}
+
+
+// Handle one client: read the requested paths until an empty line, wait until they are cooked, write the result.
+static void sServeClient(HANDLE inPipe, OVERLAPPED& ioOverlapped)
+{
+	constexpr int cMaxRequestSize = 1024 * 1024;
+
+	TempString request_text;
+	char       buffer[4096];
+
+	while (true)
+	{
+		DWORD bytes_read;
+		BOOL  result = ReadFile(inPipe, buffer, sizeof(buffer), nullptr, &ioOverlapped);
+		if (!sWaitForOverlapped(inPipe, result, ioOverlapped, bytes_read))
+			break; // Client is done writing (or gone).
+
+		request_text += StringView(buffer, (int)bytes_read);
+
+		// An empty line marks the end of the request.
+		if (gEndsWith(request_text, "\n\n") || gEndsWith(request_text, "\r\n\r\n"))
+			break;
+
+		if (request_text.Size() > cMaxRequestSize)
+		{
+			gAppLogError("Output request is too large (more than %d bytes), ignored.", cMaxRequestSize);
+			return;
+		}
+	}
+
+	OutputRequest request;
+	sAddRequestedPaths(request_text, request);
+
+	if (request.mPaths.Empty())
+		return;
+
+	gCookingSystem.RequestOutputs(request);
+
+	while (request.mDoneSignal.WaitFor(gMillisecondsToTicks(100.0)) == SyncSignal::WaitResult::Timeout)
+	{
+		if (sServerThread.IsStopRequested())
+		{
+			gCookingSystem.CancelOutputRequest(request);
+			return;
+		}
+	}
+
+	TempString reply;
+	for (const String& path : request.mUnknownPaths)
+		gAppendFormat(reply, "UNKNOWN %s\n", path.AsCStr());
+	gAppendFormat(reply, "DONE %d %d\n", request.mCommands.Size(), request.mErrorCount);
+
+	DWORD bytes_written;
+	BOOL  result = WriteFile(inPipe, reply.Data(), reply.Size(), nullptr, &ioOverlapped);
+	if (!sWaitForOverlapped(inPipe, result, ioOverlapped, bytes_written))
+		return;
+
+	// Wait for the client to close its end before disconnecting, disconnecting would discard the reply if it's not read yet.
+	DWORD bytes_read;
+	result = ReadFile(inPipe, buffer, sizeof(buffer), nullptr, &ioOverlapped);
+	(void)sWaitForOverlapped(inPipe, result, ioOverlapped, bytes_read);
+}
+
+
+void gStartOutputRequestServer(StringView inPipeName)
+{
+	TempString pipe_path = gTempFormat(R"(\\.\pipe\%s)", inPipeName.AsCStr());
+
+	sServerPipe = CreateNamedPipeA(pipe_path.AsCStr(),
+		PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+		PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+		1,			// Clients are served one at a time.
+		4096, 4096,	// Buffer sizes.
+		0,			// Default timeout.
+		nullptr);
+
+	if (!sServerPipe.IsValid())
+	{
+		gAppLogError(R"(Failed to create output request pipe "%s" - %s)", pipe_path.AsCStr(), GetLastErrorString().AsCStr());
+		return;
+	}
+
+	gAppLog(R"(Listening for output requests on "%s".)", pipe_path.AsCStr());
+
+	sServerThread.Create({
+		.mName        = "Output Request Thread",
+		.mTempMemSize = 1_MiB,
+	}, [](Thread& ioThread)
+	{
+		Event      io_event   = { Event::ManualReset };
+		OVERLAPPED overlapped = {};
+		overlapped.hEvent     = io_event.GetOSHandle();
+
+		while (!ioThread.IsStopRequested())
+		{
+			// Wait for a client to connect.
+			// Note: if it connected before the call, ConnectNamedPipe fails with ERROR_PIPE_CONNECTED and there is nothing to wait for.
+			DWORD unused_bytes;
+			BOOL  result    = ConnectNamedPipe(sServerPipe, &overlapped);
+			bool  connected = (!result && GetLastError() == ERROR_PIPE_CONNECTED) || sWaitForOverlapped(sServerPipe, result, overlapped, unused_bytes);
+
+			if (connected)
+				sServeClient(sServerPipe, overlapped);
+
+			DisconnectNamedPipe(sServerPipe);
+		}
+	});
+}
+
+
+void gStopOutputRequestServer()
+{
+	sServerThread.RequestStop();
+	sServerStopEvent.Set();
+	sServerThread.Join();
+
+	sServerPipe = {};
+}
@@ -0,0 +1,16 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include "Core.h"
+#include "Strings.h"
+
+// Request the outputs listed in a text file (one path per line) to be cooked first.
+void gRequestOutputsFromFile(StringView inPath);
+
+// Named pipe letting clients (eg. a game) request outputs and wait until they are cooked. See Readme for the protocol.
+void gStartOutputRequestServer(StringView inPipeName);
+void gStopOutputRequestServer();
@@ -0,0 +1,355 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include "PathPattern.h"
+#include "FileUtils.h"
+#include "Strings.h"
+#include <Bedrock/Test.h>
+#include <Bedrock/Ticks.h>
+#include <Bedrock/Trace.h>
+
+
+static constexpr char sToLower(char inChar)
+{
+	return (inChar >= 'A' && inChar <= 'Z') ? (char)(inChar - 'A' + 'a') : inChar;
+}
+
+
+void PathPattern::Compile(StringView inPattern)
+{
+	gAssert(gIsNormalized(inPattern));
+
+	mChars.Clear();
+	mSegments.Clear();
+	mSkipTables.Clear();
+	mHasStar = false;
+
+	mChars.Reserve(inPattern.Size());
+
+	Segment current;
+	for (char c : inPattern)
+	{
+		if (c == '*')
+		{
+			// '**' is equivalent to '*', don't add empty segments in the middle.
+			if (!mHasStar || current.mSize > 0)
+				mSegments.PushBack(current);
+
+			mHasStar       = true;
+			current        = {};
+			current.mStart = mChars.Size();
+			continue;
+		}
+
+		char lower = sToLower(c);
+		mChars.Append({ &lower, 1 });
+		current.mSize++;
+	}
+	mSegments.PushBack(current);
+
+	// The segments in the middle need to be searched, prepare their skip tables.
+	// Note: '*?' doesn't need any special handling, the '?' are simply part of the next segment.
+	for (int i = 1; i < mSegments.Size() - 1; ++i)
+	{
+		Segment&   segment = mSegments[i];
+		StringView chars   = StringView(mChars).SubStr(segment.mStart, segment.mSize);
+
+		// The table only works for literal segments, the ones with '?' are searched one position at a time.
+		if (chars.FindFirstOf("?") != -1)
+			continue;
+
+		segment.mSkipTableOffset = mSkipTables.Size();
+		mSkipTables.Resize(mSkipTables.Size() + 256);
+
+		uint8* skip_table = mSkipTables.Data() + segment.mSkipTableOffset;
+		for (int c = 0; c < 256; ++c)
+			skip_table[c] = (uint8)gMin(segment.mSize, 255);
+		for (int j = 0; j < segment.mSize - 1; ++j)
+			skip_table[(uint8)chars[j]] = (uint8)gMin(segment.mSize - 1 - j, 255);
+	}
+}
+
+
+bool PathPattern::MatchAt(const char* inPath, const Segment& inSegment) const
+{
+	const char* chars = mChars.Data() + inSegment.mStart;
+	for (int i = 0; i < inSegment.mSize; ++i)
+	{
+		if (chars[i] != '?' && chars[i] != sToLower(inPath[i]))
+			return false;
+	}
+
+	return true;
+}
+
+
+int PathPattern::Find(StringView inPath, int inStart, int inEnd, const Segment& inSegment) const
+{
+	if (inSegment.mSkipTableOffset == -1)
+	{
+		for (int i = inStart; i + inSegment.mSize <= inEnd; ++i)
+			if (MatchAt(inPath.Data() + i, inSegment))
+				return i;
+
+		return -1;
+	}
+
+	// Boyer-Moore-Horspool: check the last character first, and skip ahead by how far it is from the end of the segment.
+	const uint8* skip_table = mSkipTables.Data() + inSegment.mSkipTableOffset;
+	int          last       = inSegment.mSize - 1;
+	char         last_char  = mChars[inSegment.mStart + last];
+
+	for (int i = inStart; i + inSegment.mSize <= inEnd;)
+	{
+		char c = sToLower(inPath[i + last]);
+		if (c == last_char && MatchAt(inPath.Data() + i, inSegment))
+			return i;
+
+		i += skip_table[(uint8)c];
+	}
+
+	return -1;
+}
+
+
+bool PathPattern::Match(StringView inPath) const
+{
+	if (mSegments.Empty())
+		return false; // Not compiled.
+
+	const Segment& head = mSegments.Front();
+	if (!mHasStar)
+		return inPath.Size() == head.mSize && MatchAt(inPath.Data(), head);
+
+	const Segment& tail = mSegments.Back();
+	if (inPath.Size() < head.mSize + tail.mSize)
+		return false;
+
+	// The first and last segments are anchored to the start and end of the path.
+	if (!MatchAt(inPath.Data(), head) || !MatchAt(inPath.Data() + inPath.Size() - tail.mSize, tail))
+		return false;
+
+	// The others only need to be found in order in between. Taking the first occurrence of each is always fine.
+	int pos = head.mSize;
+	int end = inPath.Size() - tail.mSize;
+	for (int i = 1; i < mSegments.Size() - 1; ++i)
+	{
+		const Segment& segment = mSegments[i];
+
+		int found = Find(inPath, pos, end, segment);
+		if (found == -1)
+			return false;
+
+		pos = found + segment.mSize;
+	}
+
+	return true;
+}
+
+
+// Previous matcher, kept as the reference for the tests and the benchmark.
+// Unlike PathPattern, it doesn't anchor the last part of the pattern to the end of the path (eg. "*a.txt" doesn't match "a.txt.a.txt").
+static bool sMatchPathReference(StringView inPath, StringView inPattern)
+{
+	gAssert(!inPattern.Empty());
+	gAssert(gIsNormalized(inPath) && gIsNormalized(inPattern));
+
+	// Convert the path and pattern to lowercase to make sure the search is case-insensitive.
+	TempString path_lowercase = inPath;
+	gToLowercase(path_lowercase);
+	TempString pattern_lowercase = inPattern;
+	gToLowercase(pattern_lowercase);
+
+	StringView str          = path_lowercase;
+	StringView pattern      = pattern_lowercase;
+	bool       pending_star = false;
+
+	while (true)
+	{
+		// Find the next wild card in the pattern.
+		int next_wildcard_index = pattern.FindFirstOf("?*");
+
+		// If the next char isn't a wild card and we have a pending '*', process it now.
+		// This case happens when we encounter '*?'. More explanations where pending_star is set to true below.
+		if (next_wildcard_index != 0 && pending_star)
+		{
+			pending_star = false;
+
+			// If the pattern ends with '*', it's an automatic match.
+			if (pattern.Empty())
+				return true;
+
+			// Find where the string starts matching the pattern again.
+			StringView pattern_until_next_wildcard = pattern.SubStr(0, pattern.FindFirstOf("?*"));
+			int next_match = str.Find(pattern_until_next_wildcard);
+
+			// Never? Then it's a fail.
+			if (next_match == -1)
+				return false;
+
+			// Skip to where it matches again.
+			str.RemovePrefix(next_match);
+		}
+
+		// Strings should be equal until there (or until end of the string).
+		if (str.SubStr(0, next_wildcard_index) != pattern.SubStr(0, next_wildcard_index))
+			return false;
+
+		// If there was no wild card, we're done! Strings match.
+		if (next_wildcard_index == -1)
+			return true;
+
+		// Skip the parts that match.
+		str.RemovePrefix(next_wildcard_index);
+		pattern.RemovePrefix(next_wildcard_index);
+
+		// Also skip the wild card, but keep a copy.
+		char wild_card = pattern[0];
+		pattern.RemovePrefix(1);
+
+		if (wild_card == '?')
+		{
+			// If there is no character left, it's a fail.
+			if (str.Size() < 1)
+				return false;
+
+			// Skip one character.
+			str.RemovePrefix(1);
+		}
+		else
+		{
+			gAssert(wild_card == '*');
+
+			// If the pattern ends with '*', it's an automatic match.
+			if (pattern.Empty())
+				return true;
+
+			// If the * is followed by another '*', continue to process the next wild card directly, '**' is equivalent to '*'.
+			if (pattern[0] == '*')
+				continue;
+
+			// If the '*' is followed by '?', it is THE annoying case.
+			// '*?' is equivalent to '?*', so continue to process the '?', but remember we have a pending '*'.
+			// This way both '*???' and '*?*?*?' will just be interpreted as '???*'.
+			if (pattern[0] == '?')
+			{
+				pending_star = true;
+				continue;
+			}
+
+			// Clear the pending '*' if we encounter another one.
+			pending_star = false;
+
+			// Find where the string starts matching the pattern again.
+			StringView pattern_until_next_wildcard = pattern.SubStr(0, pattern.FindFirstOf("?*"));
+			int next_match = str.Find(pattern_until_next_wildcard);
+
+			// Never? Then it's a fail.
+			if (next_match == -1)
+				return false;
+
+			// Skip to where it matches again.
+			str.RemovePrefix(next_match);
+		}
+	}
+}
+
+
+struct MatchPathTestCase
+{
+	StringView mPath;
+	StringView mPattern;
+	bool       mMatch;
+};
+
+static constexpr MatchPathTestCase cMatchPathTestCases[] =
+{
+	{ "YOYO.txt", "yoyo.txt", true },
+	{ "YOYO.txt", "*.txt", true },
+	{ "YOYO.txt", "y?yo.txt", true },
+	{ "YOYO.txt", "????????", true },
+	{ "YOYO.txt", "*", true },
+	{ "YOYO.txt", "?*", true },
+	{ "YOYO.txt", "**", true },
+	{ "YOYO.txt", "*?", true },
+	{ "YOYO.txt", "*?oyo.txt", true },
+	{ "YOYO.txt", "*????.txt", true },
+	{ "YOYO.txt", "y*?*?*?.txt", true },
+	{ "YOYO.txt", "y*y*.txt", true },
+	{ "YOYO.txt", "y*?.*", true },
+	{ "Y.txt", "y*?.*", false },
+	{ "YOYO.txt", "yoyo.txt*?", false },
+	{ "medium_house\\texture_albedo.png", "*_albedo.*", true },
+};
+
+
+REGISTER_TEST("MatchPathReference")
+{
+	// Make sure temp memory is initialized or the tests will fail (the reference uses temp strings).
+	TEST_INIT_TEMP_MEMORY(10_KiB);
+
+	for (const MatchPathTestCase& test_case : cMatchPathTestCases)
+		TEST_TRUE(sMatchPathReference(test_case.mPath, test_case.mPattern) == test_case.mMatch);
+};
+
+
+REGISTER_TEST("PathPattern")
+{
+	TEST_INIT_TEMP_MEMORY(10_KiB);
+
+	// The reference is the oracle.
+	for (const MatchPathTestCase& test_case : cMatchPathTestCases)
+	{
+		PathPattern pattern;
+		pattern.Compile(test_case.mPattern);
+		TEST_TRUE(pattern.Match(test_case.mPath) == test_case.mMatch);
+		TEST_TRUE(pattern.Match(test_case.mPath) == sMatchPathReference(test_case.mPath, test_case.mPattern));
+	}
+
+	// The only intended difference: the last part of the pattern is anchored to the end of the path.
+	PathPattern pattern;
+	pattern.Compile("*a.txt");
+	TEST_TRUE(pattern.Match("a.txt.a.txt"));
+	TEST_FALSE(sMatchPathReference("a.txt.a.txt", "*a.txt"));
+
+	pattern.Compile("textures\\*\\*_normal.png");
+	TEST_TRUE(pattern.Match("Textures\\Rock\\Rock_Normal.PNG"));
+	TEST_TRUE(pattern.Match("textures\\rock\\big\\rock_normal.png"));
+	TEST_FALSE(pattern.Match("textures\\rock_normal.png"));
+	TEST_FALSE(pattern.Match("textures\\rock\\rock_normal.png.bak"));
+};
+
+
+REGISTER_TEST("PathPattern_Benchmark")
+{
+	TEST_INIT_TEMP_MEMORY(64_KiB);
+
+	constexpr int cIterations = 10000;
+	constexpr int cCaseCount  = (int)gElemCount(cMatchPathTestCases);
+
+	PathPattern patterns[cCaseCount];
+	for (int i = 0; i < cCaseCount; ++i)
+		patterns[i].Compile(cMatchPathTestCases[i].mPattern);
+
+	int   reference_match_count = 0;
+	int64 start_ticks           = gGetTickCount();
+	for (int iteration = 0; iteration < cIterations; ++iteration)
+		for (const MatchPathTestCase& test_case : cMatchPathTestCases)
+			reference_match_count += sMatchPathReference(test_case.mPath, test_case.mPattern);
+	int64 reference_ticks = gGetTickCount() - start_ticks;
+
+	int compiled_match_count = 0;
+	start_ticks = gGetTickCount();
+	for (int iteration = 0; iteration < cIterations; ++iteration)
+		for (int i = 0; i < cCaseCount; ++i)
+			compiled_match_count += patterns[i].Match(cMatchPathTestCases[i].mPath);
+	int64 compiled_ticks = gGetTickCount() - start_ticks;
+
+	// Both agree on every case of the table.
+	TEST_TRUE(reference_match_count == compiled_match_count);
+
+	gTrace("MatchPathReference: %.3fms, PathPattern: %.3fms (%d calls each)",
+		gTicksToMilliseconds(reference_ticks), gTicksToMilliseconds(compiled_ticks), cIterations * cCaseCount);
+};
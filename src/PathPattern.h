@@ -0,0 +1,37 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include "Core.h"
+
+#include <Bedrock/String.h>
+#include <Bedrock/Vector.h>
+
+
+// Path pattern compiled once so that it can be matched against many paths without any allocation.
+// Pattern supports wild cards '*' (any number of characters) and '?' (single character), and matching is case-insensitive (ASCII only).
+struct PathPattern
+{
+	void Compile(StringView inPattern);
+	bool Match(StringView inPath) const;
+
+private:
+	// Part of the pattern between two '*'. Can contain '?'.
+	struct Segment
+	{
+		int  mStart           = 0;	// Position in mChars.
+		int  mSize            = 0;
+		int  mSkipTableOffset = -1;	// Position in mSkipTables, only for the segments that need to be searched.
+	};
+
+	bool MatchAt(const char* inPath, const Segment& inSegment) const;
+	int  Find(StringView inPath, int inStart, int inEnd, const Segment& inSegment) const; // Return -1 if not found.
+
+	String          mChars;			  // Lowercase pattern without the '*'.
+	Vector<Segment> mSegments;		  // The first one has to match at the start of the path, the last one at the end, the others anywhere in between (in order).
+	Vector<uint8>   mSkipTables;	  // Boyer-Moore-Horspool skip table (256 entries) of each searched segment.
+	bool            mHasStar = false; // If false, there is a single segment that must match the whole path.
+};
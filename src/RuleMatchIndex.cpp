@@ -0,0 +1,120 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include "RuleMatchIndex.h"
+#include "CookingSystem.h"
+
+#include <algorithm> // for std::sort, sad!
+
+
+// Get the extension at the end of a path or pattern (without the dot), or an empty string if there isn't one.
+static StringView sGetExtension(StringView inPath)
+{
+	int dot = inPath.FindLastOf(".");
+	if (dot == -1)
+		return {};
+
+	StringView extension = inPath.SubStr(dot + 1);
+	if (extension.FindFirstOf("\\") != -1)
+		return {}; // The dot is in a directory name.
+
+	return extension;
+}
+
+
+void RuleMatchIndex::Build(Span<const CookingRule> inRules)
+{
+	mRepos.Clear();
+
+	for (const CookingRule& rule : inRules)
+	{
+		for (int filter_index = 0; filter_index < rule.mInputFilters.Size(); ++filter_index)
+		{
+			const InputFilter& filter = rule.mInputFilters[filter_index];
+			RuleFilterRef      ref    = { (uint16)rule.mID.mIndex, (uint16)filter_index };
+
+			if (filter.mRepoIndex >= (uint32)mRepos.Size())
+				mRepos.Resize(filter.mRepoIndex + 1);
+
+			RepoIndex& repo = mRepos[filter.mRepoIndex];
+
+			// Matching is case-insensitive.
+			TempString pattern = filter.mPathPattern;
+			gToLowercase(pattern);
+
+			// The literal parts of the pattern, before the first wild card and after the last one.
+			StringView pattern_view = pattern;
+			int        first_wild   = pattern_view.FindFirstOf("?*");
+			int        last_wild    = pattern_view.FindLastOf("?*");
+			StringView prefix       = (first_wild == -1) ? pattern_view : pattern_view.SubStr(0, first_wild);
+			StringView suffix       = (last_wild == -1) ? pattern_view : pattern_view.SubStr(last_wild + 1);
+
+			// If the pattern ends with a literal extension, matching files must have the same one.
+			StringView extension = sGetExtension(suffix);
+			if (!extension.Empty())
+			{
+				auto [it, _] = repo.mByExtension.Insert(gHash(extension), {});
+				it->mValue.PushBack(ref);
+				continue;
+			}
+
+			// If the pattern starts with a literal directory, matching files must be in it.
+			int last_slash = prefix.FindLastOf("\\");
+			if (last_slash != -1)
+			{
+				auto [it, _] = repo.mByDirectory.Insert(gHash(prefix.SubStr(0, last_slash + 1)), {});
+				it->mValue.PushBack(ref);
+				continue;
+			}
+
+			repo.mOthers.PushBack(ref);
+		}
+	}
+}
+
+
+void RuleMatchIndex::GetCandidates(const FileInfo& inFile, TempVector<RuleFilterRef>& outCandidates) const
+{
+	outCandidates.Clear();
+
+	if (inFile.mID.mRepoIndex >= (uint32)mRepos.Size())
+		return;
+
+	const RepoIndex& repo = mRepos[inFile.mID.mRepoIndex];
+
+	TempString path = inFile.mPath;
+	gToLowercase(path);
+
+	// Note: the keys are hashes, a collision only adds filters that will fail their test.
+	StringView extension = sGetExtension(path);
+	if (!extension.Empty())
+	{
+		auto it = repo.mByExtension.Find(gHash(extension));
+		if (it != repo.mByExtension.End())
+			for (RuleFilterRef ref : it->mValue)
+				outCandidates.PushBack(ref);
+	}
+
+	if (!repo.mByDirectory.Empty())
+	{
+		StringView path_view = path;
+		for (int i = 0; i < path_view.Size(); ++i)
+		{
+			if (path_view[i] != '\\')
+				continue;
+
+			auto it = repo.mByDirectory.Find(gHash(path_view.SubStr(0, i + 1)));
+			if (it != repo.mByDirectory.End())
+				for (RuleFilterRef ref : it->mValue)
+					outCandidates.PushBack(ref);
+		}
+	}
+
+	for (RuleFilterRef ref : repo.mOthers)
+		outCandidates.PushBack(ref);
+
+	// Rules need to be tested in order (see CookingRule::mMatchMoreRules).
+	std::sort(outCandidates.begin(), outCandidates.end());
+}
@@ -0,0 +1,51 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include "Core.h"
+
+#include <Bedrock/HashMap.h>
+#include <Bedrock/Vector.h>
+
+struct CookingRule;
+struct FileInfo;
+
+
+// Reference to an InputFilter of a CookingRule.
+struct RuleFilterRef
+{
+	uint16 mRuleIndex   = 0;
+	uint16 mFilterIndex = 0;
+
+	auto operator<=>(const RuleFilterRef&) const = default;
+};
+
+
+// Index of the input filters of all the rules, to only test the ones that can match a file instead of all of them.
+// Filters are bucketed by repo, then by the literal extension at the end of their pattern (eg. "*.png"),
+// or if they don't have one by the literal directory at the start of their pattern (eg. "textures\*").
+// Only filters with neither end up tested against every file of their repo.
+// Read-only once built, so it can be used from multiple threads.
+struct RuleMatchIndex : NoCopy
+{
+	void Build(Span<const CookingRule> inRules);
+
+	// Get the filters that might pass for this file, sorted by rule then filter index.
+	// They still need to be tested, but the others can't pass.
+	void GetCandidates(const FileInfo& inFile, TempVector<RuleFilterRef>& outCandidates) const;
+
+private:
+	using Bucket = Vector<RuleFilterRef>;
+
+	struct RepoIndex
+	{
+		HashMap<uint64, Bucket> mByExtension; // Key is the hash of the lowercase extension (without the dot).
+		HashMap<uint64, Bucket> mByDirectory; // Key is the hash of the lowercase directory (with the trailing slash).
+		Bucket                  mOthers;
+	};
+
+	Vector<RepoIndex> mRepos; // Indexed by repo index.
+};
@@ -81,6 +81,7 @@ static void sReadRuleFile(StringView inPath)
 					gNormalizePath(path_pattern);
 
 					input_filter.mPathPattern = reader.mStringPool->AllocateCopy(path_pattern);
+					input_filter.mCompiledPathPattern.Compile(input_filter.mPathPattern);
 				}
 			}
 		}
@@ -95,16 +96,52 @@ static void sReadRuleFile(StringView inPath)
 		if (rule.mCommandType == CommandType::CommandLine)
 		{
 			reader.Read    ("CommandLine",		rule.mCommandLine);
+			reader.TryRead ("BatchSize",		rule.mBatchSize);
+		}
+		else if (rule.mCommandType == CommandType::Worker)
+		{
+			reader.Read    ("WorkerCommandLine", rule.mWorkerCommandLine);
+			reader.Read    ("CommandLine",		rule.mCommandLine);
+			reader.TryRead ("WorkerTimeout",	rule.mWorkerTimeout);
+			reader.NotAllowed("BatchSize",	 "because CommandType isn't CommandLine");
 		}
 		else
 		{
-			reader.NotAllowed("CommandLine", "because CommandType isn't CommandLine");
-			reader.NotAllowed("DepFile",	 "because CommandType isn't CommandLine");
+			reader.NotAllowed("CommandLine", "because CommandType isn't CommandLine or Worker");
+			reader.NotAllowed("DepFile",	 "because CommandType isn't CommandLine or Worker");
+			reader.NotAllowed("BatchSize",	 "because CommandType isn't CommandLine");
+		}
+
+		if (rule.mCommandType != CommandType::Worker)
+		{
+			reader.NotAllowed("WorkerCommandLine", "because CommandType isn't Worker");
+			reader.NotAllowed("WorkerTimeout",	   "because CommandType isn't Worker");
 		}
 
+		if (rule.UseBatching())
+			reader.Read      ("BatchCommandLine", rule.mBatchCommandLine);
+		else
+			reader.NotAllowed("BatchCommandLine", "because BatchSize isn't greater than 1");
+
 		reader.TryRead     ("Priority",			rule.mPriority);
 		reader.TryRead     ("Version",			rule.mVersion);
 		reader.TryRead     ("MatchMoreRules",	rule.mMatchMoreRules);
+
+		// Batches are cooked by a single process, commands can't be canceled individually.
+		if (rule.UseBatching())
+			reader.NotAllowed("CancelOnInputChange", "because BatchSize is greater than 1");
+		else
+			reader.TryRead   ("CancelOnInputChange", rule.mCancelOnInputChange);
+
+		if (rule.mCancelOnInputChange)
+			reader.TryRead   ("CancelMinRuntime",	rule.mCancelMinRuntime);
+		else
+			reader.NotAllowed("CancelMinRuntime",	"because CancelOnInputChange isn't true");
+
+		reader.TryRead     ("DebounceTime",		rule.mDebounceTime);
+		reader.TryRead     ("MaxConcurrent",	rule.mMaxConcurrent);
+		reader.TryRead     ("ThreadWeight",		rule.mThreadWeight);
+		reader.TryRead     ("MemoryWeight",		rule.mMemoryWeight);
 		reader.TryReadArray("InputPaths",		rule.mInputPaths);
 		reader.TryReadArray("OutputPaths",		rule.mOutputPaths);
 
@@ -112,14 +149,38 @@ static void sReadRuleFile(StringView inPath)
 		{
 			reader.Read    ("Path",				rule.mDepFilePath);
 
-			TempString format;
-			reader.Read("Format", format);
-			gStringViewToEnum(format,			rule.mDepFileFormat);
+			TempString scanner;
+			reader.TryRead("Scanner", scanner);
+			gStringViewToEnum(scanner,			rule.mDepFileScanner);
+
+			if (rule.mDepFileScanner != DepFileScanner::None)
+			{
+				// Built-in scanners always write the binary format.
+				rule.mDepFileFormat = DepFileFormat::AssetCookerBinary;
+				reader.NotAllowed  ("Format",		"because Scanner is set");
+				reader.TryReadArray("IncludePaths", rule.mDepFileIncludePaths);
+
+				if (rule.UseBatching())
+					reader.NotAllowed("Scanner",	"because BatchSize is greater than 1");
+			}
+			else
+			{
+				TempString format;
+				reader.Read("Format", format);
+				gStringViewToEnum(format,			rule.mDepFileFormat);
+
+				reader.NotAllowed("IncludePaths",	"because Scanner isn't set");
+			}
 			
 			reader.CloseTable();
 
 			// Only read the dep file command line if there is a dep file.
-			reader.TryRead("DepFileCommandLine", rule.mDepFileCommandLine);
+			if (rule.UseBatching())
+				reader.NotAllowed("DepFileCommandLine", "because BatchSize is greater than 1");
+			else if (rule.mDepFileScanner != DepFileScanner::None)
+				reader.NotAllowed("DepFileCommandLine", "because the DepFile has a Scanner");
+			else
+				reader.TryRead("DepFileCommandLine", rule.mDepFileCommandLine);
 		}
 		else
 		{
@@ -130,6 +191,8 @@ static void sReadRuleFile(StringView inPath)
 	// Validate the rules.
 	if (!gCookingSystem.ValidateRules())
 		gApp.SetInitError("Rules validation failed. See log for details.");
+
+	gCookingSystem.BuildRuleMatchIndex();
 }
 
 
@@ -93,6 +93,29 @@ struct StringPool
 			mSize += additional_size;
 			mPool.mBuffer.IncreaseSize(additional_size, mPoolLock);
 		}
+
+		// Give the whole string back to the pool. It can't be used anymore after that.
+		void Free()
+		{
+			gAssert(mPool.mBuffer.End() == mData + mSize);
+
+			mPool.mBuffer.DecreaseSize(mSize, mPoolLock);
+			mData = nullptr;
+			mSize = 0;
+		}
+
+		// Shrink the string to inSize characters, the end is given back to the pool.
+		void Shrink(int inSize)
+		{
+			gAssert(mPool.mBuffer.End() == mData + mSize);
+			gAssert(inSize < mSize);
+
+			int removed_size = mSize - 1 - inSize;
+
+			mData[inSize] = 0;
+			mSize         = inSize + 1;
+			mPool.mBuffer.DecreaseSize(removed_size, mPoolLock);
+		}
 	};
 
 	
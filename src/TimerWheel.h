@@ -0,0 +1,250 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include "Core.h"
+
+#include <Bedrock/HashMap.h>
+#include <Bedrock/Vector.h>
+
+// Hierarchical timer wheel.
+// There is at most one timer per key: adding a key again moves its deadline, removing it cancels it.
+// Adding and removing are O(1), advancing is O(expired timers) plus a cascade every 64 slots.
+// Times can be in any unit as long as it's the same everywhere (including the resolution).
+// Not thread safe, the owner is expected to lock.
+template <typename taKey>
+struct TimerWheel : NoCopy
+{
+	static constexpr int cSlotBits   = 6;
+	static constexpr int cSlotCount  = 1 << cSlotBits;
+	static constexpr int cLevelCount = 3; // With a 10ms resolution, the last level covers 45 minutes. Later deadlines are cascaded again.
+
+	explicit TimerWheel(int64 inResolution) : mResolution(inResolution) { gAssert(inResolution > 0); }
+
+	// Add a timer, or move its deadline if it already exists. Return true if it's a new timer.
+	bool Add(const taKey& inKey, int64 inDeadline)
+	{
+		bool is_new = true;
+		auto it     = mDeadlines.Find(inKey);
+		if (it != mDeadlines.End())
+		{
+			// Note: the old slot entry stays behind, it's skipped when its slot is reached because its deadline doesn't match anymore.
+			it->mValue = inDeadline;
+			is_new     = false;
+		}
+		else
+		{
+			mDeadlines.Insert(inKey, inDeadline);
+		}
+
+		// Never in the current slot, it was already processed.
+		Insert({ inKey, inDeadline }, mCurrentSlot + 1);
+		return is_new;
+	}
+
+	// Cancel a timer. Return false if there was no timer for this key.
+	bool Remove(const taKey& inKey)
+	{
+		auto it = mDeadlines.Find(inKey);
+		if (it == mDeadlines.End())
+			return false;
+
+		mDeadlines.Erase(it);
+		return true;
+	}
+
+	bool Contains(const taKey& inKey) const { return mDeadlines.Find(inKey) != mDeadlines.End(); }
+	bool IsEmpty() const { return mDeadlines.Empty(); }
+	int  Size() const { return mDeadlines.Size(); }
+
+	// Return the time at which Advance should be called next, or 0 if there are no timers.
+	// Can be a bit early if timers were moved or removed, but never late.
+	int64 GetNextWakeUpTime() const
+	{
+		if (mDeadlines.Empty())
+			return 0;
+
+		// Check every level, a timer in a higher level can be cascaded before the first timer of a lower level is due.
+		uint64 next_slot = UINT64_MAX;
+		for (int level = 0; level < cLevelCount; ++level)
+		{
+			int    shift      = level * cSlotBits;
+			uint64 level_slot = (uint64)mCurrentSlot >> shift;
+			for (int i = 1; i <= cSlotCount; ++i)
+			{
+				uint64 slot = level_slot + i;
+				if (!mSlots[level][slot & (cSlotCount - 1)].Empty())
+				{
+					next_slot = gMin(next_slot, slot << shift); // When this slot is processed (or cascaded to the level below).
+					break;
+				}
+			}
+		}
+
+		gAssert(next_slot != UINT64_MAX); // Every timer is in a slot, can't get here.
+		return (int64)next_slot * mResolution;
+	}
+
+	// Process all the slots up to inCurrentTime and call inOnExpired(key) for each expired timer.
+	// The timers are removed before the callback is called, so the callback can add them again.
+	template <typename taFunc>
+	void Advance(int64 inCurrentTime, taFunc&& inOnExpired)
+	{
+		int64 target_slot = inCurrentTime / mResolution;
+
+		// Nothing to process, jump directly to the target.
+		if (mDeadlines.Empty())
+		{
+			mCurrentSlot = gMax(mCurrentSlot, target_slot);
+			ClearSlots();
+			return;
+		}
+
+		// If a lot of time passed (or it's the first time), it's faster to re-insert everything than to go through every slot.
+		if (target_slot - mCurrentSlot > cSlotCount * cSlotCount)
+		{
+			Rebuild(target_slot, inCurrentTime, inOnExpired);
+			return;
+		}
+
+		while (mCurrentSlot < target_slot)
+		{
+			mCurrentSlot++;
+
+			// Cascade the higher levels when the lower ones wrap around, highest first.
+			for (int level = cLevelCount - 1; level >= 1; --level)
+			{
+				uint64 mask = ((uint64)1 << (level * cSlotBits)) - 1;
+				if (((uint64)mCurrentSlot & mask) == 0)
+					Cascade(level);
+			}
+
+			Vector<Entry>& slot = mSlots[0][mCurrentSlot & (cSlotCount - 1)];
+			if (slot.Empty())
+				continue;
+
+			mExpired.Clear();
+			gSwap(mExpired, slot);
+
+			for (const Entry& entry : mExpired)
+			{
+				auto it = mDeadlines.Find(entry.mKey);
+				if (it == mDeadlines.End() || it->mValue != entry.mDeadline)
+					continue; // Removed or moved.
+
+				mDeadlines.Erase(it);
+				inOnExpired(entry.mKey);
+			}
+
+			if (mDeadlines.Empty())
+			{
+				mCurrentSlot = target_slot;
+				ClearSlots();
+				return;
+			}
+		}
+	}
+
+private:
+	struct Entry
+	{
+		taKey mKey;
+		int64 mDeadline;
+	};
+
+	void Insert(const Entry& inEntry, int64 inMinSlot)
+	{
+		// Round up to never expire early.
+		int64  slot  = gMax((inEntry.mDeadline + mResolution - 1) / mResolution, inMinSlot);
+		uint64 delta = (uint64)(slot - mCurrentSlot);
+
+		for (int level = 0; level < cLevelCount; ++level)
+		{
+			int shift = level * cSlotBits;
+			if ((delta >> shift) < cSlotCount || level == cLevelCount - 1)
+			{
+				// If it's too far for the last level, put it in the last slot reachable, it will be cascaded again from there.
+				if ((delta >> shift) >= cSlotCount)
+					slot = mCurrentSlot + ((int64)(cSlotCount - 1) << shift);
+
+				mSlots[level][((uint64)slot >> shift) & (cSlotCount - 1)].PushBack(inEntry);
+				return;
+			}
+		}
+	}
+
+	void Cascade(int inLevel)
+	{
+		int            shift = inLevel * cSlotBits;
+		Vector<Entry>& slot  = mSlots[inLevel][((uint64)mCurrentSlot >> shift) & (cSlotCount - 1)];
+		if (slot.Empty())
+			return;
+
+		Vector<Entry> entries;
+		gSwap(entries, slot);
+
+		for (const Entry& entry : entries)
+		{
+			auto it = mDeadlines.Find(entry.mKey);
+			if (it == mDeadlines.End() || it->mValue != entry.mDeadline)
+				continue; // Removed or moved.
+
+			// Can land in the current slot, it will be processed right after.
+			Insert(entry, mCurrentSlot);
+		}
+	}
+
+	template <typename taFunc>
+	void Rebuild(int64 inTargetSlot, int64 inCurrentTime, taFunc&& inOnExpired)
+	{
+		Vector<Entry> entries;
+		for (auto& level : mSlots)
+		{
+			for (Vector<Entry>& slot : level)
+			{
+				for (const Entry& entry : slot)
+				{
+					auto it = mDeadlines.Find(entry.mKey);
+					if (it != mDeadlines.End() && it->mValue == entry.mDeadline)
+						entries.PushBack(entry);
+				}
+
+				slot.Clear();
+			}
+		}
+
+		mCurrentSlot = inTargetSlot;
+
+		for (const Entry& entry : entries)
+		{
+			if (entry.mDeadline > inCurrentTime)
+			{
+				Insert(entry, mCurrentSlot + 1);
+				continue;
+			}
+
+			auto it = mDeadlines.Find(entry.mKey);
+			if (it == mDeadlines.End() || it->mValue != entry.mDeadline)
+				continue; // Duplicate entry, already expired.
+
+			mDeadlines.Erase(it);
+			inOnExpired(entry.mKey);
+		}
+	}
+
+	void ClearSlots()
+	{
+		for (auto& level : mSlots)
+			for (Vector<Entry>& slot : level)
+				slot.Clear();
+	}
+
+	int64                  mResolution  = 0;
+	int64                  mCurrentSlot = 0; // All the slots up to this one are processed.
+	HashMap<taKey, int64>  mDeadlines;       // The actual deadline of each timer.
+	Vector<Entry>          mSlots[cLevelCount][cSlotCount];
+	Vector<Entry>          mExpired;
+};
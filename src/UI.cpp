@@ -282,6 +282,17 @@ void gDrawMainMenuBar()
 
 			ImGui::Separator();
 
+			// The number of active cooking threads can be changed while cooking.
+			int active_thread_count = gCookingSystem.GetActiveCookingThreadCount();
+			if (ImGui::SliderInt("Cooking Threads", &active_thread_count, 1, gMax(1, gCookingSystem.GetMaxCookingThreadCount())))
+				gCookingSystem.SetCookingThreadCount(active_thread_count);
+
+			bool adaptive_cooking_threads = gCookingSystem.IsAdaptiveCookingThreads();
+			if (ImGui::MenuItem("Adapt Cooking Threads To CPU Load", nullptr, &adaptive_cooking_threads))
+				gCookingSystem.SetAdaptiveCookingThreads(adaptive_cooking_threads);
+
+			ImGui::Separator();
+
 			float ui_scale = gUIScale.mFromSettings;
 			if (ImGui::DragFloat("UI Scale", &ui_scale, 0.01f, UIScale::cMin, UIScale::cMax, "%.1f"))
 				gUISetUserScale(ui_scale);
@@ -686,6 +697,8 @@ void gDrawCookingCommandPopup(const CookingCommand& inCommand)
 					dirty_details.Append("Error|");
 				if (inCommand.mDirtyState & CookingCommand::VersionMismatch)
 					dirty_details.Append("Version Mismatch|");
+				if (inCommand.mDirtyState & CookingCommand::FingerprintMismatch)
+					dirty_details.Append("Rule Changed|");
 				if (inCommand.mDirtyState & CookingCommand::InputMissing)
 					dirty_details.Append("Input Missing|");
 				if (inCommand.mDirtyState & CookingCommand::InputChanged)
@@ -738,13 +751,13 @@ void gDrawCookingCommandPopup(const CookingCommand& inCommand)
 
 	gDrawFileInfoSpan("Inputs", inCommand.mInputs, { DependencyType::Input, inCommand.mLastCookUSN });
 	
-	if (!inCommand.mDepFileInputs.Empty())
-		gDrawFileInfoSpan("DepFile Inputs", inCommand.mDepFileInputs, { DependencyType::Input, inCommand.mLastCookUSN });
+	if (!inCommand.mDepFileInputs.IsEmpty())
+		gDrawFileInfoSpan("DepFile Inputs", inCommand.GetDepFileInputs(), { DependencyType::Input, inCommand.mLastCookUSN });
 
 	gDrawFileInfoSpan("Outputs", inCommand.mOutputs, { DependencyType::Output, inCommand.mLastCookUSN });
 
-	if (!inCommand.mDepFileOutputs.Empty())
-		gDrawFileInfoSpan("DepFile Outputs", inCommand.mDepFileOutputs, { DependencyType::Output, inCommand.mLastCookUSN });
+	if (!inCommand.mDepFileOutputs.IsEmpty())
+		gDrawFileInfoSpan("DepFile Outputs", inCommand.GetDepFileOutputs(), { DependencyType::Output, inCommand.mLastCookUSN });
 
 	ImGui::PopStyleVar();
 }
@@ -812,6 +825,42 @@ void gDrawCookingRulePopup(const CookingRule& inRule)
 		ImGui::TableNextColumn(); ImGui::TextUnformatted("CommandLine");
 		ImGui::TableNextColumn(); ImGui::TextUnformatted(inRule.mCommandLine);
 
+		if (inRule.UseBatching())
+		{
+			ImGui::TableNextColumn(); ImGui::TextUnformatted("BatchSize");
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(gTempFormat("%d", inRule.mBatchSize));
+
+			ImGui::TableNextColumn(); ImGui::TextUnformatted("BatchCommandLine");
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(inRule.mBatchCommandLine);
+		}
+
+		if (inRule.mMaxConcurrent > 0)
+		{
+			ImGui::TableNextColumn(); ImGui::TextUnformatted("MaxConcurrent");
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(gTempFormat("%d", inRule.mMaxConcurrent));
+		}
+
+		ImGui::TableNextColumn(); ImGui::TextUnformatted("ThreadWeight");
+		ImGui::TableNextColumn(); ImGui::TextUnformatted(gTempFormat("%d", inRule.mThreadWeight));
+
+		if (inRule.mMemoryWeight > 0.f)
+		{
+			ImGui::TableNextColumn(); ImGui::TextUnformatted("MemoryWeight");
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(gTempFormat("%.2f GiB", inRule.mMemoryWeight));
+		}
+
+		if (inRule.mCommandType == CommandType::Worker)
+		{
+			ImGui::TableNextColumn(); ImGui::TextUnformatted("WorkerCommandLine");
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(inRule.mWorkerCommandLine);
+
+			if (inRule.mWorkerTimeout > 0.f)
+			{
+				ImGui::TableNextColumn(); ImGui::TextUnformatted("WorkerTimeout");
+				ImGui::TableNextColumn(); ImGui::TextUnformatted(gTempFormat("%.1f seconds", inRule.mWorkerTimeout));
+			}
+		}
+
 		if (inRule.UseDepFile())
 		{
 			ImGui::TableNextColumn(); ImGui::TextUnformatted("DepFileFormat");
@@ -825,11 +874,61 @@ void gDrawCookingRulePopup(const CookingRule& inRule)
 				ImGui::TableNextColumn(); ImGui::TextUnformatted("DepFileCommandLine");
 				ImGui::TableNextColumn(); ImGui::TextUnformatted(inRule.mDepFileCommandLine);
 			}
+
+			if (inRule.mDepFileScanner != DepFileScanner::None)
+			{
+				ImGui::TableNextColumn(); ImGui::TextUnformatted("DepFileScanner");
+				ImGui::TableNextColumn(); ImGui::TextUnformatted(gToStringView(inRule.mDepFileScanner));
+
+				for (StringView include_path : inRule.mDepFileIncludePaths)
+				{
+					ImGui::TableNextColumn(); ImGui::TextUnformatted("DepFileIncludePath");
+					ImGui::TableNextColumn(); ImGui::TextUnformatted(include_path);
+				}
+			}
 		}
 
 		ImGui::EndTable();
 	}
 
+	// Resources used by all the cooks of this rule (including previous sessions).
+	RuleResourceUsage usage = gCookingSystem.GetRuleResourceUsage(inRule.mID);
+	ImGui::SeparatorText(gTempFormat("Resource Usage (%llu cooks)", usage.mCookCount));
+
+	if (usage.mCookCount > 0 && ImGui::BeginTable("Resource Usage", 3, ImGuiTableFlags_SizingFixedFit))
+	{
+		double cook_count = (double)usage.mCookCount;
+		double cpu_time   = (double)(usage.mTotal.mUserTime + usage.mTotal.mKernelTime) / 10'000'000.0;
+		double wall_time  = (double)usage.mWallTime / 10'000'000.0;
+
+		ImGui::TableSetupColumn("");
+		ImGui::TableSetupColumn("Total");
+		ImGui::TableSetupColumn("Per Cook");
+		ImGui::TableHeadersRow();
+
+		ImGui::TableNextColumn(); ImGui::TextUnformatted("Duration");
+		ImGui::TableNextColumn(); ImGui::TextUnformatted(gTempFormat("%.3f s", wall_time));
+		ImGui::TableNextColumn(); ImGui::TextUnformatted(gTempFormat("%.3f s", wall_time / cook_count));
+
+		ImGui::TableNextColumn(); ImGui::TextUnformatted("CPU Time");
+		ImGui::TableNextColumn(); ImGui::TextUnformatted(gTempFormat("%.3f s", cpu_time));
+		ImGui::TableNextColumn(); ImGui::TextUnformatted(gTempFormat("%.3f s", cpu_time / cook_count));
+
+		ImGui::TableNextColumn(); ImGui::TextUnformatted("Read");
+		ImGui::TableNextColumn(); ImGui::TextUnformatted(gFormatSizeInBytes(usage.mTotal.mReadBytes));
+		ImGui::TableNextColumn(); ImGui::TextUnformatted(gFormatSizeInBytes((int64)((double)usage.mTotal.mReadBytes / cook_count)));
+
+		ImGui::TableNextColumn(); ImGui::TextUnformatted("Written");
+		ImGui::TableNextColumn(); ImGui::TextUnformatted(gFormatSizeInBytes(usage.mTotal.mWriteBytes));
+		ImGui::TableNextColumn(); ImGui::TextUnformatted(gFormatSizeInBytes((int64)((double)usage.mTotal.mWriteBytes / cook_count)));
+
+		ImGui::TableNextColumn(); ImGui::TextUnformatted("Peak Memory");
+		ImGui::TableNextColumn(); ImGui::TextUnformatted("");
+		ImGui::TableNextColumn(); ImGui::TextUnformatted(gFormatSizeInBytes(usage.mTotal.mPeakMemory));
+
+		ImGui::EndTable();
+	}
+
 	ImGui::SeparatorText(gTempFormat("Input Filters (%d items)", inRule.mInputFilters.Size()));
 
 	for (const InputFilter& input_filter : inRule.mInputFilters)
@@ -1049,6 +1148,7 @@ void gDrawCookingLog()
 					ICON_FK_HOURGLASS,
 					ICON_FK_TIMES,
 					ICON_FK_CHECK,
+					ICON_FK_BAN,
 				};
 				static_assert(gElemCount(cIcons) == (size_t)CookingState::_Count);
 
@@ -1101,6 +1201,39 @@ void gDrawSelectedCookingLogEntry()
 
 	const CookingLogEntry& log_entry = gCookingSystem.GetLogEntry(gSelectedCookingLogEntry);
 
+	// Copy of the output of the selected entry, since old outputs are compressed or archived (see CookingLogStorage).
+	// The full output is loaded on demand when it was too large to be kept in memory.
+	struct SelectedOutputState
+	{
+		CookingLogEntryID  mLogEntryID;
+		bool               mIsFullOutput = false;
+		String             mOutput;
+		Vector<FormatSpan> mOutputFormatSpans;
+	};
+
+	static Storage<SelectedOutputState> state;
+	gUIStateManager.EnsureCreated(state);
+
+	// Forget the output when another entry is selected.
+	if (state->mLogEntryID != gSelectedCookingLogEntry)
+	{
+		state->mLogEntryID   = {};
+		state->mIsFullOutput = false;
+		state->mOutput.Clear();
+		state->mOutputFormatSpans.ClearAndFreeMemory();
+	}
+
+	// If it's finished cooking, it's safe to read the log output.
+	bool cooking_finished = log_entry.mCookingState.Load() > CookingState::Cooking;
+
+	if (cooking_finished && !state->mLogEntryID.IsValid())
+	{
+		// Only try once, even if it fails.
+		state->mLogEntryID = gSelectedCookingLogEntry;
+		gCookingSystem.ReadLogEntryOutput(log_entry, state->mOutput);
+		gParseANSIColors(state->mOutput, state->mOutputFormatSpans);
+	}
+
 	ImGui::PushTextWrapPos();
 	ImGui::TextUnformatted(gToString(log_entry));
 	ImGui::PopTextWrapPos();
@@ -1109,7 +1242,7 @@ void gDrawSelectedCookingLogEntry()
 		const CookingCommand& command      = gCookingSystem.GetCommand(log_entry.mCommandID);
 		const CookingRule&    rule         = command.GetRule();
 		TempString            command_line;
-		if (gFormatCommandString(rule.mCommandLine, gFileSystem.GetFile(command.GetMainInput()), command_line))
+		if (rule.mCommandLineTemplate.FormatCommandString(gFileSystem.GetFile(command.GetMainInput()), command_line))
 		{
 			ImGui::LogToClipboard();
 			ImGui::LogText("%s", command_line.AsCStr());
@@ -1117,20 +1250,39 @@ void gDrawSelectedCookingLogEntry()
 		}
 	}
 
+	if (cooking_finished && log_entry.mFullOutput.IsValid())
+	{
+		ImGui::SameLine();
+		if (!state->mIsFullOutput)
+		{
+			if (ImGui::Button("Load Full Output"))
+			{
+				if (gReadCookOutput(log_entry.mFullOutput, state->mOutput))
+				{
+					state->mIsFullOutput = true;
+					gParseANSIColors(state->mOutput, state->mOutputFormatSpans);
+				}
+			}
+		}
+		else
+		{
+			ImGui::TextUnformatted(gTempFormat("Full output loaded (%s).", gFormatSizeInBytes(state->mOutput.Size()).AsCStr()));
+		}
+	}
+
 	if (ImGui::BeginChild("ScrollingRegion", {}, ImGuiChildFlags_FrameStyle, ImGuiWindowFlags_HorizontalScrollbar))
 	{
-		// If it's finished cooking, it's safe to read the log output.
-		if (log_entry.mCookingState.Load() > CookingState::Cooking)
+		if (cooking_finished)
 		{
-			if (log_entry.mOutputFormatSpans.Empty())
+			if (state->mOutputFormatSpans.Empty())
 			{
 				//ImGui::PushTextWrapPos();
-				ImGui::TextUnformatted(log_entry.mOutput);
+				ImGui::TextUnformatted(state->mOutput);
 				//ImGui::PopTextWrapPos();
 			}
 			else
 			{
-				for (const FormatSpan& format_span : log_entry.mOutputFormatSpans)
+				for (const FormatSpan& format_span : state->mOutputFormatSpans)
 				{
 					if (format_span.mColor.has_value())
 					{
@@ -1321,6 +1473,8 @@ void gDrawCookingThreads()
 	int thread_count = gCookingSystem.mCookingThreads.Size();
 	int columns      = sqrt(thread_count); // TODO need a max number of columns instead, they're useless if too short
 
+	ImGui::TextUnformatted(gTempFormat("%d active threads%s", gCookingSystem.GetActiveCookingThreadCount(), gCookingSystem.IsAdaptiveCookingThreads() ? " (adapting to CPU load)" : ""));
+
 	if (thread_count && ImGui::BeginTable("Threads", columns, ImGuiTableFlags_SizingStretchSame))
 	{
 		ImGui::TableNextRow();
@@ -1529,6 +1683,14 @@ void gDrawDebugWindow()
 	ImGui::Checkbox("Cause random Cooking errors", &gDebugFailCookingRandomly);
 	ImGui::Checkbox("Cause random FileSystem errors", &gDebugFailOpenFileRandomly);
 
+	if (ImGui::CollapsingHeader("Cooking Log Storage"))
+	{
+		CookingLogStorage::Stats stats = gCookingSystem.GetCookingLogStats();
+		ImGui::Text("Hot outputs: %s", gFormatSizeInBytes(stats.mHotSize).AsCStr());
+		ImGui::Text("Warm outputs: %d (%s compressed)", stats.mWarmEntryCount, gFormatSizeInBytes(stats.mWarmSize).AsCStr());
+		ImGui::Text("Archived outputs: %d (%s compressed)", stats.mArchivedEntryCount, gFormatSizeInBytes(stats.mArchivedSize).AsCStr());
+	}
+
 	Span rules = gCookingSystem.GetRules();
 	if (ImGui::CollapsingHeader(gTempFormat("Rules (%d)##Rules", rules.Size())))
 	{
@@ -1687,6 +1849,10 @@ void gDrawStatusBar()
 	// Display some stats on the right side of the status bar.
 	{
 		TempString cooking_stats = gTempFormat("%d Files, %d Repos, %d Commands | ", gFileSystem.GetFileCount(), gFileSystem.GetRepoCount(), gCookingSystem.GetCommandCount());
+
+		// Only show the debounce stats if it did something, most rules don't use it.
+		if (int cooks_avoided = gCookingSystem.GetCooksAvoidedByDebounce(); cooks_avoided > 0)
+			cooking_stats = gTempFormat("%d Cooks Avoided by Debounce | %s", cooks_avoided, cooking_stats.AsCStr());
 		float stats_text_size = ImGui::CalcTextSize(cooking_stats).x;
 
 		StringView ui_stats(ICON_FK_TACHOMETER " UI");
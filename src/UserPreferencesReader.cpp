@@ -52,6 +52,21 @@ void gReadUserPreferencesFile(StringView inPath)
 		if (reader.TryRead("NumCookingThreads", num_cooking_threads))
 			gCookingSystem.SetCookingThreadCount(num_cooking_threads);
 	}
+	{
+		int num_interactive_cooking_threads = 0;
+		if (reader.TryRead("NumInteractiveCookingThreads", num_interactive_cooking_threads))
+			gCookingSystem.SetInteractiveCookingThreadCount(num_interactive_cooking_threads);
+	}
+	{
+		bool adaptive_cooking_threads = false;
+		if (reader.TryRead("AdaptiveCookingThreads", adaptive_cooking_threads))
+			gCookingSystem.SetAdaptiveCookingThreads(adaptive_cooking_threads);
+	}
+	{
+		float cooking_memory_budget = 0.f;
+		if (reader.TryRead("CookingMemoryBudget", cooking_memory_budget))
+			gCookingSystem.SetCookingMemoryBudget(cooking_memory_budget);
+	}
 
 	// Filesystem log verbosity.
 	{
@@ -120,6 +135,9 @@ void gWriteUserPreferencesFile(StringView inPath)
 	prefs_toml.insert("StartPaused", gCookingSystem.IsCookingPaused());
 	prefs_toml.insert("StartMinimized", gApp.mStartMinimized);
 	prefs_toml.insert("NumCookingThreads", gCookingSystem.GetCookingThreadCount());
+	prefs_toml.insert("NumInteractiveCookingThreads", gCookingSystem.GetInteractiveCookingThreadCount());
+	prefs_toml.insert("AdaptiveCookingThreads", gCookingSystem.IsAdaptiveCookingThreads());
+	prefs_toml.insert("CookingMemoryBudget", gCookingSystem.GetCookingMemoryBudget());
 	prefs_toml.insert("LogFSActivity", std::string_view(gToStringView(gApp.mLogFSActivity).AsCStr()));
 	prefs_toml.insert("UIScale", gUIGetUserScale());
 
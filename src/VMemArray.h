@@ -75,6 +75,17 @@ struct VMemArray : NoCopy
 		mAtomicSize.Add(inSizeIncreaseInElements, MemoryOrder::Relaxed);
 	}
 
+	// Decrease the current size. Elements are not destroyed, only meant for trivial types.
+	// Meant to be used with a manual lock to give back the end of the last elements added.
+	void DecreaseSize(int inSizeDecreaseInElements, const VMemArrayLock& inLock)
+	{
+		ValidateLock(inLock);
+		gAssert(inSizeDecreaseInElements <= mAtomicSize.Load(MemoryOrder::Relaxed));
+
+		mVector.Resize(mVector.Size() - inSizeDecreaseInElements, EResizeInit::NoZeroInit);
+		mAtomicSize.Add(-inSizeDecreaseInElements, MemoryOrder::Relaxed);
+	}
+
 	// Make sure enough memory is committed for that many more elements.
 	// Return the span for the new elements (constructed if they have a constructor, but not zero initialzied if they're trivial types).
 	[[nodiscard]] Span<taType> EnsureCapacity(int inExtraCapacityInElements, const VMemArrayLock& inLock)
@@ -16,6 +16,7 @@
 #include "FileSystem.h"
 #include "CookingSystem.h"
 #include "Notifications.h"
+#include "OutputRequests.h"
 #include "Version.h"
 #include <Bedrock/Test.h>
 #include <Bedrock/Ticks.h>
@@ -256,6 +257,10 @@ int WinMain(
 
 	gApp.Init();
 
+	// Check if some outputs should be cooked before anything else.
+	if (auto request_file = args.Find("-request_outputs"); request_file != args.End() && !gApp.HasInitError())
+		gRequestOutputsFromFile(request_file->mValue);
+
 	TempString window_title = gApp.mMainWindowTitle;
 
 	// If we don't have a proper version, add the build time to the window title to help identify.
@@ -466,6 +471,7 @@ int WinMain(
 		g_pSwapChain->Present(1, 0); // Present with vsync
 	}
 
+	gStopOutputRequestServer();
 	gFileSystem.StopMonitoring();
 	gNotifExit();
 